@@ -136,6 +136,9 @@ void GfxCheckErrors() {
 
 void display() {
 	updateOrientation();
+	if ( star3map::DisplayNeeded() == false ) {
+		return;  // the last frame is still on screen
+	}
 	star3map::Display();
 }
 
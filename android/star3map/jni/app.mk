@@ -11,6 +11,22 @@ MY_APP_SRC_FILES += $(MY_APP_ROOT)/star3map.cpp
 MY_APP_SRC_FILES += $(MY_APP_ROOT)/starlist.cpp
 MY_APP_SRC_FILES += $(MY_APP_ROOT)/status.cpp
 MY_APP_SRC_FILES += $(MY_APP_ROOT)/transient.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/profile.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/log.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/billboard.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/textbatch.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/lineset.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/flyover.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/starfield.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/starcatalog.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/skyindex.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/drawlist.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/simulation.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/loadgraph.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/texcache.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/texmanager.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/atlas.cpp
+MY_APP_SRC_FILES += $(MY_APP_ROOT)/sdffont.cpp
 MY_APP_SRC_FILES += $(MY_APP_ROOT)/ujson.cpp
 MY_APP_SRC_FILES += $(MY_APP_ROOT)/ui/button.cpp
 MY_APP_SRC_FILES += $(MY_APP_ROOT)/ui/menubar.cpp
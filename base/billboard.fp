@@ -0,0 +1,12 @@
+precision mediump float;
+in vec4 COL0;
+in vec4 TEXCOORD0;
+uniform sampler2D rglSampler0;
+uniform float AlphaCutoff;
+void main() {
+    vec4 c = COL0 * texture2D( rglSampler0, TEXCOORD0.xy );
+    if ( c.a < AlphaCutoff ) {
+        discard;
+    }
+    gl_FragColor = c;
+}
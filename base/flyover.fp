@@ -0,0 +1,5 @@
+precision mediump float;
+in vec4 COL0;
+void main() {
+    gl_FragColor = COL0;
+}
@@ -0,0 +1,7 @@
+precision mediump float;
+in vec4 COL0;
+uniform sampler2D rglSampler0;
+uniform vec2 TexScale;
+void main() {
+    gl_FragColor = COL0 * texture2D( rglSampler0, gl_PointCoord * TexScale );
+}
@@ -0,0 +1,15 @@
+precision mediump float;
+in vec4 COL0;
+in vec4 TEXCOORD0;
+uniform sampler2D rglSampler0;
+void main() {
+    // the glyph atlas holds a distance field, 0.5 on the outline; the
+    // edge is smoothed over about a pixel as drawn, TEXCOORD0.z either side
+    float d = texture2D( rglSampler0, TEXCOORD0.xy ).r;
+    float coverage = smoothstep( 0.5 - TEXCOORD0.z, 0.5 + TEXCOORD0.z, d );
+    vec4 c = vec4( COL0.rgb, COL0.a * coverage );
+    if ( c.a < 0.01 ) {
+        discard;
+    }
+    gl_FragColor = c;
+}
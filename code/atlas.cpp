@@ -0,0 +1,505 @@
+/*
+ *  atlas
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "atlas.h"
+#include "profile.h"
+
+#include "r3/common.h"
+#include "r3/filesystem.h"
+#include "r3/output.h"
+#include "r3/thread.h"
+
+#include <GL/Regal.h>
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	// Items sit in cells aligned to, and padded with replicated edge texels
+	// by, one texel of the last mip level sampled, so filtering down to it
+	// never reaches a neighbor.  Sprites are drawn well minified, so that's
+	// 1/16 scale; past it the pages are clamped where GL allows.
+	const int atlasMaxLevel = 4;
+	const int atlasPadding = 1 << atlasMaxLevel;
+	const int maxPageSize = 2048;
+	
+	// bump when the packing or the layout file changes
+	const int atlasCacheVersion = 1;
+	
+	int AlignUp( int x ) {
+		return ( x + atlasPadding - 1 ) & ~( atlasPadding - 1 );
+	}
+	
+	string PageCacheName( const string & atlas, int page ) {
+		char buf[16];
+		r3Sprintf( buf, "_%d", page );
+		return "atlas_" + atlas + buf;
+	}
+	
+	string LayoutFilename( const string & atlas ) {
+		return "texcache_atlas_" + atlas + ".bin";
+	}
+	
+	void AppendInt( vector< unsigned char > & buf, int i ) {
+		const unsigned char *p = (const unsigned char *)&i;
+		buf.insert( buf.end(), p, p + sizeof( i ) );
+	}
+	
+	bool ReadInt( const vector< unsigned char > & buf, size_t & offset, int & i ) {
+		if ( offset + sizeof( i ) > buf.size() ) {
+			return false;
+		}
+		memcpy( &i, &buf[ offset ], sizeof( i ) );
+		offset += sizeof( i );
+		return true;
+	}
+	
+	// the initializer thread uploads atlases while the render thread runs
+	r3::Mutex atlasMutex;
+	map< string, TextureRegion > regions;
+	
+	struct TallerFirst {
+		const vector< int > & height;
+		TallerFirst( const vector< int > & h ) : height( h ) {}
+		bool operator() ( int a, int b ) const {
+			return height[a] > height[b];
+		}
+	};
+	
+	// pixel ( x, y ) of img as RGBA, the way GL expands L, LA and RGB
+	void GetRGBA( Image * img, int x, int y, unsigned char *rgba ) {
+		int c = img->Components();
+		const unsigned char *p = img->Data() + ( y * img->Width() + x ) * c;
+		if ( c < 3 ) {
+			rgba[0] = rgba[1] = rgba[2] = p[0];
+			rgba[3] = c == 2 ? p[1] : 255;
+		} else {
+			rgba[0] = p[0];
+			rgba[1] = p[1];
+			rgba[2] = p[2];
+			rgba[3] = c == 4 ? p[3] : 255;
+		}
+	}
+	
+}
+
+namespace star3map {
+	
+	TextureRegion FullTexture( Texture2D *tex ) {
+		TextureRegion r;
+		if ( tex == NULL ) {
+			return r;
+		}
+		r.tex = tex;
+		r.s1 = float( tex->Width() ) / float( tex->PaddedWidth() );
+		r.t1 = float( tex->Height() ) / float( tex->PaddedHeight() );
+		r.width = tex->Width();
+		r.height = tex->Height();
+		return r;
+	}
+	
+	AtlasBuilder::AtlasBuilder( const string & abName ) : name( abName ), compress( CompressedFormat_None ), cached( false ) {
+	}
+	
+	AtlasBuilder::~AtlasBuilder() {
+		for ( int i = 0; i < (int)items.size(); i++ ) {
+			delete items[i].load->image;
+			items[i].load->image = NULL;
+		}
+	}
+	
+	void AtlasBuilder::Add( TextureLoad * member, CompressedFormatEnum memberCompress ) {
+		// pages are only compressed if every member wants it, in one format if they agree
+		if ( items.size() == 0 ) {
+			compress = memberCompress;
+		} else if ( memberCompress == CompressedFormat_None ) {
+			compress = CompressedFormat_None;
+		} else if ( compress != CompressedFormat_None && compress != memberCompress ) {
+			compress = CompressedFormat_Auto;
+		}
+		Item it;
+		it.load = member;
+		it.x = it.y = it.w = it.h = 0;
+		it.page = -1;
+		items.push_back( it );
+	}
+	
+	// every member's source, in order, and everything that shapes the layout
+	string AtlasBuilder::CacheKey() const {
+		char buf[64];
+		r3Sprintf( buf, "atlas %d %d %d", atlasCacheVersion, atlasPadding, maxPageSize );
+		string key = buf;
+		for ( int i = 0; i < (int)items.size(); i++ ) {
+			key += "|" + TextureCacheKey( items[i].load->desc.src, compress );
+		}
+		return key;
+	}
+	
+	// The layout file is the key, then the page sizes, then each item's
+	// page and rectangle, in member order.
+	bool AtlasBuilder::ReadCache() {
+		PROFILE_ZONE( "AtlasBuilder::ReadCache" );
+		if ( compress == CompressedFormat_None ) {
+			return false;
+		}
+		vector< unsigned char > buf;
+		if ( FileReadToMemory( LayoutFilename( name ), buf ) == false ) {
+			return false;
+		}
+		string key = CacheKey();
+		size_t offset = 0;
+		int keySize = 0;
+		if ( ReadInt( buf, offset, keySize ) == false || keySize != (int)key.size() || offset + keySize > buf.size() ||
+			key.compare( 0, key.size(), (const char *)&buf[ offset ], keySize ) != 0 ) {
+			return false;
+		}
+		offset += keySize;
+		int numPages = 0;
+		if ( ReadInt( buf, offset, numPages ) == false || numPages < 0 ) {
+			return false;
+		}
+		vector< Page > cachedPages( numPages );
+		for ( int i = 0; i < numPages; i++ ) {
+			Page & page = cachedPages[i];
+			if ( ReadInt( buf, offset, page.width ) == false || ReadInt( buf, offset, page.height ) == false ||
+				ReadTextureCache( PageCacheName( name, i ), key, page.compressed ) == false ) {
+				return false;
+			}
+		}
+		vector< Item > layout( items );
+		for ( int i = 0; i < (int)layout.size(); i++ ) {
+			Item & it = layout[i];
+			if ( ReadInt( buf, offset, it.page ) == false || ReadInt( buf, offset, it.x ) == false || ReadInt( buf, offset, it.y ) == false ||
+				ReadInt( buf, offset, it.w ) == false || ReadInt( buf, offset, it.h ) == false || it.page >= numPages ) {
+				return false;
+			}
+		}
+		items.swap( layout );
+		pages.swap( cachedPages );
+		cached = true;
+		Output( "Atlas %s: %d pages from the texture cache", name.c_str(), numPages );
+		return true;
+	}
+	
+	void AtlasBuilder::WriteCache() {
+		string key = CacheKey();
+		vector< unsigned char > buf;
+		AppendInt( buf, (int)key.size() );
+		buf.insert( buf.end(), key.begin(), key.end() );
+		AppendInt( buf, (int)pages.size() );
+		for ( int i = 0; i < (int)pages.size(); i++ ) {
+			if ( pages[i].compressed.levels.size() == 0 ) {
+				return; // the encoder failed, so the pages stay uncompressed
+			}
+			AppendInt( buf, pages[i].width );
+			AppendInt( buf, pages[i].height );
+		}
+		for ( int i = 0; i < (int)items.size(); i++ ) {
+			const Item & it = items[i];
+			AppendInt( buf, it.page );
+			AppendInt( buf, it.x );
+			AppendInt( buf, it.y );
+			AppendInt( buf, it.w );
+			AppendInt( buf, it.h );
+		}
+		for ( int i = 0; i < (int)pages.size(); i++ ) {
+			WriteTextureCache( PageCacheName( name, i ), key, pages[i].compressed );
+		}
+		// last, so a layout is only found once its pages are written
+		File *file = FileOpenForWrite( LayoutFilename( name ) );
+		if ( file == NULL ) {
+			Output( "Atlas %s: unable to write %s", name.c_str(), LayoutFilename( name ).c_str() );
+			return;
+		}
+		file->Write( &buf[0], 1, (int)buf.size() );
+		delete file;
+	}
+	
+	void AtlasBuilder::Pack() {
+		if ( cached ) {
+			return;
+		}
+		PROFILE_ZONE( "AtlasBuilder::Pack" );
+		vector< int > height( items.size() );
+		vector< int > remaining;
+		for ( int i = 0; i < (int)items.size(); i++ ) {
+			Image * img = items[i].load->image;
+			if ( img == NULL ) {
+				Output( "Atlas %s: no image for %s", name.c_str(), items[i].load->desc.name.c_str() );
+				continue;
+			}
+			items[i].w = img->Width();
+			items[i].h = img->Height();
+			height[i] = items[i].h;
+			if ( AlignUp( items[i].w + 2 * atlasPadding ) > maxPageSize || AlignUp( items[i].h + 2 * atlasPadding ) > maxPageSize ) {
+				Output( "Atlas %s: %s is too big to pack", name.c_str(), items[i].load->desc.name.c_str() );
+				continue;
+			}
+			remaining.push_back( i );
+		}
+		sort( remaining.begin(), remaining.end(), TallerFirst( height ) );
+		
+		// Shelves, tallest first, on the smallest page that takes them all.
+		// When even the largest doesn't, it's filled and the rest go on to
+		// another page.
+		while( remaining.size() > 0 ) {
+			int w = 256;
+			int h = 256;
+			vector< int > placed;
+			while( 1 ) {
+				placed.clear();
+				for ( int i = 0; i < (int)remaining.size(); i++ ) {
+					items[ remaining[i] ].page = -1;
+				}
+				int x = 0;
+				int shelfY = 0;
+				int shelfH = 0;
+				for ( int i = 0; i < (int)remaining.size(); i++ ) {
+					Item & it = items[ remaining[i] ];
+					int cw = AlignUp( it.w + 2 * atlasPadding );
+					int ch = AlignUp( it.h + 2 * atlasPadding );
+					if ( cw > w || ch > h ) {
+						// not on this page size at all; leave it for a larger one
+						continue;
+					}
+					if ( x + cw > w ) {
+						shelfY += shelfH;
+						x = 0;
+						shelfH = 0;
+					}
+					if ( shelfY + ch > h ) {
+						continue;
+					}
+					it.x = x + atlasPadding;
+					it.y = shelfY + atlasPadding;
+					it.page = (int)pages.size();
+					placed.push_back( remaining[i] );
+					x += cw;
+					shelfH = max( shelfH, ch );
+				}
+				if ( placed.size() == remaining.size() || ( w == maxPageSize && h == maxPageSize ) ) {
+					break;
+				}
+				// grow, alternating width and height
+				if ( w == h ) {
+					w *= 2;
+				} else {
+					h *= 2;
+				}
+			}
+			
+			pages.push_back( Page() );
+			Page & page = pages.back();
+			page.width = w;
+			page.height = h;
+			page.rgba.resize( w * h * 4, 0 );
+			for ( int i = 0; i < (int)placed.size(); i++ ) {
+				Item & it = items[ placed[i] ];
+				r3Assert( it.x >= atlasPadding && it.x + it.w + atlasPadding <= w );
+				r3Assert( it.y >= atlasPadding && it.y + it.h + atlasPadding <= h );
+				Image * img = it.load->image;
+				for ( int y = -atlasPadding; y < it.h + atlasPadding; y++ ) {
+					int sy = min( max( y, 0 ), it.h - 1 );
+					for ( int x = -atlasPadding; x < it.w + atlasPadding; x++ ) {
+						int sx = min( max( x, 0 ), it.w - 1 );
+						GetRGBA( img, sx, sy, &page.rgba[ ( ( it.y + y ) * w + it.x + x ) * 4 ] );
+					}
+				}
+				delete img;
+				it.load->image = NULL;
+			}
+			vector< int > rest;
+			for ( int i = 0; i < (int)remaining.size(); i++ ) {
+				if ( items[ remaining[i] ].page < 0 ) {
+					rest.push_back( remaining[i] );
+				}
+			}
+			remaining.swap( rest );
+			Output( "Atlas %s: page %d is %dx%d with %d images", name.c_str(), (int)pages.size() - 1, w, h, (int)placed.size() );
+		}
+		
+		if ( compress != CompressedFormat_None ) {
+			bool alpha = false;
+			for ( int i = 0; i < (int)pages.size() && alpha == false; i++ ) {
+				const vector< unsigned char > & p = pages[i].rgba;
+				for ( int j = 3; j < (int)p.size(); j += 4 ) {
+					if ( p[j] != 255 ) {
+						alpha = true;
+						break;
+					}
+				}
+			}
+			for ( int i = 0; i < (int)pages.size(); i++ ) {
+				Page & page = pages[i];
+				bool done;
+				if ( alpha ) {
+					done = CompressImage( &page.rgba[0], page.width, page.height, 4, compress, page.compressed );
+				} else {
+					vector< unsigned char > rgb( page.width * page.height * 3 );
+					for ( int j = 0; j < page.width * page.height; j++ ) {
+						rgb[ j * 3 + 0 ] = page.rgba[ j * 4 + 0 ];
+						rgb[ j * 3 + 1 ] = page.rgba[ j * 4 + 1 ];
+						rgb[ j * 3 + 2 ] = page.rgba[ j * 4 + 2 ];
+					}
+					done = CompressImage( &rgb[0], page.width, page.height, 3, compress, page.compressed );
+				}
+				if ( done ) {
+					vector< unsigned char >().swap( page.rgba );
+				}
+			}
+			WriteCache();
+		}
+	}
+	
+	void AtlasBuilder::Upload() {
+		vector< Texture2D * > pageTex;
+		for ( int i = 0; i < (int)pages.size(); i++ ) {
+			Page & page = pages[i];
+			char buf[16];
+			r3Sprintf( buf, ":%d", i );
+			string texName = "atlas:" + name + buf;
+			Texture2D * t;
+			if ( page.compressed.levels.size() > 0 ) {
+				t = CreateCompressedTexture2D( texName, page.compressed );
+			} else {
+				t = CreateTexture2D( texName, TextureFormat_RGBA, page.width, page.height );
+				t->SetImage( 0, TextureFormat_RGBA, page.width, page.height, &page.rgba[0] );
+			}
+#if ! ( ANDROID || IPHONE )
+			// ES2 has no max level, so smaller sprites may pick up a neighbor's edge there
+			glTextureParameteriEXT( t->Object(), GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, atlasMaxLevel );
+#endif
+			AdoptTexture( texName, t );
+			pageTex.push_back( t );
+		}
+		
+		ProfiledScopedMutex scmutex( atlasMutex, R3_LOC );
+		for ( int i = 0; i < (int)items.size(); i++ ) {
+			Item & it = items[i];
+			if ( it.page < 0 ) {
+				continue;
+			}
+			const Page & page = pages[ it.page ];
+			TextureRegion r;
+			r.tex = pageTex[ it.page ];
+			r.s0 = float( it.x ) / page.width;
+			r.t0 = float( it.y ) / page.height;
+			r.s1 = float( it.x + it.w ) / page.width;
+			r.t1 = float( it.y + it.h ) / page.height;
+			r.width = it.w;
+			r.height = it.h;
+			regions[ it.load->desc.name ] = r;
+		}
+		pages.clear();
+	}
+	
+	TextureRegion UseSprite( const string & name ) {
+		{
+			ProfiledScopedMutex scmutex( atlasMutex, R3_LOC );
+			map< string, TextureRegion >::iterator it = regions.find( name );
+			if ( it != regions.end() ) {
+				return it->second;
+			}
+		}
+		return FullTexture( static_cast< Texture2D * >( UseTexture( name ) ) );
+	}
+	
+	TextureRegion PinSprite( const string & name ) {
+		{
+			ProfiledScopedMutex scmutex( atlasMutex, R3_LOC );
+			map< string, TextureRegion >::iterator it = regions.find( name );
+			if ( it != regions.end() ) {
+				return it->second;
+			}
+		}
+		return FullTexture( static_cast< Texture2D * >( PinTexture( name ) ) );
+	}
+	
+	void SpriteBatch::Add( const TextureRegion & region, const Bounds2f & bounds, const Vec4f & color ) {
+		quads.push_back( Quad() );
+		Quad & q = quads.back();
+		q.region = region;
+		q.bounds = bounds;
+		q.color = color;
+	}
+	
+	void SpriteBatch::Draw() {
+		int n = (int)quads.size();
+		for ( int i = 0; i < n; ) {
+			Texture2D * tex = quads[i].region.tex;
+			int end = i + 1;
+			while( end < n && quads[ end ].region.tex == tex ) {
+				end++;
+			}
+			if ( tex ) {
+				tex->Bind( 0 );
+				tex->Enable( 0 );
+				glMultiTexEnviEXT( GL_TEXTURE0, GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+				glBegin( GL_QUADS );
+				for ( int j = i; j < end; j++ ) {
+					const Quad & q = quads[j];
+					const TextureRegion & r = q.region;
+					glColor4fv( q.color.Ptr() );
+					glMultiTexCoord2f( GL_TEXTURE0, r.s0, r.t0 );
+					glVertex2f( q.bounds.Min().x, q.bounds.Min().y );
+					glMultiTexCoord2f( GL_TEXTURE0, r.s1, r.t0 );
+					glVertex2f( q.bounds.Max().x, q.bounds.Min().y );
+					glMultiTexCoord2f( GL_TEXTURE0, r.s1, r.t1 );
+					glVertex2f( q.bounds.Max().x, q.bounds.Max().y );
+					glMultiTexCoord2f( GL_TEXTURE0, r.s0, r.t1 );
+					glVertex2f( q.bounds.Min().x, q.bounds.Max().y );
+				}
+				glEnd();
+				tex->Disable( 0 );
+			}
+			i = end;
+		}
+		quads.clear();
+	}
+	
+}
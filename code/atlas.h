@@ -0,0 +1,135 @@
+/*
+ *  atlas
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_ATLAS_H__
+#define __STAR3MAP_ATLAS_H__
+
+#include "texmanager.h"
+
+#include "r3/bounds.h"
+#include "r3/linear.h"
+#include "r3/texture.h"
+
+#include <string>
+#include <vector>
+
+namespace star3map {
+	
+	// A rectangle of a texture, which is either an atlas page or a texture
+	// of its own.
+	struct TextureRegion {
+		TextureRegion() : tex( NULL ), s0( 0 ), t0( 0 ), s1( 1 ), t1( 1 ), width( 0 ), height( 0 ) {}
+		r3::Texture2D *tex;
+		float s0, t0, s1, t1;
+		int width, height;  // in pixels
+	};
+	
+	// all of tex, less any padding r3 added
+	TextureRegion FullTexture( r3::Texture2D *tex );
+	
+	// Packs the images of an atlas group from config.json into as few pages
+	// as fit, so the sprites and icons drawn together need one bind.  Pack()
+	// runs on a loader thread once the members are decoded, and Upload() on
+	// the context thread.  If every member asked for a compressed format,
+	// the pages are compressed too, and kept in the texture cache with their
+	// layout, keyed on every member's source.  ReadCache() runs first, and
+	// on a hit the members needn't be decoded at all.
+	class AtlasBuilder {
+	public:
+		AtlasBuilder( const std::string & abName );
+		~AtlasBuilder();
+		
+		void Add( TextureLoad * member, CompressedFormatEnum compress );
+		// true if the pages and layout came from the texture cache
+		bool ReadCache();
+		bool Cached() const { return cached; }
+		void Pack();
+		// the pages become resident for good, and their regions are found by
+		// UseSprite and PinSprite
+		void Upload();
+		
+	private:
+		struct Item {
+			TextureLoad * load;
+			int x, y, w, h;
+			int page;
+		};
+		struct Page {
+			int width, height;
+			std::vector< unsigned char > rgba;
+			CompressedImage compressed;
+		};
+		
+		std::string CacheKey() const;
+		void WriteCache();
+		
+		std::string name;
+		std::vector< Item > items;
+		std::vector< Page > pages;
+		CompressedFormatEnum compress;
+		bool cached;
+	};
+	
+	// The atlas region for name, or all of the texture manager's texture by
+	// that name, which is kept for at least this frame.
+	TextureRegion UseSprite( const std::string & name );
+	// for regions held across frames, like the button icons
+	TextureRegion PinSprite( const std::string & name );
+	
+	// Quads drawn in order, with one bind for each run that shares a texture.
+	class SpriteBatch {
+	public:
+		void Add( const TextureRegion & region, const r3::Bounds2f & bounds, const r3::Vec4f & color );
+		void Draw();
+		
+	private:
+		struct Quad {
+			TextureRegion region;
+			r3::Bounds2f bounds;
+			r3::Vec4f color;
+		};
+		std::vector< Quad > quads;
+	};
+	
+}
+
+#endif //__STAR3MAP_ATLAS_H__
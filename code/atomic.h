@@ -0,0 +1,97 @@
+/*
+ *  atomic
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_ATOMIC_H__
+#define __STAR3MAP_ATOMIC_H__
+
+#if _WIN32
+# include <windows.h>
+#endif
+
+namespace star3map {
+
+	// Minimal 32-bit atomics.  Only 32-bit operations are provided, since
+	// 64-bit ones aren't reliably lock-free on armeabi.
+
+	// full memory barrier
+	inline void AtomicFence() {
+#if _WIN32
+		MemoryBarrier();
+#else
+		__sync_synchronize();
+#endif
+	}
+
+	// returns the value of *dst before the operation
+	inline int AtomicCompareAndSwap( volatile int *dst, int expected, int desired ) {
+#if _WIN32
+		return InterlockedCompareExchange( (volatile LONG *)dst, desired, expected );
+#else
+		return __sync_val_compare_and_swap( dst, expected, desired );
+#endif
+	}
+
+	// returns the value of *dst after the operation
+	inline int AtomicAdd( volatile int *dst, int value ) {
+#if _WIN32
+		return InterlockedExchangeAdd( (volatile LONG *)dst, value ) + value;
+#else
+		return __sync_add_and_fetch( dst, value );
+#endif
+	}
+
+	// returns the value of *dst before the operation
+	inline int AtomicExchange( volatile int *dst, int value ) {
+#if _WIN32
+		return InterlockedExchange( (volatile LONG *)dst, value );
+#else
+		int prev;
+		do {
+			prev = *dst;
+		} while ( __sync_val_compare_and_swap( dst, prev, value ) != prev );
+		return prev;
+#endif
+	}
+
+}
+
+#endif //__STAR3MAP_ATOMIC_H__
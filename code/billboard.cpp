@@ -0,0 +1,138 @@
+/*
+ *  billboard
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "billboard.h"
+#include "render.h"
+#include "profile.h"
+
+#include "r3/shader.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	Shader *billboardShader;
+	
+	Shader * GetBillboardShader() {
+		if ( billboardShader == NULL ) {
+			Shader * s = billboardShader = CreateShaderFromFile( "billboard" );
+			glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
+			glBindAttribLocation( s->pgObject, AL_Color, "Color" );
+			glBindAttribLocation( s->pgObject, AL_TexCoord + 0, "TexCoord0" );
+			glLinkProgram( s->pgObject );
+		}
+		return billboardShader;
+	}
+	
+	const float corners[6][2] = {
+		{ -1, -1 }, {  1, -1 }, {  1,  1 },
+		{ -1, -1 }, {  1,  1 }, { -1,  1 }
+	};
+	
+	unsigned char ToByte( float f ) {
+		return (unsigned char)( std::max( 0.f, std::min( 1.f, f ) ) * 255.f + 0.5f );
+	}
+	
+}
+
+namespace star3map {
+	
+	BillboardBatch::BillboardBatch( const string & batchName ) : name( batchName ), model( NULL ) {
+	}
+	
+	BillboardBatch::~BillboardBatch() {
+		delete model;
+	}
+	
+	void BillboardBatch::Clear() {
+		verts.clear();
+	}
+	
+	void BillboardBatch::Add( const Vec3f & position, float radius, const Vec4f & color ) {
+		Vert v;
+		v.pos = position;
+		v.c[0] = ToByte( color.x );
+		v.c[1] = ToByte( color.y );
+		v.c[2] = ToByte( color.z );
+		v.c[3] = ToByte( color.w );
+		for ( int i = 0; i < 6; i++ ) {
+			v.corner = Vec3f( corners[i][0], corners[i][1], radius );
+			verts.push_back( v );
+		}
+	}
+	
+	void BillboardBatch::Draw( Texture2D *tex, float maxUnitHeight, float alphaCutoff ) {
+		if ( verts.size() == 0 || tex == NULL ) {
+			return;
+		}
+		PROFILE_ZONE( "BillboardBatch::Draw" );
+		if ( model == NULL ) {
+			model = new Model( name );
+			int offset = 0;
+			model->AddAttributeArray( AttributeArray( AL_Position, 3, GL_FLOAT, GL_FALSE, sizeof( Vert ), offset ) );
+			offset += sizeof( Vec3f );
+			model->AddAttributeArray( AttributeArray( AL_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( Vert ), offset ) );
+			offset += 4;
+			model->AddAttributeArray( AttributeArray( AL_TexCoord + 0, 3, GL_FLOAT, GL_FALSE, sizeof( Vert ), offset ) );
+			model->SetPrimitive( GL_TRIANGLES );
+		}
+		// respecified every frame, so the driver can hand back a fresh buffer
+		model->GetVertexBuffer().SetData( (int)verts.size() * sizeof( Vert ), & verts[0] );
+		model->SetNumVertexes( (int)verts.size() );
+		ProfileCounter( "billboards", (float)Count() );
+		
+		Shader *s = GetBillboardShader();
+		tex->Bind( 0 );
+		glUseProgram( s->pgObject );
+		s->SetUniform( "MaxUnitHeight", maxUnitHeight );
+		s->SetUniform( "WindowHeight", (float)frameSettings.windowHeight );
+		s->SetUniform( "TexScale", Vec2f( float( tex->Width() ) / tex->PaddedWidth(), float( tex->Height() ) / tex->PaddedHeight() ) );
+		s->SetUniform( "AlphaCutoff", alphaCutoff );
+		model->Draw();
+		glUseProgram( 0 );
+	}
+	
+}
@@ -0,0 +1,88 @@
+/*
+ *  billboard
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_BILLBOARD_H__
+#define __STAR3MAP_BILLBOARD_H__
+
+#include "r3/linear.h"
+#include "r3/model.h"
+#include "r3/texture.h"
+
+#include <string>
+#include <vector>
+
+namespace star3map {
+
+	// Camera facing sprites that share a texture, collected over a frame
+	// and drawn with one streaming vertex buffer and one draw call.  The
+	// corners are expanded in base/billboard.vp, so no matrices are touched
+	// per sprite.
+	class BillboardBatch {
+	public:
+		BillboardBatch( const std::string & name );
+		~BillboardBatch();
+		
+		void Clear();
+		// radius is the half size in eye space units at the sprite's position
+		void Add( const r3::Vec3f & position, float radius, const r3::Vec4f & color );
+		int Count() const { return (int)verts.size() / 6; }
+		
+		// Draws with the current modelview and projection.  If maxUnitHeight
+		// is non-zero, sprites are shrunk wherever one unit projects taller
+		// than maxUnitHeight (NDC height times window height), which keeps
+		// sprites small when zoomed in.  alphaCutoff stands in for the alpha test.
+		void Draw( r3::Texture2D *tex, float maxUnitHeight = 0.f, float alphaCutoff = 0.f );
+		
+	private:
+		struct Vert {
+			r3::Vec3f pos;
+			unsigned char c[4];
+			r3::Vec3f corner;  // xy in [-1,1], z = radius
+		};
+		std::string name;
+		std::vector< Vert > verts;
+		r3::Model *model;
+	};
+	
+}
+
+#endif //__STAR3MAP_BILLBOARD_H__
@@ -0,0 +1,392 @@
+/*
+ *  drawlist
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "drawlist.h"
+#include "billboard.h"
+#include "flyover.h"
+#include "lineset.h"
+#include "profile.h"
+#include "render.h"
+#include "starcatalog.h"
+#include "starfield.h"
+
+#include "r3/draw.h"
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace star3map {
+	
+	DrawList::DrawList() : billboardsPending( 0 ), lineColorsPending( 0 ), textPending( 0 ) {
+	}
+	
+	// clear() keeps the capacity, so a list reused every frame stops allocating
+	void DrawList::Clear() {
+		commands.clear();
+		matrices.clear();
+		enables.clear();
+		blendFuncs.clear();
+		meshes.clear();
+		sprites.clear();
+		billboards.clear();
+		billboardCmds.clear();
+		lineColors.clear();
+		lineCmds.clear();
+		starCmds.clear();
+		flyovers.clear();
+		text.clear();
+		textCmds.clear();
+		outlines.clear();
+		billboardsPending = lineColorsPending = textPending = 0;
+	}
+	
+	void DrawList::Record( CommandType type, int index ) {
+		Command c;
+		c.type = type;
+		c.index = index;
+		commands.push_back( c );
+	}
+	
+	void DrawList::Projection( const Matrix4f & m ) {
+		Record( CT_Projection, (int)matrices.size() );
+		matrices.push_back( m );
+	}
+	
+	void DrawList::Modelview( const Matrix4f & m ) {
+		Record( CT_Modelview, (int)matrices.size() );
+		matrices.push_back( m );
+	}
+	
+	void DrawList::Enable( GLenum cap, bool enable ) {
+		EnableCmd c;
+		c.cap = cap;
+		c.enable = enable;
+		Record( CT_Enable, (int)enables.size() );
+		enables.push_back( c );
+	}
+	
+	void DrawList::BlendFunc( GLenum src, GLenum dst ) {
+		BlendFuncCmd c;
+		c.src = src;
+		c.dst = dst;
+		Record( CT_BlendFunc, (int)blendFuncs.size() );
+		blendFuncs.push_back( c );
+	}
+	
+	// The textures come from UseTexture(), which is NULL when a load
+	// failed, and then there's nothing to draw.
+	
+	void DrawList::Mesh( Model *model, Texture2D *tex, const Vec4f & color ) {
+		if ( tex == NULL ) {
+			return;
+		}
+		MeshCmd c;
+		c.model = model;
+		c.tex = tex;
+		c.color = color;
+		Record( CT_Mesh, (int)meshes.size() );
+		meshes.push_back( c );
+	}
+	
+	void DrawList::Sprite( const TextureRegion & region, const Matrix4f & xf, const Vec4f & color ) {
+		if ( region.tex == NULL ) {
+			return;
+		}
+		SpriteCmd c;
+		c.region = region;
+		c.xf = xf;
+		c.color = color;
+		Record( CT_Sprite, (int)sprites.size() );
+		sprites.push_back( c );
+	}
+	
+	void DrawList::AddBillboard( const Vec3f & position, float radius, const Vec4f & color ) {
+		Billboard b;
+		b.position = position;
+		b.radius = radius;
+		b.color = color;
+		billboards.push_back( b );
+	}
+	
+	void DrawList::Billboards( BillboardBatch *batch, Texture2D *tex, float maxUnitHeight, float alphaCutoff ) {
+		BillboardsCmd c;
+		c.batch = batch;
+		c.tex = tex;
+		c.maxUnitHeight = maxUnitHeight;
+		c.alphaCutoff = alphaCutoff;
+		c.first = billboardsPending;
+		c.count = (int)billboards.size() - billboardsPending;
+		billboardsPending = (int)billboards.size();
+		if ( tex == NULL ) {
+			return;
+		}
+		Record( CT_Billboards, (int)billboardCmds.size() );
+		billboardCmds.push_back( c );
+	}
+	
+	void DrawList::AddLineColor( int set, const Vec4f & color ) {
+		LineColor lc;
+		lc.set = set;
+		lc.color = color;
+		lineColors.push_back( lc );
+	}
+	
+	void DrawList::Lines( LineSet *lineSet ) {
+		LinesCmd c;
+		c.lineSet = lineSet;
+		c.first = lineColorsPending;
+		c.count = (int)lineColors.size() - lineColorsPending;
+		lineColorsPending = (int)lineColors.size();
+		Record( CT_Lines, (int)lineCmds.size() );
+		lineCmds.push_back( c );
+	}
+	
+	void DrawList::Stars( StarField *field, Texture2D *tex, float minMagnitude, float maxMagnitude, float scale ) {
+		StarsCmd c;
+		c.field = field;
+		c.catalog = NULL;
+		c.tex = tex;
+		c.fov = c.aspect = 0.f;
+		c.minMagnitude = minMagnitude;
+		c.maxMagnitude = maxMagnitude;
+		c.scale = scale;
+		Record( CT_Stars, (int)starCmds.size() );
+		starCmds.push_back( c );
+	}
+	
+	void DrawList::Stars( StarCatalog *catalog, Texture2D *tex, const Vec3f & lookDir, float fov, float aspect,
+						 float minMagnitude, float maxMagnitude, float scale ) {
+		StarsCmd c;
+		c.field = NULL;
+		c.catalog = catalog;
+		c.tex = tex;
+		c.lookDir = lookDir;
+		c.fov = fov;
+		c.aspect = aspect;
+		c.minMagnitude = minMagnitude;
+		c.maxMagnitude = maxMagnitude;
+		c.scale = scale;
+		Record( CT_Stars, (int)starCmds.size() );
+		starCmds.push_back( c );
+	}
+	
+	void DrawList::Flyover( FlyoverPaths *paths, const Matrix4f & pathTransform, const Vec3f & viewer, bool normalize, bool gaps ) {
+		FlyoverCmd c;
+		c.paths = paths;
+		c.pathTransform = pathTransform;
+		c.viewer = viewer;
+		c.normalize = normalize;
+		c.gaps = gaps;
+		Record( CT_Flyover, (int)flyovers.size() );
+		flyovers.push_back( c );
+	}
+	
+	void DrawList::AddText( const string & str, const Matrix4f & xf, float x, float y, float scale, const Vec4f & color ) {
+		text.push_back( TextRun() );
+		TextRun & r = text.back();
+		r.str = str;
+		r.xf = xf;
+		r.x = x;
+		r.y = y;
+		r.scale = scale;
+		r.color = color;
+	}
+	
+	void DrawList::Text() {
+		TextCmd c;
+		c.first = textPending;
+		c.count = (int)text.size() - textPending;
+		textPending = (int)text.size();
+		Record( CT_Text, (int)textCmds.size() );
+		textCmds.push_back( c );
+	}
+	
+	void DrawList::Outline( const OrientedBounds2f & ob, const Vec4f & color ) {
+		OutlineCmd c;
+		for ( int i = 0; i < 4; i++ ) {
+			c.vert[i] = ob.vert[i];
+		}
+		c.color = color;
+		Record( CT_Outline, (int)outlines.size() );
+		outlines.push_back( c );
+	}
+	
+	
+	void Submit( const DrawList & list ) {
+		PROFILE_ZONE( "Submit" );
+		ProfileCounter( "draw commands", (float)list.Size() );
+		glMatrixPushEXT( GL_PROJECTION );
+		glMatrixPushEXT( GL_MODELVIEW );
+		// stays bound and enabled through a run of sprites
+		Texture2D *spriteTex = NULL;
+		// the caps the list changes, as they were before it
+		const int MaxSavedCaps = 8;
+		GLenum savedCap[ MaxSavedCaps ];
+		GLboolean savedEnable[ MaxSavedCaps ];
+		int numSaved = 0;
+		for ( int i = 0; i < (int)list.commands.size(); i++ ) {
+			int index = list.commands[i].index;
+			if ( spriteTex && list.commands[i].type != DrawList::CT_Sprite ) {
+				spriteTex->Disable( 0 );
+				spriteTex = NULL;
+			}
+			switch ( list.commands[i].type ) {
+				case DrawList::CT_Projection:
+					glMatrixLoadfEXT( GL_PROJECTION, list.matrices[ index ].Ptr() );
+					break;
+				case DrawList::CT_Modelview:
+					glMatrixLoadfEXT( GL_MODELVIEW, list.matrices[ index ].Ptr() );
+					break;
+				case DrawList::CT_Enable: {
+					const DrawList::EnableCmd & c = list.enables[ index ];
+					int s = 0;
+					while( s < numSaved && savedCap[ s ] != c.cap ) {
+						s++;
+					}
+					if ( s == numSaved && numSaved < MaxSavedCaps ) {
+						savedCap[ s ] = c.cap;
+						savedEnable[ s ] = glIsEnabled( c.cap );
+						numSaved++;
+					}
+					if ( c.enable ) {
+						glEnable( c.cap );
+					} else {
+						glDisable( c.cap );
+					}
+				} break;
+				case DrawList::CT_BlendFunc:
+					glBlendFunc( list.blendFuncs[ index ].src, list.blendFuncs[ index ].dst );
+					break;
+				case DrawList::CT_Mesh: {
+					const DrawList::MeshCmd & c = list.meshes[ index ];
+					c.tex->Bind( 0 );
+					c.tex->Enable( 0 );
+					glMultiTexEnviEXT( GL_TEXTURE0, GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+					glColor4fv( c.color.Ptr() );
+					c.model->Draw();
+					c.tex->Disable( 0 );
+				} break;
+				case DrawList::CT_Sprite: {
+					const DrawList::SpriteCmd & c = list.sprites[ index ];
+					const TextureRegion & r = c.region;
+					if ( r.tex != spriteTex ) {
+						if ( spriteTex ) {
+							spriteTex->Disable( 0 );
+						}
+						spriteTex = r.tex;
+						spriteTex->Bind( 0 );
+						spriteTex->Enable( 0 );
+						glMultiTexEnviEXT( GL_TEXTURE0, GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+					}
+					glMatrixPushEXT( GL_MODELVIEW );
+					glMatrixMultfEXT( GL_MODELVIEW, c.xf.Ptr() );
+					glColor4fv( c.color.Ptr() );
+					r3::DrawTexturedQuad( -10, -10, 10, 10, r.s0, r.t0, r.s1, r.t1 );
+					glMatrixPopEXT( GL_MODELVIEW );
+				} break;
+				case DrawList::CT_Billboards: {
+					const DrawList::BillboardsCmd & c = list.billboardCmds[ index ];
+					c.batch->Clear();
+					for ( int j = c.first; j < c.first + c.count; j++ ) {
+						const DrawList::Billboard & b = list.billboards[ j ];
+						c.batch->Add( b.position, b.radius, b.color );
+					}
+					c.batch->Draw( c.tex, c.maxUnitHeight, c.alphaCutoff );
+				} break;
+				case DrawList::CT_Lines: {
+					const DrawList::LinesCmd & c = list.lineCmds[ index ];
+					for ( int j = c.first; j < c.first + c.count; j++ ) {
+						c.lineSet->SetColor( list.lineColors[ j ].set, list.lineColors[ j ].color );
+					}
+					c.lineSet->Draw();
+				} break;
+				case DrawList::CT_Stars: {
+					const DrawList::StarsCmd & c = list.starCmds[ index ];
+					if ( c.field ) {
+						c.field->Draw( c.tex, c.minMagnitude, c.maxMagnitude, c.scale );
+					} else {
+						c.catalog->Draw( c.tex, c.lookDir, c.fov, c.aspect, c.minMagnitude, c.maxMagnitude, c.scale );
+					}
+				} break;
+				case DrawList::CT_Flyover: {
+					const DrawList::FlyoverCmd & c = list.flyovers[ index ];
+					c.paths->Draw( c.pathTransform, c.viewer, c.normalize, c.gaps );
+				} break;
+				case DrawList::CT_Text: {
+					const DrawList::TextCmd & c = list.textCmds[ index ];
+					if ( c.count > 0 ) {
+						DrawTextRuns( &list.text[ c.first ], c.count );
+					}
+				} break;
+				case DrawList::CT_Outline: {
+					const DrawList::OutlineCmd & c = list.outlines[ index ];
+					glMatrixPushEXT( GL_MODELVIEW );
+					glMatrixLoadIdentityEXT( GL_MODELVIEW );
+					glMatrixPushEXT( GL_PROJECTION );
+					glMatrixLoadIdentityEXT( GL_PROJECTION );
+					glColor4fv( c.color.Ptr() );
+					glBegin( GL_LINE_STRIP );
+					for ( int j = 0; j <= 4; j++ ) {
+						glVertex2fv( c.vert[ j % 4 ].Ptr() );
+					}
+					glEnd();
+					glMatrixPopEXT( GL_PROJECTION );
+					glMatrixPopEXT( GL_MODELVIEW );
+				} break;
+			}
+		}
+		if ( spriteTex ) {
+			spriteTex->Disable( 0 );
+		}
+		for ( int i = 0; i < numSaved; i++ ) {
+			if ( savedEnable[i] ) {
+				glEnable( savedCap[i] );
+			} else {
+				glDisable( savedCap[i] );
+			}
+		}
+		glMatrixPopEXT( GL_MODELVIEW );
+		glMatrixPopEXT( GL_PROJECTION );
+	}
+	
+}
@@ -0,0 +1,242 @@
+/*
+ *  drawlist
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_DRAWLIST_H__
+#define __STAR3MAP_DRAWLIST_H__
+
+#include "atlas.h"
+
+#include "r3/bounds.h"
+#include "r3/linear.h"
+#include "r3/model.h"
+#include "r3/texture.h"
+
+#include <GL/Regal.h>
+
+#include <string>
+#include <vector>
+
+namespace star3map {
+
+	class BillboardBatch;
+	class FlyoverPaths;
+	class LineSet;
+	class StarCatalog;
+	class StarField;
+	
+	// a 3D label laid out in label space; xf maps label space into the space
+	// of the modelview that is current when the run is drawn
+	struct TextRun {
+		std::string str;
+		r3::Matrix4f xf;
+		float x, y;
+		float scale;
+		r3::Vec4f color;
+	};
+	
+	// A view's drawing, recorded without touching GL.  Each kind of command
+	// keeps its parameters in an array of its own, and the order they were
+	// recorded in is kept as ( type, index ) pairs.  Objects that own GPU
+	// storage (line sets, star fields, flyover paths, models, textures) are
+	// referred to by pointer and only used by Submit, so a list can be built
+	// away from the render thread, or without a context at all, and then
+	// handed to Submit on the render thread.
+	//
+	// Per object data (billboards, line colors, text) is added with the
+	// Add* calls and drawn by the next Billboards, Lines or Text command.
+	// Submit restores the matrices and any caps the list Enables or
+	// disables; other state, like the blend func, is left as the list set it.
+	class DrawList {
+	public:
+		enum CommandType {
+			CT_Projection,
+			CT_Modelview,
+			CT_Enable,
+			CT_BlendFunc,
+			CT_Mesh,
+			CT_Sprite,
+			CT_Billboards,
+			CT_Lines,
+			CT_Stars,
+			CT_Flyover,
+			CT_Text,
+			CT_Outline
+		};
+		
+		DrawList();
+		
+		void Clear();
+		int Size() const { return (int)commands.size(); }
+		
+		void Projection( const r3::Matrix4f & m );
+		void Modelview( const r3::Matrix4f & m );
+		void Enable( GLenum cap, bool enable );
+		void BlendFunc( GLenum src, GLenum dst );
+		
+		// model drawn modulated by tex and color
+		void Mesh( r3::Model *model, r3::Texture2D *tex, const r3::Vec4f & color );
+		// the ( -10, -10 ) to ( 10, 10 ) sprite quad, placed by xf; a run of
+		// sprites from the same atlas page is drawn with one bind
+		void Sprite( const TextureRegion & region, const r3::Matrix4f & xf, const r3::Vec4f & color );
+		
+		void AddBillboard( const r3::Vec3f & position, float radius, const r3::Vec4f & color );
+		// the billboards added since the last Billboards, see BillboardBatch::Draw
+		void Billboards( BillboardBatch *batch, r3::Texture2D *tex, float maxUnitHeight = 0.f, float alphaCutoff = 0.f );
+		
+		void AddLineColor( int set, const r3::Vec4f & color );
+		// the sets of lineSet that were given a color since the last Lines
+		void Lines( LineSet *lineSet );
+		
+		// see StarField::Draw
+		void Stars( StarField *field, r3::Texture2D *tex, float minMagnitude, float maxMagnitude, float scale );
+		// see StarCatalog::Draw
+		void Stars( StarCatalog *catalog, r3::Texture2D *tex, const r3::Vec3f & lookDir, float fov, float aspect,
+				   float minMagnitude, float maxMagnitude, float scale );
+		// see FlyoverPaths::Draw
+		void Flyover( FlyoverPaths *paths, const r3::Matrix4f & pathTransform, const r3::Vec3f & viewer, bool normalize, bool gaps );
+		
+		void AddText( const std::string & str, const r3::Matrix4f & xf, float x, float y, float scale, const r3::Vec4f & color );
+		// the text added since the last Text, as one batch
+		void Text();
+		
+		// a quad outline in normalized device coordinates
+		void Outline( const r3::OrientedBounds2f & ob, const r3::Vec4f & color );
+		
+	private:
+		friend void Submit( const DrawList & list );
+		
+		struct Command {
+			CommandType type;
+			int index;
+		};
+		struct EnableCmd {
+			GLenum cap;
+			bool enable;
+		};
+		struct BlendFuncCmd {
+			GLenum src, dst;
+		};
+		struct MeshCmd {
+			r3::Model *model;
+			r3::Texture2D *tex;
+			r3::Vec4f color;
+		};
+		struct SpriteCmd {
+			TextureRegion region;
+			r3::Matrix4f xf;
+			r3::Vec4f color;
+		};
+		struct Billboard {
+			r3::Vec3f position;
+			float radius;
+			r3::Vec4f color;
+		};
+		struct BillboardsCmd {
+			BillboardBatch *batch;
+			r3::Texture2D *tex;
+			float maxUnitHeight;
+			float alphaCutoff;
+			int first, count;
+		};
+		struct LineColor {
+			int set;
+			r3::Vec4f color;
+		};
+		struct LinesCmd {
+			LineSet *lineSet;
+			int first, count;
+		};
+		// one of field or catalog
+		struct StarsCmd {
+			StarField *field;
+			StarCatalog *catalog;
+			r3::Texture2D *tex;
+			r3::Vec3f lookDir;
+			float fov, aspect;
+			float minMagnitude, maxMagnitude;
+			float scale;
+		};
+		struct FlyoverCmd {
+			FlyoverPaths *paths;
+			r3::Matrix4f pathTransform;
+			r3::Vec3f viewer;
+			bool normalize;
+			bool gaps;
+		};
+		struct TextCmd {
+			int first, count;
+		};
+		struct OutlineCmd {
+			r3::Vec2f vert[4];
+			r3::Vec4f color;
+		};
+		
+		void Record( CommandType type, int index );
+		
+		std::vector< Command > commands;
+		std::vector< r3::Matrix4f > matrices;
+		std::vector< EnableCmd > enables;
+		std::vector< BlendFuncCmd > blendFuncs;
+		std::vector< MeshCmd > meshes;
+		std::vector< SpriteCmd > sprites;
+		std::vector< Billboard > billboards;
+		std::vector< BillboardsCmd > billboardCmds;
+		std::vector< LineColor > lineColors;
+		std::vector< LinesCmd > lineCmds;
+		std::vector< StarsCmd > starCmds;
+		std::vector< FlyoverCmd > flyovers;
+		std::vector< TextRun > text;
+		std::vector< TextCmd > textCmds;
+		std::vector< OutlineCmd > outlines;
+		// start of the per object data not yet claimed by a command
+		int billboardsPending;
+		int lineColorsPending;
+		int textPending;
+	};
+	
+	// The GL backend: replays list on the current context.  The projection,
+	// modelview and enables are saved and restored around it.
+	void Submit( const DrawList & list );
+	
+}
+
+#endif //__STAR3MAP_DRAWLIST_H__
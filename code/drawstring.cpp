@@ -41,7 +41,9 @@
  */
 
 #include "drawstring.h"
+#include "drawlist.h"
 #include "render.h"
+#include "profile.h"
 
 #include "r3/common.h"
 #include "r3/bounds.h"
@@ -49,8 +51,7 @@
 #include "r3/output.h"
 #include "r3/var.h"
 
-#include <GL/Regal.h>
-
+#include <algorithm>
 #include <vector>
 #include <map>
 
@@ -66,85 +67,252 @@ extern VarInteger r_windowDpi;
 VarInteger app_debugLabels( "app_debugLabels", "draw debugging info for labels", 0, 0 );
 
 namespace {
+	
+	// Uniform grid over normalized device coordinates, so a query only tests
+	// the boxes in the cells it covers.  Boxes off screen are clamped into
+	// the border cells.
+	struct LabelGrid {
+		enum { Dim = 32 };
+		
+		LabelGrid() : query( 0 ) {}
+		
+		void Clear() {
+			for ( int i = 0; i < (int)touched.size(); i++ ) {
+				cell[ touched[ i ] ].clear();
+			}
+			touched.clear();
+			boxes.clear();
+			stamp.clear();
+		}
+		
+		void Insert( const OrientedBounds2f & ob ) {
+			int x0, y0, x1, y1;
+			CellRange( ob, x0, y0, x1, y1 );
+			int id = (int)boxes.size();
+			boxes.push_back( ob );
+			stamp.push_back( 0 );
+			for ( int j = y0; j <= y1; j++ ) {
+				for ( int i = x0; i <= x1; i++ ) {
+					vector< int > & c = cell[ j * Dim + i ];
+					if ( c.size() == 0 ) {
+						touched.push_back( j * Dim + i );
+					}
+					c.push_back( id );
+				}
+			}
+		}
 		
+		bool Overlaps( const OrientedBounds2f & ob ) {
+			if ( boxes.size() == 0 ) {
+				return false;
+			}
+			int x0, y0, x1, y1;
+			CellRange( ob, x0, y0, x1, y1 );
+			query++;
+			for ( int j = y0; j <= y1; j++ ) {
+				for ( int i = x0; i <= x1; i++ ) {
+					vector< int > & c = cell[ j * Dim + i ];
+					for ( int k = 0; k < (int)c.size(); k++ ) {
+						int id = c[ k ];
+						if ( stamp[ id ] == query ) {
+							continue; // already tested via another cell
+						}
+						stamp[ id ] = query;
+						if ( Intersect( ob, boxes[ id ] ) ) {
+							return true;
+						}
+					}
+				}
+			}
+			return false;
+		}
+		
+		static int ToCell( float v ) {
+			int c = int( floor( ( v + 1.f ) * 0.5f * Dim ) );
+			return min( max( c, 0 ), Dim - 1 );
+		}
+		
+		static void CellRange( const OrientedBounds2f & ob, int & x0, int & y0, int & x1, int & y1 ) {
+			Vec2f lo = ob.vert[0];
+			Vec2f hi = ob.vert[0];
+			for ( int i = 1; i < 4; i++ ) {
+				lo.x = min( lo.x, ob.vert[i].x );
+				lo.y = min( lo.y, ob.vert[i].y );
+				hi.x = max( hi.x, ob.vert[i].x );
+				hi.y = max( hi.y, ob.vert[i].y );
+			}
+			x0 = ToCell( lo.x );
+			y0 = ToCell( lo.y );
+			x1 = ToCell( hi.x );
+			y1 = ToCell( hi.y );
+		}
+		
+		vector< int > cell[ Dim * Dim ];
+		vector< int > touched;
+		vector< OrientedBounds2f > boxes;
+		vector< int > stamp;
+		int query;
+	};
+	
+	// NDC distance a placed label may drift before it is tested again
+	const float LabelMoveThreshold = 0.01f;
+	
+	float MaxCornerDelta( const OrientedBounds2f & a, const OrientedBounds2f & b ) {
+		float d = 0;
+		for ( int i = 0; i < 4; i++ ) {
+			Vec2f v = a.vert[ i ] - b.vert[ i ];
+			d = max( d, max( fabs( v.x ), fabs( v.y ) ) );
+		}
+		return d;
+	}
+	
+	struct LabelCandidate {
+		string str;
+		Vec3f direction;
+		Vec4f color;
+		OrientedBounds2f ob;
+		float priority;
+		bool reservable;  // submitted while reservations were in effect
+		bool persistent;  // placed last frame
+		int order;
+	};
+	
+	bool PlaceFirst( const LabelCandidate * a, const LabelCandidate * b ) {
+		if ( a->priority != b->priority ) {
+			return a->priority > b->priority;
+		}
+		if ( a->persistent != b->persistent ) {
+			return a->persistent;
+		}
+		return a->order < b->order;
+	}
+	
 	struct DrawNonOverlappingStringsImpl : public star3map::DrawNonOverlappingStrings {
-		vector< OrientedBounds2f > reserved;
-		vector< OrientedBounds2f > obs;
+		LabelGrid reserved;
+		LabelGrid accepted;   // everything placed this frame (last frame, until End())
+		LabelGrid changed;    // placed this frame and new or moved
+		bool reservationsActive;
+		Matrix4f transform;
+		vector< LabelCandidate > candidates;
+		vector< LabelCandidate * > order;
+		// bounds of each placed label when it was last tested
+		map< string, OrientedBounds2f > placed;
+		map< string, OrientedBounds2f > nextPlaced;
+		
+		DrawNonOverlappingStringsImpl() : reservationsActive( true ) {}
+		
+		void Begin( const Matrix4f & modelviewProjection ) {
+			transform = modelviewProjection;
+			reserved.Clear();
+			reservationsActive = true;
+			candidates.clear();
+		}
 		
 		void ClearReservations() {
-			reserved.clear();
+			reservationsActive = false;
 		}
 		
 		bool CanDrawString( const string & str, const Vec3f & direction, const Vec3f & lookDir, float limit ) {
 			if ( lookDir.Dot( direction ) < limit ) {
 				return false;
 			}
-			OrientedBounds2f ob = StringBounds( str, direction );
-			for ( int i = 0; i < (int)obs.size(); i++ ) {
-				if ( Intersect( ob, obs[ i ] ) ) {
-					return false; // intersected, so don't draw this one
-				}
-			}
-			return true;
+			OrientedBounds2f ob = StringBounds( str, direction, transform );
+			return accepted.Overlaps( ob ) == false;
 		}
 		
 		void ReserveString( const string & str, const Vec3f & direction, const Vec3f & lookDir, float limit ) {
 			if ( lookDir.Dot( direction ) < limit ) {
 				return;
 			}
-			OrientedBounds2f ob = StringBounds( str, direction );
-			reserved.push_back( ob );
+			OrientedBounds2f ob = StringBounds( str, direction, transform );
+			if ( ob.empty == false ) {
+				reserved.Insert( ob );
+			}
 		}
 
-		void DrawString( const string & str, const Vec3f & direction, const Vec3f & lookDir, float limit ) {
+		void DrawString( const string & str, const Vec3f & direction, const Vec3f & lookDir, float limit, const Vec4f & color, float priority ) {
 			if ( lookDir.Dot( direction ) < limit ) {
 				return;
 			}
 			
-			OrientedBounds2f ob = StringBounds( str, direction );
+			OrientedBounds2f ob = StringBounds( str, direction, transform );
 			if ( ob.empty ) {
 				return;
 			}
-				
-			for ( int i = 0; i < (int)obs.size(); i++ ) {
-				if ( Intersect( ob, obs[ i ] ) ) {
-					return; // intersected, so don't draw this one
-				}
+			LabelCandidate c;
+			c.str = str;
+			c.direction = direction;
+			c.color = color;
+			c.ob = ob;
+			c.priority = priority;
+			c.reservable = reservationsActive;
+			c.persistent = placed.count( str ) != 0;
+			c.order = (int)candidates.size();
+			candidates.push_back( c );
+		}
+		
+		void End( DrawList & list ) {
+			accepted.Clear();
+			changed.Clear();
+			nextPlaced.clear();
+			order.resize( candidates.size() );
+			for ( int i = 0; i < (int)candidates.size(); i++ ) {
+				order[ i ] = &candidates[ i ];
 			}
-			for ( int i = 0; i < (int)reserved.size(); i++ ) {
-				if ( Intersect( ob, reserved[ i ] ) ) {
-					return; // intersected, so don't draw this one
+			sort( order.begin(), order.end(), PlaceFirst );
+			int retested = 0;
+			for ( int i = 0; i < (int)order.size(); i++ ) {
+				LabelCandidate & c = *order[ i ];
+				if ( nextPlaced.count( c.str ) ) {
+					continue; // same label submitted twice
+				}
+				if ( c.reservable && reserved.Overlaps( c.ob ) ) {
+					continue;
 				}
+				map< string, OrientedBounds2f >::iterator p = placed.find( c.str );
+				bool steady = p != placed.end() && MaxCornerDelta( p->second, c.ob ) < LabelMoveThreshold;
+				if ( steady ) {
+					// still clear of the other steady labels, only new or moved ones can collide
+					if ( changed.Overlaps( c.ob ) ) {
+						continue;
+					}
+					nextPlaced[ c.str ] = p->second;
+				} else {
+					retested++;
+					if ( accepted.Overlaps( c.ob ) ) {
+						continue;
+					}
+					changed.Insert( c.ob );
+					nextPlaced[ c.str ] = c.ob;
+				}
+				accepted.Insert( c.ob );
+				Draw( list, c );
 			}
-			obs.push_back( ob );
-			::DrawString( str, direction );
-			if ( app_debugLabels.GetVal() ) {
-				if ( app_debugLabels.GetVal() > 1 ) {
+			placed.swap( nextPlaced );
+			candidates.clear();
+			ProfileCounter( "labels placed", (float)placed.size() );
+			ProfileCounter( "labels retested", (float)retested );
+		}
+		
+		void Draw( DrawList & list, const LabelCandidate & c ) {
+			const OrientedBounds2f & ob = c.ob;
+			::DrawString( list, c.str, c.direction, c.color );
+			if ( frameSettings.debugLabels ) {
+				if ( frameSettings.debugLabels > 1 ) {
 					float len = 0;
 					for ( int i = 0; i < 4; i++ ) {
 						len = max( len, ( ob.vert[ i ] - ob.vert[ (i+1)%4 ] ).Length() );
 					}
 					if ( len > 10 ) {
 						Output( "bounds %d %s: ( %f, %f ), ( %f, %f ), ( %f, %f ), ( %f, %f )",
-							   (int)obs.size(), str.c_str(),
+							   (int)accepted.boxes.size(), c.str.c_str(),
 							   ob.vert[0].x, ob.vert[0].y,
 							   ob.vert[1].x, ob.vert[1].y,
 							   ob.vert[2].x, ob.vert[2].y,
 							   ob.vert[3].x, ob.vert[3].y );					
 					}
 				}
-                glMatrixPushEXT( GL_MODELVIEW );
-                glMatrixLoadIdentityEXT( GL_MODELVIEW );
-                glColor4f( 1, 1, 0, 1 );
-
-                glBegin( GL_LINE_STRIP );
-				glVertex3fv( ob.vert[0].Ptr() );
-				glVertex3fv( ob.vert[1].Ptr() );
-				glVertex3fv( ob.vert[2].Ptr() );
-				glVertex3fv( ob.vert[3].Ptr() );
-				glVertex3fv( ob.vert[0].Ptr() );
-                glEnd();
-                glMatrixPopEXT( GL_MODELVIEW );
+				list.Outline( ob, Vec4f( 1, 1, 0, 1 ) );
 			}
 		}
 	};
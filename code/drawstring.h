@@ -49,11 +49,29 @@
 
 namespace star3map {
 
+	class DrawList;
+
+	// Higher priorities are placed first: sightings, then special objects
+	// (planets, the ISS...), then by brightness.
+	inline float LabelPriority( float magnitude, bool special = false, bool sighted = false ) {
+		return ( sighted ? 100.f : 0.f ) + ( special ? 50.f : 0.f ) - magnitude;
+	}
+	
+	// Labels submitted with DrawString are placed at End(), by priority.
+	// Labels that were placed last frame and have barely moved on screen are
+	// only tested against labels that are new or moved, so they stay put
+	// while panning and steady state layout only does work for the delta.
 	struct DrawNonOverlappingStrings {
 		virtual ~DrawNonOverlappingStrings() {}
+		// start a frame; modelviewProjection is what labels will be drawn with
+		virtual void Begin( const r3::Matrix4f & modelviewProjection ) = 0;
+		// place the submitted labels and record them into list
+		virtual void End( DrawList & list ) = 0;
+		// tests against the labels placed last frame
 		virtual bool CanDrawString( const std::string & str, const r3::Vec3f & direction, const r3::Vec3f & lookDir, float limit ) = 0;		
+		// keeps labels submitted before ClearReservations() out of this area
 		virtual void ReserveString( const std::string & str, const r3::Vec3f & direction, const r3::Vec3f & lookDir, float limit ) = 0;		
-		virtual void DrawString( const std::string & str, const r3::Vec3f & direction, const r3::Vec3f & lookDir, float limit ) = 0;
+		virtual void DrawString( const std::string & str, const r3::Vec3f & direction, const r3::Vec3f & lookDir, float limit, const r3::Vec4f & color, float priority ) = 0;
 		virtual void ClearReservations() = 0;
 	};
 	
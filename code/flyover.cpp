@@ -0,0 +1,167 @@
+/*
+ *  flyover
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "flyover.h"
+#include "render.h"
+#include "profile.h"
+
+#include "r3/shader.h"
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	Shader *flyoverShader;
+	
+	Shader * GetFlyoverShader() {
+		if ( flyoverShader == NULL ) {
+			Shader * s = flyoverShader = CreateShaderFromFile( "flyover" );
+			glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
+			glBindAttribLocation( s->pgObject, AL_Color, "Color" );
+			glLinkProgram( s->pgObject );
+		}
+		return flyoverShader;
+	}
+	
+	const unsigned char specialColor[4] = { 255, 255, 255, 128 };
+	const unsigned char normalColor[4] = { 255, 255, 0, 128 };
+	const unsigned char gapColor[4] = { 0, 0, 0, 128 };
+	
+	// last point of the path that is above the viewer's threshold
+	int LastVisible( const SatellitePath & sp ) {
+		int last = (int)sp.pathPoint.size() - 1;
+		while( last >= 0 && sp.pathPoint[ last ].aboveThreshold == false ) {
+			last--;
+		}
+		return last;
+	}
+	
+}
+
+namespace star3map {
+	
+	FlyoverPaths::FlyoverPaths() : buffer( 0 ), hashVerts( 0 ), totalVerts( 0 ) {
+	}
+	
+	FlyoverPaths::~FlyoverPaths() {
+		if ( buffer ) {
+			glDeleteBuffers( 1, &buffer );
+		}
+	}
+	
+	void FlyoverPaths::AddSegment( const PathPoint & a, const PathPoint & b, const unsigned char * c ) {
+		Vert v;
+		for ( int i = 0; i < 4; i++ ) {
+			v.c[i] = c[i];
+		}
+		v.pos = a.pos;
+		verts.push_back( v );
+		v.pos = b.pos;
+		verts.push_back( v );
+	}
+	
+	void FlyoverPaths::Update( const vector< SatellitePath > & paths ) {
+		PROFILE_ZONE( "FlyoverPaths::Update" );
+		verts.clear();
+		// hashes: every other segment, skipping the ones that would straddle a minute
+		for( int i = 0; i < (int)paths.size(); i++ ) {
+			const SatellitePath & sp = paths[i];
+			int last = LastVisible( sp );
+			const unsigned char * c = sp.special ? specialColor : normalColor;
+			for( int j = 0; j + 1 < last; j += 2 ) {
+				if ( j < (last - 2) ) {
+					int now = int( sp.pathPoint[ j + 0 ].minutesFromEpoch );
+					int nxt = int( sp.pathPoint[ j + 2 ].minutesFromEpoch );
+					if( now != nxt ) {
+						continue;
+					}
+				}
+				AddSegment( sp.pathPoint[ j ], sp.pathPoint[ j + 1 ], c );
+			}
+		}
+		hashVerts = (int)verts.size();
+		// the space between hashes
+		for( int i = 0; i < (int)paths.size(); i++ ) {
+			const SatellitePath & sp = paths[i];
+			int last = LastVisible( sp );
+			for( int j = 1; j + 1 < last; j += 2 ) {
+				AddSegment( sp.pathPoint[ j ], sp.pathPoint[ j + 1 ], gapColor );
+			}
+		}
+		totalVerts = (int)verts.size();
+		if ( totalVerts == 0 ) {
+			return;
+		}
+		if ( buffer == 0 ) {
+			glGenBuffers( 1, &buffer );
+		}
+		// respecifying the whole store orphans the copy a pending draw may still be reading
+		glNamedBufferDataEXT( buffer, totalVerts * sizeof( Vert ), &verts[0], GL_DYNAMIC_DRAW );
+	}
+	
+	void FlyoverPaths::Draw( const Matrix4f & pathTransform, const Vec3f & viewer, bool normalize, bool gaps ) {
+		int count = gaps ? totalVerts : hashVerts;
+		ProfileCounter( "flyover verts", (float)count );
+		if ( count == 0 ) {
+			return;
+		}
+		PROFILE_ZONE( "FlyoverPaths::Draw" );
+		Shader *s = GetFlyoverShader();
+		glUseProgram( s->pgObject );
+		glUniformMatrix4fv( glGetUniformLocation( s->pgObject, "PathTransform" ), 1, GL_FALSE, pathTransform.Ptr() );
+		s->SetUniform( "Viewer", viewer );
+		s->SetUniform( "NormalizeToSphere", normalize ? 1.f : 0.f );
+		glBindBuffer( GL_ARRAY_BUFFER, buffer );
+		glVertexAttribPointer( AL_Position, 3, GL_FLOAT, GL_FALSE, sizeof( Vert ), 0 );
+		glEnableVertexAttribArray( AL_Position );
+		glVertexAttribPointer( AL_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( Vert ), (const GLvoid *)sizeof( Vec3f ) );
+		glEnableVertexAttribArray( AL_Color );
+		glDrawArrays( GL_LINES, 0, count );
+		glDisableVertexAttribArray( AL_Color );
+		glDisableVertexAttribArray( AL_Position );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		glUseProgram( 0 );
+	}
+	
+}
@@ -0,0 +1,88 @@
+/*
+ *  flyover
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_FLYOVER_H__
+#define __STAR3MAP_FLYOVER_H__
+
+#include "satellite.h"
+
+#include "r3/linear.h"
+
+#include <GL/Regal.h>
+
+#include <vector>
+
+namespace star3map {
+
+	// Satellite flyover paths as one vertex buffer of line segments, rebuilt
+	// only when the path snapshot changes.  The hashes come first and the
+	// spaces between them after, so drawing without gaps is just a shorter
+	// range.  Positions stay in the paths' earth fixed km, and the view
+	// dependent transform is applied in base/flyover.vp.
+	class FlyoverPaths {
+	public:
+		FlyoverPaths();
+		~FlyoverPaths();
+		
+		void Update( const std::vector< SatellitePath > & paths );
+		
+		// Draws with the current modelview and projection.  Points are
+		// transformed by pathTransform, made relative to viewer, and if
+		// normalize is set projected onto the unit sphere around the viewer.
+		void Draw( const r3::Matrix4f & pathTransform, const r3::Vec3f & viewer, bool normalize, bool gaps );
+		
+	private:
+		struct Vert {
+			r3::Vec3f pos;
+			unsigned char c[4];
+		};
+		void AddSegment( const PathPoint & a, const PathPoint & b, const unsigned char * c );
+		
+		GLuint buffer;
+		std::vector< Vert > verts;
+		int hashVerts;
+		int totalVerts;
+	};
+	
+}
+
+#endif //__STAR3MAP_FLYOVER_H__
@@ -0,0 +1,153 @@
+/*
+ *  lineset
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "lineset.h"
+#include "profile.h"
+
+#include "r3/output.h"
+#include "r3/shader.h"
+
+#include <GL/Regal.h>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	Shader *linesShader;
+	GLint setColorLoc;
+	
+	Shader * GetLinesShader() {
+		if ( linesShader == NULL ) {
+			Shader * s = linesShader = CreateShaderFromFile( "lines" );
+			glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
+			glLinkProgram( s->pgObject );
+			setColorLoc = glGetUniformLocation( s->pgObject, "SetColor" );
+		}
+		return linesShader;
+	}
+	
+}
+
+namespace star3map {
+	
+	LineSet::LineSet() : buffer( 0 ) {
+	}
+	
+	LineSet::~LineSet() {
+		if ( buffer ) {
+			glDeleteBuffers( 1, &buffer );
+		}
+	}
+	
+	void LineSet::Build( const vector< Lines > & lines ) {
+		int sets = (int)lines.size();
+		if ( sets > MaxSets ) {
+			Output( "LineSet: only drawing the first %d of %d line sets.", MaxSets, sets );
+			sets = MaxSets;
+		}
+		// xyz plus the set index in w, which selects the color in the shader
+		vector< Vec4f > verts;
+		first.resize( sets );
+		count.resize( sets );
+		for ( int i = 0; i < sets; i++ ) {
+			const Lines & l = lines[ i ];
+			first[ i ] = (GLint)verts.size();
+			count[ i ] = (GLsizei)l.vert.size();
+			for ( int j = 0; j < (int)l.vert.size(); j++ ) {
+				const Vec3f & v = l.vert[ j ];
+				verts.push_back( Vec4f( v.x, v.y, v.z, float( i ) ) );
+			}
+		}
+		color.assign( MaxSets, Vec4f( 0, 0, 0, 0 ) );
+		drawFirst.reserve( sets );
+		drawCount.reserve( sets );
+		if ( buffer == 0 ) {
+			glGenBuffers( 1, &buffer );
+		}
+		glNamedBufferDataEXT( buffer, verts.size() * sizeof( Vec4f ), verts.size() ? &verts[0] : NULL, GL_STATIC_DRAW );
+	}
+	
+	void LineSet::SetColor( int set, const Vec4f & c ) {
+		if ( set >= 0 && set < Size() ) {
+			color[ set ] = c;
+		}
+	}
+	
+	void LineSet::Draw() {
+		drawFirst.clear();
+		drawCount.clear();
+		for ( int i = 0; i < Size(); i++ ) {
+			if ( color[ i ].w > 0.f && count[ i ] > 0 ) {
+				drawFirst.push_back( first[ i ] );
+				drawCount.push_back( count[ i ] );
+			}
+		}
+		ProfileCounter( "line sets", (float)drawFirst.size() );
+		if ( drawFirst.size() == 0 ) {
+			return;
+		}
+		PROFILE_ZONE( "LineSet::Draw" );
+		Shader *s = GetLinesShader();
+		glUseProgram( s->pgObject );
+		glUniform4fv( setColorLoc, Size(), color[0].Ptr() );
+		glBindBuffer( GL_ARRAY_BUFFER, buffer );
+		glVertexAttribPointer( AL_Position, 4, GL_FLOAT, GL_FALSE, sizeof( Vec4f ), 0 );
+		glEnableVertexAttribArray( AL_Position );
+#if ANDROID || IPHONE
+		// ES 2.0 has no multi-draw
+		for ( int i = 0; i < (int)drawFirst.size(); i++ ) {
+			glDrawArrays( GL_LINES, drawFirst[i], drawCount[i] );
+		}
+#else
+		glMultiDrawArrays( GL_LINES, &drawFirst[0], &drawCount[0], (GLsizei)drawFirst.size() );
+#endif
+		glDisableVertexAttribArray( AL_Position );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+		glUseProgram( 0 );
+		for ( int i = 0; i < Size(); i++ ) {
+			color[ i ].w = 0.f;
+		}
+	}
+	
+}
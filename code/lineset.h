@@ -0,0 +1,83 @@
+/*
+ *  lineset
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_LINESET_H__
+#define __STAR3MAP_LINESET_H__
+
+#include "render.h"
+
+#include <string>
+#include <vector>
+
+namespace star3map {
+
+	// The segments of a fixed list of Lines, uploaded to one static vertex
+	// buffer.  Each set gets its color for the frame with SetColor, and Draw
+	// issues a single multi-draw over the sets that were given one.
+	class LineSet {
+	public:
+		// matches the SetColor array in base/lines.vp
+		enum { MaxSets = 96 };
+		
+		LineSet();
+		~LineSet();
+		
+		void Build( const std::vector< Lines > & lines );
+		int Size() const { return (int)first.size(); }
+		
+		void SetColor( int set, const r3::Vec4f & color );
+		// draws with the current modelview and projection, then clears all colors
+		void Draw();
+		
+	private:
+		GLuint buffer;
+		std::vector< GLint > first;
+		std::vector< GLsizei > count;
+		std::vector< r3::Vec4f > color;
+		// scratch for the sets drawn this frame
+		std::vector< GLint > drawFirst;
+		std::vector< GLsizei > drawCount;
+	};
+	
+}
+
+#endif //__STAR3MAP_LINESET_H__
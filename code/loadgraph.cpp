@@ -0,0 +1,267 @@
+/*
+ *  loadgraph
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "loadgraph.h"
+#include "profile.h"
+
+#include "r3/output.h"
+#include "r3/thread.h"
+#include "r3/time.h"
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	// Idle threads poll rather than wait on a condition: r3::Condition has no
+	// predicate, so a broadcast that lands between dropping the mutex and
+	// calling Wait() is lost.  Loading is short, so a brief sleep is cheap.
+	const int idleMsec = 1;
+	
+	struct LoadWorker : public r3::Thread {
+		LoadWorker( LoadGraph * g ) : r3::Thread( "Loader" ), graph( g ) {
+		}
+		void Run() {
+			ProfileSetThreadName( "Loader" );
+			graph->Work();
+		}
+		LoadGraph * graph;
+	};
+	
+}
+
+namespace star3map {
+	
+	LoadGraph::LoadGraph() : numDone( 0 ), begin( 0.0 ), end( 0.0 ) {
+	}
+	
+	int LoadGraph::Add( const string & name, LoadFunc cpu, LoadFunc upload, void *data ) {
+		Node n;
+		n.name = name;
+		n.cpu = cpu;
+		n.upload = upload;
+		n.data = data;
+		n.state = State_Waiting;
+		n.reported = false;
+		n.ready = n.cpuBegin = n.cpuEnd = n.uploadBegin = n.uploadEnd = 0.0;
+		nodes.push_back( n );
+		return (int)nodes.size() - 1;
+	}
+	
+	void LoadGraph::DependsOn( int node, int dependency ) {
+		if ( node < 0 || dependency < 0 ) {
+			return;
+		}
+		nodes[ node ].dependencies.push_back( dependency );
+	}
+	
+	// ProfileTime() rather than GetTime(), since the NTP node moves the time offset
+	double LoadGraph::Now() const {
+		return ProfileTime() - begin;
+	}
+	
+	// call with the mutex held
+	void LoadGraph::Promote() {
+		for ( int i = 0; i < (int)nodes.size(); i++ ) {
+			Node & n = nodes[i];
+			if ( n.state != State_Waiting ) {
+				continue;
+			}
+			bool ready = true;
+			for ( int j = 0; j < (int)n.dependencies.size() && ready; j++ ) {
+				ready = nodes[ n.dependencies[j] ].state == State_Done;
+			}
+			if ( ready ) {
+				n.ready = Now();
+				n.state = n.cpu ? State_CpuReady : State_UploadReady;
+			}
+		}
+	}
+	
+	// call with the mutex held
+	int LoadGraph::Take( StateEnum from, StateEnum to ) {
+		for ( int i = 0; i < (int)nodes.size(); i++ ) {
+			if ( nodes[i].state == from ) {
+				nodes[i].state = to;
+				return i;
+			}
+		}
+		return -1;
+	}
+	
+	void LoadGraph::RunCpu( int i ) {
+		Node & n = nodes[i];
+		n.cpuBegin = Now();
+		{
+			PROFILE_ZONE( "LoadGraph::Cpu" );
+			n.cpu( n.data );
+		}
+		{
+			ProfiledScopedMutex scmutex( mutex, R3_LOC );
+			n.cpuEnd = Now();
+			if ( n.upload ) {
+				n.state = State_UploadReady;
+			} else {
+				n.state = State_Done;
+				numDone++;
+			}
+		}
+	}
+	
+	void LoadGraph::RunUpload( int i ) {
+		Node & n = nodes[i];
+		n.uploadBegin = Now();
+		{
+			PROFILE_ZONE( "LoadGraph::Upload" );
+			if ( n.upload ) {
+				n.upload( n.data );
+			}
+		}
+		{
+			ProfiledScopedMutex scmutex( mutex, R3_LOC );
+			n.uploadEnd = Now();
+			n.state = State_Done;
+			numDone++;
+		}
+	}
+	
+	void LoadGraph::Work() {
+		while( 1 ) {
+			int i;
+			{
+				ProfiledScopedMutex scmutex( mutex, R3_LOC );
+				Promote();
+				if ( numDone == (int)nodes.size() ) {
+					return;
+				}
+				i = Take( State_CpuReady, State_Cpu );
+			}
+			if ( i < 0 ) {
+				SleepMilliseconds( idleMsec );
+				continue;
+			}
+			RunCpu( i );
+		}
+	}
+	
+	void LoadGraph::Run( int numWorkers, LoadProgressFunc progress ) {
+		PROFILE_ZONE( "LoadGraph::Run" );
+		begin = ProfileTime();
+		numDone = 0;
+		for ( int i = 0; i < (int)nodes.size(); i++ ) {
+			nodes[i].state = State_Waiting;
+			nodes[i].reported = false;
+		}
+		
+		vector< LoadWorker * > workers;
+		for ( int i = 0; i < numWorkers; i++ ) {
+			workers.push_back( new LoadWorker( this ) );
+			workers.back()->Start();
+		}
+		
+		vector< int > finished;
+		while( 1 ) {
+			int upload = -1;
+			int cpu = -1;
+			bool done;
+			finished.clear();
+			{
+				ProfiledScopedMutex scmutex( mutex, R3_LOC );
+				Promote();
+				for ( int i = 0; i < (int)nodes.size(); i++ ) {
+					if ( nodes[i].state == State_Done && nodes[i].reported == false ) {
+						nodes[i].reported = true;
+						finished.push_back( i );
+					}
+				}
+				done = numDone == (int)nodes.size();
+				upload = Take( State_UploadReady, State_Upload );
+				if ( upload < 0 && numWorkers == 0 ) {
+					cpu = Take( State_CpuReady, State_Cpu );
+				}
+			}
+			// progress may touch GL, so only ever from this thread
+			for ( int i = 0; i < (int)finished.size(); i++ ) {
+				if ( progress ) {
+					progress( nodes[ finished[i] ].name );
+				}
+			}
+			if ( done ) {
+				break;
+			}
+			if ( upload >= 0 ) {
+				RunUpload( upload );
+			} else if ( cpu >= 0 ) {
+				RunCpu( cpu );
+			} else if ( finished.size() == 0 ) {
+				// only the workers can move things along now
+				SleepMilliseconds( idleMsec );
+			}
+		}
+		end = Now();
+		
+		// workers leave Work() on their next poll, once they see every node done
+		for ( int i = 0; i < (int)workers.size(); i++ ) {
+			workers[i]->Join();
+			delete workers[i];
+		}
+	}
+	
+	void LoadGraph::Report() const {
+		Output( "Load graph: %d nodes in %.1f ms", (int)nodes.size(), end * 1000.0 );
+		for ( int i = 0; i < (int)nodes.size(); i++ ) {
+			const Node & n = nodes[i];
+			double cpu = n.cpu ? n.cpuEnd - n.cpuBegin : 0.0;
+			double upload = n.upload ? n.uploadEnd - n.uploadBegin : 0.0;
+			// time spent ready but waiting for a worker or for this thread
+			double queued = ( n.cpu ? n.cpuBegin : n.uploadBegin ) - n.ready;
+			if ( n.cpu && n.upload ) {
+				queued += n.uploadBegin - n.cpuEnd;
+			}
+			double finish = n.upload ? n.uploadEnd : n.cpuEnd;
+			Output( "  %-16s ready %7.1f  queued %6.1f  cpu %6.1f  upload %6.1f  done %7.1f ms",
+				   n.name.c_str(), n.ready * 1000.0, queued * 1000.0, cpu * 1000.0, upload * 1000.0, finish * 1000.0 );
+		}
+	}
+	
+}
@@ -0,0 +1,120 @@
+/*
+ *  loadgraph
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_LOADGRAPH_H__
+#define __STAR3MAP_LOADGRAPH_H__
+
+#include "r3/thread.h"
+
+#include <string>
+#include <vector>
+
+namespace star3map {
+
+	typedef void (*LoadFunc)( void *data );
+	typedef void (*LoadProgressFunc)( const std::string & name );
+	
+	// Startup work as a dependency graph.  Each node has an optional cpu
+	// step, run on a worker thread, and an optional upload step, run on the
+	// thread that calls Run(), which must be the one owning the GL context.
+	// A node starts once every node it depends on has finished both steps.
+	class LoadGraph {
+	public:
+		LoadGraph();
+		
+		// returns the new node's index
+		int Add( const std::string & name, LoadFunc cpu, LoadFunc upload, void *data = NULL );
+		void DependsOn( int node, int dependency );
+		
+		// Blocks until every node is done.  With no workers, the cpu steps run
+		// on the calling thread too.  progress is called on the calling thread
+		// as each node finishes.
+		void Run( int numWorkers, LoadProgressFunc progress );
+		
+		// outputs the per-node timings of the last Run()
+		void Report() const;
+		
+		// worker thread body
+		void Work();
+		
+	private:
+		enum StateEnum {
+			State_Waiting,
+			State_CpuReady,
+			State_Cpu,
+			State_UploadReady,
+			State_Upload,
+			State_Done
+		};
+		
+		struct Node {
+			std::string name;
+			LoadFunc cpu;
+			LoadFunc upload;
+			void *data;
+			std::vector< int > dependencies;
+			StateEnum state;
+			bool reported;
+			// seconds since the start of Run()
+			double ready;
+			double cpuBegin;
+			double cpuEnd;
+			double uploadBegin;
+			double uploadEnd;
+		};
+		
+		void Promote();
+		int Take( StateEnum from, StateEnum to );
+		void RunCpu( int i );
+		void RunUpload( int i );
+		double Now() const;
+		
+		r3::Mutex mutex;
+		std::vector< Node > nodes;
+		int numDone;
+		double begin;
+		double end;
+	};
+	
+}
+
+#endif //__STAR3MAP_LOADGRAPH_H__
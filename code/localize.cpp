@@ -45,6 +45,8 @@
 #include "star3map.h"
 #include "ujson.h"
 #include "status.h"
+#include "log.h"
+#include "profile.h"
 
 
 #include "r3/filesystem.h"
@@ -60,6 +62,7 @@
 using namespace std;
 using namespace r3;
 using namespace ujson;
+using namespace star3map;
 
 VarString app_locale( "app_locale", "current locale", Var_Archive, "en_US" );
 
@@ -92,7 +95,7 @@ namespace {
             return;
         }                        
 
-		ScopedMutex scm( localizeMutex, R3_LOC );
+		ProfiledScopedMutex scm( localizeMutex, R3_LOC );
 		string file = app_locale.GetVal() + ".json";
 		vector<uchar> data;
 		if( FileReadToMemory( file, data ) == false ) {
@@ -133,7 +136,7 @@ namespace {
 		Output( "Fetched %d bytes from %s", data.size(), url.c_str() );
 		
 		if( data.size() > 20 ) {
-			ScopedMutex scm( localizeMutex, R3_LOC );
+			ProfiledScopedMutex scm( localizeMutex, R3_LOC );
 			string locFile = app_locale.GetVal() + ".json";
 			File *file = FileOpenForWrite( locFile );
 			if( file != NULL ) {
@@ -171,7 +174,7 @@ namespace {
                 condRender.Wait();
 				string req = "";
 				{
-					ScopedMutex scm( localizeMutex, R3_LOC );
+					ProfiledScopedMutex scm( localizeMutex, R3_LOC );
 					if( requests.size() > 0 ) {
 						req = requests.back();
 						requests.pop_back();
@@ -222,12 +225,12 @@ namespace star3map {
         if( app_locale.GetVal().substr( 0, 3 ) == "en_" ) {
             return key;
         }
-		ScopedMutex scm( localizeMutex, R3_LOC );
+		ProfiledScopedMutex scm( localizeMutex, R3_LOC );
 
 		if( loc.count( key ) == 0 ) {			
 			loc[ key ] = key;
 			requests.push_back( key );
-			Output( "Localize: %s", key.c_str() );
+			LogOutput( R3_LOC, "Localize: %s", key.c_str() );
 		}
 		// when localized text rendering works, we'll turn this on
 		if( disabled.count( app_locale.GetVal() ) == 0 ) {
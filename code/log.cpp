@@ -0,0 +1,234 @@
+/*
+ *  log
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "log.h"
+#include "atomic.h"
+#include "profile.h"
+
+#include "r3/common.h"
+#include "r3/output.h"
+#include "r3/thread.h"
+#include "r3/time.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if _WIN32
+# define vsnprintf _vsnprintf
+#endif
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+
+	const int RingSize = 256;     // power of two
+	const int MessageSize = 240;
+	const int MaxSites = 128;     // power of two
+	const int SiteBurst = 5;      // messages per site per second
+	
+	// Bounded MPSC ring.  A producer claims a slot by advancing enqueuePos,
+	// then publishes it by setting seq to pos + 1.  The writer consumes the
+	// slot and hands it back by setting seq to pos + RingSize.
+	struct LogSlot {
+		volatile int seq;
+		char text[ MessageSize ];
+	};
+	
+	LogSlot ring[ RingSize ];
+	volatile int enqueuePos;
+	int dequeuePos;
+	volatile int droppedFull;
+	
+	struct LogSite {
+		volatile int key;
+		volatile int second;
+		volatile int count;
+		volatile int suppressed;
+	};
+	
+	LogSite sites[ MaxSites ];
+	
+	volatile int ringInitialized;
+	volatile int writerStarted;
+	Mutex drainMutex;
+	
+	void InitRing() {
+		if ( ringInitialized == 2 ) {
+			return;
+		}
+		if ( AtomicCompareAndSwap( &ringInitialized, 0, 1 ) == 0 ) {
+			for ( int i = 0; i < RingSize; i++ ) {
+				ring[i].seq = i;
+			}
+			AtomicFence();
+			ringInitialized = 2;
+		}
+		while ( ringInitialized != 2 ) {
+			// another thread is setting up the ring
+		}
+	}
+	
+	// Pointer identity of __FILE__ is good enough here; two sites that hash
+	// alike just share a budget.
+	LogSite * GetSite( const char *file, int line ) {
+		int key = int( ( size_t( file ) * 31 + line ) & 0x7fffffff ) | 1;
+		int h = key;
+		for ( int i = 0; i < MaxSites; i++ ) {
+			LogSite & s = sites[ ( h + i ) & ( MaxSites - 1 ) ];
+			if ( s.key == key ) {
+				return &s;
+			}
+			if ( s.key == 0 ) {
+				int prev = AtomicCompareAndSwap( &s.key, 0, key );
+				if ( prev == 0 || prev == key ) {
+					return &s;
+				}
+			}
+		}
+		return NULL;
+	}
+	
+	bool Enqueue( const char *fmt, va_list args ) {
+		for ( ;; ) {
+			int pos = enqueuePos;
+			LogSlot & slot = ring[ pos & ( RingSize - 1 ) ];
+			int dif = slot.seq - pos;
+			if ( dif == 0 ) {
+				if ( AtomicCompareAndSwap( &enqueuePos, pos, pos + 1 ) == pos ) {
+					vsnprintf( slot.text, MessageSize, fmt, args );
+					slot.text[ MessageSize - 1 ] = 0;
+					AtomicFence();
+					slot.seq = pos + 1;
+					return true;
+				}
+			} else if ( dif < 0 ) {
+				AtomicAdd( &droppedFull, 1 );
+				return false;
+			}
+		}
+	}
+	
+	bool EnqueueFormat( const char *fmt, ... ) {
+		va_list args;
+		va_start( args, fmt );
+		bool ok = Enqueue( fmt, args );
+		va_end( args );
+		return ok;
+	}
+	
+	void Drain() {
+		ScopedMutex scm( drainMutex, R3_LOC );
+		for ( ;; ) {
+			LogSlot & slot = ring[ dequeuePos & ( RingSize - 1 ) ];
+			if ( slot.seq != dequeuePos + 1 ) {
+				break;
+			}
+			AtomicFence();
+			Output( "%s", slot.text );
+			AtomicFence();
+			slot.seq = dequeuePos + RingSize;
+			dequeuePos++;
+		}
+		int dropped = AtomicExchange( &droppedFull, 0 );
+		if ( dropped > 0 ) {
+			Output( "(log full, dropped %d messages)", dropped );
+		}
+	}
+	
+	struct LogWriterThread : public r3::Thread {
+		LogWriterThread() : r3::Thread( "LogWriter" ) {}
+		void Run() {
+			ProfileSetThreadName( "LogWriter" );
+			while( running ) {
+				Drain();
+				SleepMilliseconds( 20 );
+			}
+		}
+	};
+	LogWriterThread *logWriterThread;
+	
+}
+
+namespace star3map {
+
+	void LogOutput( const char *file, int line, const char *fmt, ... ) {
+		InitRing();
+		if ( writerStarted == 0 && AtomicCompareAndSwap( &writerStarted, 0, 1 ) == 0 ) {
+			logWriterThread = new LogWriterThread;
+			logWriterThread->Start();
+			// and drain what's still queued if anything calls exit()
+			atexit( LogFlush );
+		}
+		
+		LogSite *site = GetSite( file, line );
+		if ( site ) {
+			int second = int( ProfileTime() );
+			int prevSecond = site->second;
+			if ( prevSecond != second && AtomicCompareAndSwap( &site->second, prevSecond, second ) == prevSecond ) {
+				site->count = 0;
+				int suppressed = AtomicExchange( &site->suppressed, 0 );
+				if ( suppressed > 0 ) {
+					EnqueueFormat( "(%s:%d suppressed %d messages)", file, line, suppressed );
+				}
+			}
+			if ( AtomicAdd( &site->count, 1 ) > SiteBurst ) {
+				AtomicAdd( &site->suppressed, 1 );
+				return;
+			}
+		}
+		
+		va_list args;
+		va_start( args, fmt );
+		Enqueue( fmt, args );
+		va_end( args );
+	}
+	
+	void LogFlush() {
+		InitRing();
+		Drain();
+	}
+	
+}
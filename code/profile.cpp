@@ -0,0 +1,498 @@
+/*
+ *  profile
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "profile.h"
+#include "render.h"
+
+#include "r3/command.h"
+#include "r3/common.h"
+#include "r3/filesystem.h"
+#include "r3/output.h"
+#include "r3/thread.h"
+#include "r3/var.h"
+
+#include <GL/Regal.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#if _WIN32
+# include <windows.h>
+# define PROFILE_TLS __declspec( thread )
+#elif __APPLE__
+# include <mach/mach_time.h>
+# define PROFILE_TLS __thread
+#else
+# include <time.h>
+# define PROFILE_TLS __thread
+#endif
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+extern VarInteger r_windowWidth;
+extern VarInteger r_windowHeight;
+extern VarInteger r_windowDpi;
+
+VarBool app_profile( "app_profile", "record profiling zones and counters", 0, false );
+VarBool app_showProfile( "app_showProfile", "show frame time percentiles and zone timings", 0, false );
+VarBool app_profileLocks( "app_profileLocks", "accumulate mutex wait and hold times per call site", 0, false );
+
+namespace {
+
+	enum ProfileEventType {
+		PET_Zone,
+		PET_Counter
+	};
+	
+	struct ProfileEvent {
+		const char *name;
+		double begin;
+		double end;
+		float value;
+		int type;
+	};
+	
+	const int RingSize = 8192;  // power of two
+	const int MaxThreads = 16;
+	
+	struct ProfileRing {
+		ProfileRing() : tid( 0 ), head( 0 ) {}
+		void Push( const ProfileEvent & e ) {
+			ev[ head & ( RingSize - 1 ) ] = e;
+#if _WIN32
+			MemoryBarrier();
+#else
+			__sync_synchronize();
+#endif
+			head = head + 1;
+		}
+		string name;
+		int tid;
+		ProfileEvent ev[ RingSize ];
+		volatile unsigned int head;
+	};
+	
+	Mutex ringMutex;
+	ProfileRing *rings[ MaxThreads ];
+	int numRings;
+	PROFILE_TLS ProfileRing *threadRing;
+	PROFILE_TLS const char *threadName;
+	
+	ProfileRing * GetThreadRing() {
+		if ( threadRing == NULL ) {
+			ScopedMutex scm( ringMutex, R3_LOC );
+			if ( numRings >= MaxThreads ) {
+				return NULL;
+			}
+			ProfileRing *r = new ProfileRing;
+			r->tid = numRings + 1;
+			if ( threadName ) {
+				r->name = threadName;
+			} else {
+				char buf[32];
+				r3Sprintf( buf, "thread %d", r->tid );
+				r->name = buf;
+			}
+			rings[ numRings++ ] = r;
+			threadRing = r;
+		}
+		return threadRing;
+	}
+	
+	// per-frame zone totals, kept for the thread that calls ProfileFrame()
+	struct ZoneTotal {
+		const char *name;
+		double total;
+		int count;
+	};
+	const int MaxZoneTotals = 32;
+	ZoneTotal zoneTotals[ MaxZoneTotals ];
+	ZoneTotal lastZoneTotals[ MaxZoneTotals ];
+	int numZoneTotals;
+	int numLastZoneTotals;
+	ProfileRing *frameRing;
+	
+	struct CounterValue {
+		const char *name;
+		float value;
+	};
+	const int MaxCounters = 32;
+	CounterValue counters[ MaxCounters ];
+	int numCounters;
+	
+	const int FrameHistorySize = 128;
+	float frameHistory[ FrameHistorySize ];
+	int frameCount;
+	double lastFrameTime;
+	
+	double traceStartTime;
+	
+	void AddZoneTotal( const char *name, double dt ) {
+		for ( int i = 0; i < numZoneTotals; i++ ) {
+			if ( zoneTotals[i].name == name ) {
+				zoneTotals[i].total += dt;
+				zoneTotals[i].count++;
+				return;
+			}
+		}
+		if ( numZoneTotals < MaxZoneTotals ) {
+			ZoneTotal & zt = zoneTotals[ numZoneTotals++ ];
+			zt.name = name;
+			zt.total = dt;
+			zt.count = 1;
+		}
+	}
+	
+	float FramePercentile( vector<float> & sorted, float pct ) {
+		if ( sorted.size() == 0 ) {
+			return 0.0f;
+		}
+		int i = int( pct * ( sorted.size() - 1 ) + 0.5f );
+		return sorted[ max( 0, min( (int)sorted.size() - 1, i ) ) ];
+	}
+	
+	void ExportTrace( const string & filename ) {
+		string s = "{\"traceEvents\":[\n";
+		char buf[256];
+		bool first = true;
+		int nr;
+		{
+			ScopedMutex scm( ringMutex, R3_LOC );
+			nr = numRings;
+		}
+		int numEvents = 0;
+		for ( int r = 0; r < nr; r++ ) {
+			ProfileRing & ring = *rings[r];
+			r3Sprintf( buf, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+					  first ? "" : ",\n", ring.tid, ring.name.c_str() );
+			s += buf;
+			first = false;
+			unsigned int head = ring.head;
+			// leave some slack at the tail, since the owning thread may be overwriting it
+			unsigned int avail = min<unsigned int>( head, RingSize - 64 );
+			for ( unsigned int i = head - avail; i != head; i++ ) {
+				const ProfileEvent & e = ring.ev[ i & ( RingSize - 1 ) ];
+				double ts = ( e.begin - traceStartTime ) * 1e6;
+				if ( e.type == PET_Zone ) {
+					r3Sprintf( buf, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+							  e.name, ring.tid, ts, ( e.end - e.begin ) * 1e6 );
+				} else {
+					r3Sprintf( buf, ",\n{\"ph\":\"C\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%f}}",
+							  e.name, ring.tid, ts, e.value );
+				}
+				s += buf;
+				numEvents++;
+			}
+		}
+		s += "\n]}\n";
+		File *f = FileOpenForWrite( filename );
+		if ( f == NULL ) {
+			Output( "profileExport: unable to open %s for writing.", filename.c_str() );
+			return;
+		}
+		f->Write( s.c_str(), 1, (int)s.size() );
+		delete f;
+		Output( "profileExport: wrote %d events from %d threads to %s.", numEvents, nr, filename.c_str() );
+	}
+	
+	struct LockSite {
+		const char *file;
+		int line;
+		const char *label;
+		int count;
+		int contended;
+		double waitTotal;
+		double waitMax;
+		double holdTotal;
+		double holdMax;
+	};
+	const int MaxLockSites = 64;
+	Mutex lockSiteMutex;
+	LockSite lockSites[ MaxLockSites ];
+	int numLockSites;
+	// Kept across lockReset, since trace zones hold on to the label pointers.
+	map< pair< const char *, int >, string > lockLabels;
+	
+	// waits shorter than this are treated as uncontended
+	const double ContendedWait = 0.00005;
+	
+	struct CompareLockWait {
+		bool operator() ( const LockSite *a, const LockSite *b ) const {
+			return a->waitTotal > b->waitTotal;
+		}
+	};
+	
+	void LockReport( const vector< Token > & tokens ) {
+		ScopedMutex scm( lockSiteMutex, R3_LOC );
+		vector< LockSite * > sorted;
+		for ( int i = 0; i < numLockSites; i++ ) {
+			sorted.push_back( & lockSites[i] );
+		}
+		sort( sorted.begin(), sorted.end(), CompareLockWait() );
+		if ( app_profileLocks.GetVal() == false ) {
+			Output( "lockReport: app_profileLocks is off, report may be stale." );
+		}
+		Output( "%-28s %8s %8s %10s %9s %10s %9s", "site", "count", "waited", "wait ms", "max ms", "hold ms", "max ms" );
+		for ( int i = 0; i < (int)sorted.size(); i++ ) {
+			LockSite & ls = *sorted[i];
+			Output( "%-28s %8d %8d %10.2f %9.3f %10.2f %9.3f", ls.label, ls.count, ls.contended,
+				   ls.waitTotal * 1000.0, ls.waitMax * 1000.0, ls.holdTotal * 1000.0, ls.holdMax * 1000.0 );
+		}
+	}
+	CommandFunc LockReportCmd( "lockReport", "print mutex wait and hold times per call site, worst wait first", LockReport );
+	
+	void LockReset( const vector< Token > & tokens ) {
+		ScopedMutex scm( lockSiteMutex, R3_LOC );
+		numLockSites = 0;
+	}
+	CommandFunc LockResetCmd( "lockReset", "clear the accumulated mutex timings", LockReset );
+	
+	void ProfileExport( const vector< Token > & tokens ) {
+		ExportTrace( tokens.size() > 1 ? tokens[1].valString : string( "profile_trace.json" ) );
+	}
+	CommandFunc ProfileExportCmd( "profileExport", "write recorded profile zones as Chrome trace json", ProfileExport );
+	
+}
+
+namespace star3map {
+
+	bool profileEnabled = false;
+	bool lockProfileEnabled = false;
+	
+	double ProfileTime() {
+#if _WIN32
+		static LARGE_INTEGER freq;
+		if ( freq.QuadPart == 0 ) {
+			QueryPerformanceFrequency( & freq );
+		}
+		LARGE_INTEGER t;
+		QueryPerformanceCounter( & t );
+		return double( t.QuadPart ) / double( freq.QuadPart );
+#elif __APPLE__
+		static mach_timebase_info_data_t tb;
+		if ( tb.denom == 0 ) {
+			mach_timebase_info( & tb );
+		}
+		return double( mach_absolute_time() ) * tb.numer / tb.denom * 1e-9;
+#else
+		struct timespec ts;
+		clock_gettime( CLOCK_MONOTONIC, & ts );
+		return double( ts.tv_sec ) + double( ts.tv_nsec ) * 1e-9;
+#endif
+	}
+	
+	// the ring itself is only allocated once the thread records something
+	void ProfileSetThreadName( const char *name ) {
+		threadName = name;
+		if ( threadRing ) {
+			ScopedMutex scm( ringMutex, R3_LOC );
+			threadRing->name = name;
+		}
+	}
+	
+	void ProfileRecordZone( const char *name, double begin, double end ) {
+		ProfileRing *r = GetThreadRing();
+		if ( r == NULL ) {
+			return;
+		}
+		ProfileEvent e;
+		e.name = name;
+		e.begin = begin;
+		e.end = end;
+		e.value = 0.0f;
+		e.type = PET_Zone;
+		r->Push( e );
+		if ( r == frameRing ) {
+			AddZoneTotal( name, end - begin );
+		}
+	}
+	
+	void ProfileCounter( const char *name, float value ) {
+		if ( profileEnabled == false ) {
+			return;
+		}
+		ProfileRing *r = GetThreadRing();
+		if ( r == NULL ) {
+			return;
+		}
+		ProfileEvent e;
+		e.name = name;
+		e.begin = e.end = ProfileTime();
+		e.value = value;
+		e.type = PET_Counter;
+		r->Push( e );
+		for ( int i = 0; i < numCounters; i++ ) {
+			if ( counters[i].name == name ) {
+				counters[i].value = value;
+				return;
+			}
+		}
+		ScopedMutex scm( ringMutex, R3_LOC );
+		if ( numCounters < MaxCounters ) {
+			counters[ numCounters ].name = name;
+			counters[ numCounters ].value = value;
+			numCounters++;
+		}
+	}
+	
+	void ProfileRecordLock( const char *file, int line, double waitBegin, double acquired, double released ) {
+		double wait = acquired - waitBegin;
+		double hold = released - acquired;
+		LockSite *ls = NULL;
+		const char *label = NULL;
+		{
+			ScopedMutex scm( lockSiteMutex, R3_LOC );
+			for ( int i = 0; i < numLockSites; i++ ) {
+				if ( lockSites[i].line == line && lockSites[i].file == file ) {
+					ls = & lockSites[i];
+					break;
+				}
+			}
+			if ( ls == NULL ) {
+				if ( numLockSites == MaxLockSites ) {
+					return;
+				}
+				ls = & lockSites[ numLockSites++ ];
+				memset( ls, 0, sizeof( LockSite ) );
+				ls->file = file;
+				ls->line = line;
+				string & l = lockLabels[ make_pair( file, line ) ];
+				if ( l.empty() ) {
+					const char *base = max( strrchr( file, '/' ), strrchr( file, '\\' ) );
+					char buf[64];
+					r3Sprintf( buf, "%.50s:%d", base ? base + 1 : file, line );
+					l = buf;
+				}
+				ls->label = l.c_str();
+			}
+			label = ls->label;
+			ls->count++;
+			ls->waitTotal += wait;
+			ls->waitMax = max( ls->waitMax, wait );
+			ls->holdTotal += hold;
+			ls->holdMax = max( ls->holdMax, hold );
+			if ( wait > ContendedWait ) {
+				ls->contended++;
+			}
+		}
+		// contended waits also show up on the trace timeline
+		if ( profileEnabled && wait > ContendedWait ) {
+			ProfileRecordZone( label, waitBegin, acquired );
+		}
+	}
+	
+	void ProfileFrame() {
+		double t = ProfileTime();
+		if ( traceStartTime == 0.0 ) {
+			traceStartTime = t;
+		}
+		if ( lastFrameTime != 0.0 ) {
+			frameHistory[ frameCount % FrameHistorySize ] = float( ( t - lastFrameTime ) * 1000.0 );
+			frameCount++;
+		}
+		lastFrameTime = t;
+		
+		for ( int i = 0; i < numZoneTotals; i++ ) {
+			lastZoneTotals[i] = zoneTotals[i];
+		}
+		numLastZoneTotals = numZoneTotals;
+		numZoneTotals = 0;
+		
+		profileEnabled = app_profile.GetVal() || app_showProfile.GetVal();
+		lockProfileEnabled = app_profileLocks.GetVal();
+		if ( profileEnabled && frameRing == NULL ) {
+			ProfileSetThreadName( "render" );
+			frameRing = GetThreadRing();
+		}
+	}
+	
+	void RenderProfileOverlay() {
+		if ( app_showProfile.GetVal() == false ) {
+			return;
+		}
+		int n = min( frameCount, FrameHistorySize );
+		vector<float> sorted( frameHistory, frameHistory + n );
+		sort( sorted.begin(), sorted.end() );
+		
+		vector< string > lines;
+		char buf[128];
+		r3Sprintf( buf, "frame ms  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f",
+				  FramePercentile( sorted, 0.5f ), FramePercentile( sorted, 0.9f ),
+				  FramePercentile( sorted, 0.99f ), n > 0 ? sorted.back() : 0.0f );
+		lines.push_back( buf );
+		for ( int i = 0; i < numLastZoneTotals; i++ ) {
+			ZoneTotal & zt = lastZoneTotals[i];
+			r3Sprintf( buf, "%s  %.2f ms (%d)", zt.name, zt.total * 1000.0, zt.count );
+			lines.push_back( buf );
+		}
+		for ( int i = 0; i < numCounters; i++ ) {
+			r3Sprintf( buf, "%s  %g", counters[i].name, counters[i].value );
+			lines.push_back( buf );
+		}
+		
+		float dpiRatio = r_windowDpi.GetVal() / 160.0f;
+		float lineHeight = 14.0f * dpiRatio;
+		float w = r_windowWidth.GetVal();
+		float top = r_windowHeight.GetVal() * 0.75f;
+		
+		glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+		glEnable( GL_BLEND );
+		glColor4f( 0.0f, 0.0f, 0.0f, 0.6f );
+		glBegin( GL_QUADS );
+		glVertex2f( 0, top - lineHeight * lines.size() );
+		glVertex2f( w, top - lineHeight * lines.size() );
+		glVertex2f( w, top );
+		glVertex2f( 0, top );
+		glEnd();
+		r3::Vec4f textColor( 0.4f, 1.0f, 0.4f, 0.9f );
+		for ( int i = 0; i < (int)lines.size(); i++ ) {
+			float y = top - lineHeight * ( i + 1 );
+			DrawLocalizedString2D( lines[i], r3::Bounds2f( 4.0f * dpiRatio, y, w - 4.0f * dpiRatio, y + lineHeight ), textColor );
+		}
+		glDisable( GL_BLEND );
+	}
+	
+}
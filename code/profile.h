@@ -0,0 +1,121 @@
+/*
+ *  profile
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_PROFILE_H__
+#define __STAR3MAP_PROFILE_H__
+
+#include "r3/thread.h"
+
+namespace star3map {
+
+	// Lightweight instrumentation.  Zones and counters are appended to a
+	// per-thread ring buffer, so recording never takes a lock.  Names must
+	// be string literals (or otherwise outlive the app), since only the
+	// pointer is stored.
+
+	extern bool profileEnabled;
+	extern bool lockProfileEnabled;
+
+	// monotonic time in seconds, unaffected by the NTP time offset
+	double ProfileTime();
+
+	void ProfileSetThreadName( const char *name );
+	void ProfileRecordZone( const char *name, double begin, double end );
+	void ProfileCounter( const char *name, float value );
+
+	// call once at the top of each rendered frame
+	void ProfileFrame();
+
+	void RenderProfileOverlay();
+
+	struct ScopedProfileZone {
+		ScopedProfileZone( const char *zName ) : name( zName ), begin( profileEnabled ? ProfileTime() : 0.0 ) {}
+		~ScopedProfileZone() {
+			if ( begin != 0.0 ) {
+				ProfileRecordZone( name, begin, ProfileTime() );
+			}
+		}
+		const char *name;
+		double begin;
+	};
+
+	void ProfileRecordLock( const char *file, int line, double waitBegin, double acquired, double released );
+
+	// Use in place of r3::ScopedMutex.  When app_profileLocks is set, the wait
+	// and hold times are accumulated per call site, and the lockReport command
+	// prints the sites ranked by total wait.
+	struct ProfiledScopedMutex {
+		ProfiledScopedMutex( r3::Mutex & m, const char *lFile, int lLine )
+		: timing( lFile, lLine ), lock( m, lFile, lLine ) {
+			timing.acquired = timing.waitBegin != 0.0 ? ProfileTime() : 0.0;
+		}
+		~ProfiledScopedMutex() {
+			timing.released = timing.waitBegin != 0.0 ? ProfileTime() : 0.0;
+		}
+		
+		// Declared before the lock so it's destroyed after it, and the
+		// recording happens once the caller's mutex is released.
+		struct Timing {
+			Timing( const char *tFile, int tLine )
+			: file( tFile ), line( tLine ), waitBegin( lockProfileEnabled ? ProfileTime() : 0.0 ), acquired( 0.0 ), released( 0.0 ) {}
+			~Timing() {
+				if ( waitBegin != 0.0 ) {
+					ProfileRecordLock( file, line, waitBegin, acquired, released );
+				}
+			}
+			const char *file;
+			int line;
+			double waitBegin;
+			double acquired;
+			double released;
+		};
+		Timing timing;
+		r3::ScopedMutex lock;
+	};
+
+}
+
+#define PROFILE_ZONE_CONCAT2( a, b ) a##b
+#define PROFILE_ZONE_CONCAT( a, b ) PROFILE_ZONE_CONCAT2( a, b )
+#define PROFILE_ZONE( name ) star3map::ScopedProfileZone PROFILE_ZONE_CONCAT( profileZone, __LINE__ )( name )
+
+#endif //__STAR3MAP_PROFILE_H__
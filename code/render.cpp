@@ -41,7 +41,9 @@
  */
 
 #include "render.h"
+#include "drawlist.h"
 #include "localize.h"
+#include "textbatch.h"
 
 #include "r3/draw.h"
 #include "r3/font.h"
@@ -56,7 +58,7 @@ using namespace std;
 
 VarString app_font( "app_font", "main app font", 0, "DroidSansFallback.ttf" );
 //VarString app_font( "app_font", "main app font", 0, "LiberationSans-Regular.ttf" );
-VarInteger app_fontSize( "app_fontSize", "main app font rasterization size", Var_Archive, 12 );
+VarInteger app_fontSize( "app_fontSize", "main app font size", Var_Archive, 12 );
 VarFloat app_fontScale( "app_fontScale", "main app font rendering scale", Var_Archive, 12 );
 
 VarFloat app_starScale( "app_starScale", "scale of star sprite rendering", Var_Archive, 5 );
@@ -66,12 +68,12 @@ VarFloat app_aspectRatio( "app_aspectRatio", "aspect ratio of the screen", 0, 1.
 using namespace star3map;
 
 extern VarFloat r_fov;
-extern VarString app_locale;
 extern VarInteger r_windowHeight;
 
 namespace {
 	
-	Font *font;
+	TextBatch *labelText;   // 3D labels, drawn by FlushStrings()
+	TextBatch *uiText;      // 2D strings, drawn as they're called
 	float fov;
 	float fovFontScale;
 
@@ -101,24 +103,21 @@ namespace star3map {
 	
 	Vec3f UpVector;
     
-    Matrix4f GetTransform() {
-        Matrix4f m;
-        glGetFloatv( GL_MODELVIEW_MATRIX, m.Ptr() );
-        return m;
-    }
-	
 	
 	void DrawQuad( float radius, const Vec3f & direction ) {
 		Matrix4f m = RotateTo( direction );
 		glMatrixPushEXT( GL_MODELVIEW );
 		glMatrixMultfEXT( GL_MODELVIEW, m.Ptr() );
-		glMatrixScalefEXT( GL_MODELVIEW, radius * app_scale.GetVal(), radius * app_scale.GetVal(), 1.f );
+		glMatrixScalefEXT( GL_MODELVIEW, radius * frameSettings.scale, radius * frameSettings.scale, 1.f );
 		glMatrixTranslatefEXT( GL_MODELVIEW, 0, 0, -1 );
 		r3::DrawQuad( -10, -10, 10, 10 );
         glMatrixPopEXT( GL_MODELVIEW );
 	}
 
 	void DrawSprite( Texture2D *tex, r3::Bounds2f bounds ) {
+		if ( tex == NULL ) {
+			return;
+		}
 		float s = float( tex->Width() ) / float( tex->PaddedWidth() );
 		float t = float( tex->Height() ) / float( tex->PaddedHeight() );
 		tex->Bind( 0 );
@@ -128,54 +127,43 @@ namespace star3map {
 		tex->Disable( 0 );
 	}
 	
-	void DrawSprite( Texture2D *tex, float radius, const Vec3f & direction ) {
+	Matrix4f SpriteTransform( float radius, const Vec3f & direction ) {
 		// beef up the width and height since the texture will make it
 		// effectively smaller
-        if( tex == NULL ) {
-            Output( "DrawSprite got NULL texture." );
-            return;
-        }
-		radius *= app_starScale.GetVal();
-		Matrix4f m = RotateTo( direction );
-		glMatrixPushEXT( GL_MODELVIEW );
-		glMatrixMultfEXT( GL_MODELVIEW, m.Ptr() );
-		glMatrixScalefEXT( GL_MODELVIEW, radius * app_scale.GetVal(), radius * app_scale.GetVal(), 1.f );
-		glMatrixTranslatefEXT( GL_MODELVIEW, 0, 0, -1 );
-		tex->Bind( 0 );
-		tex->Enable( 0 );
-		r3::DrawSprite( -10, -10, 10, 10 );
-		tex->Disable( 0 );
-        glMatrixPopEXT( GL_MODELVIEW );
+		radius *= frameSettings.starScale * frameSettings.scale;
+		Matrix4f mt;
+		mt.SetScale( Vec3f( radius, radius, 1.f ) );
+		mt.SetTranslate( Vec3f( 0, 0, -1 ) );
+		return RotateTo( direction ) * mt;
 	}
+	
+	// the directions RotateTo( direction ) takes x and y to
+	void LabelBasis( const Vec3f & direction, Vec3f & right, Vec3f & up ) {
+		Vec3f dx = UpVector.Cross( direction );
+		dx.Normalize();
+		up = direction.Cross( dx );
+		right = -dx;
+	}
+	
+	// label space to object space for a label centered on direction
+	Matrix4f LabelTransform( const Vec3f & direction ) {
+		Matrix4f mt;
+		mt.SetScale( Vec3f( frameSettings.scale, frameSettings.scale, 1.f ) );
+		mt.SetTranslate( Vec3f( 0, 0, -1 ) );
+		return RotateTo( direction ) * mt;
+	}
+	
 	bool renderInitialized = false;
     void InitAndUpdate();
 	void InitAndUpdate() {
-		if ( font == NULL ) {
-			string fontName = "DroidSans.ttf";
-			string fallback = "";
-			string locale = app_locale.GetVal();
-			if( locale.find( "ar_" ) != string::npos ) {
-				fallback = fontName;
-				fontName = "DroidSansArabic.ttf";
-			} else if( locale.find( "he_" ) != string::npos || locale.find( "iw_" ) != string::npos ) {
-				fallback = fontName;
-				fontName = "DroidSansHebrew.ttf";
-			} else if( locale.find( "th_" ) != string::npos ) {
-				fallback = fontName;
-				fontName = "DroidSansThai.ttf";
-			} else if( locale.find( "zh_" ) != string::npos ||
-                      locale.find( "ko_" ) != string::npos ||
-                      locale.find( "ja_" ) != string::npos ||
-                      0 // locale.find( "ru_" ) != string::npos
-                      ) {
-                fallback = fontName;
-                fontName = "DroidSansFallback.ttf";
-            }
-			
-			font = r3::CreateStbFont( fontName, fallback, (float)app_fontSize.GetVal() ); 			
+		if ( labelText == NULL ) {
+			// one distance field atlas for both, at any size
+			SdfFont *font = GetSharedFont();
+			labelText = new TextBatch( font, (float)app_fontSize.GetVal() );
+			uiText = new TextBatch( font, (float)app_fontSize.GetVal() );
 		}
-		if ( fov != r_fov.GetVal() ) {
-			fov = r_fov.GetVal();
+		if ( fov != frameSettings.fov ) {
+			fov = frameSettings.fov;
 			fovFontScale = app_fontScale.GetVal() * sin( ToRadians( fov ) );
 		}		
 		static int localTransformVersion = 0;
@@ -194,23 +182,28 @@ namespace star3map {
 		return renderInitialized;
 	}
 	
-	OrientedBounds2f StringBounds( const std::string & s, const Vec3f & direction ) {
+	OrientedBounds2f StringBounds( const std::string & s, const Vec3f & direction, const Matrix4f & modelviewProjection ) {
 		InitAndUpdate();
-		Bounds2f b = font->GetStringDimensions( s, fovFontScale );
+		Bounds2f b = labelText->GetStringDimensions( s, fovFontScale );
 		
-		Matrix4f m = RotateTo( direction );
-		Matrix4f mt;
-		mt.SetScale( app_scale.GetVal() );
-		mt.SetTranslate( Vec3f( 0, 0, -1 ) );
-        
-		Matrix4f xf = GetTransform() * m * mt;
+		// same placement as LabelTransform, without building the rotation
+		Vec3f right, up;
+		LabelBasis( direction, right, up );
+		right *= frameSettings.scale;
+		up *= frameSettings.scale;
 		
-		Vec4f pts[4];
 		Vec2f bias( -b.Width() / 2.f, -1.5f * b.Height() );
-		pts[0] = xf * Vec4f( b.Min().x + bias.x, b.Min().y + bias.y );
-		pts[1] = xf * Vec4f( b.Max().x + bias.x, b.Min().y + bias.y );
-		pts[2] = xf * Vec4f( b.Max().x + bias.x, b.Max().y + bias.y );
-		pts[3] = xf * Vec4f( b.Min().x + bias.x, b.Max().y + bias.y );
+		float x0 = b.Min().x + bias.x, x1 = b.Max().x + bias.x;
+		float y0 = b.Min().y + bias.y, y1 = b.Max().y + bias.y;
+		Vec3f p[4];
+		p[0] = direction + right * x0 + up * y0;
+		p[1] = direction + right * x1 + up * y0;
+		p[2] = direction + right * x1 + up * y1;
+		p[3] = direction + right * x0 + up * y1;
+		Vec4f pts[4];
+		for ( int i = 0; i < 4; i++ ) {
+			pts[i] = modelviewProjection * Vec4f( p[i].x, p[i].y, p[i].z, 1.f );
+		}
 		OrientedBounds2f ob;
 		for ( int i = 0; i < 4; i++ ) {
 			float w = pts[i].w;
@@ -224,102 +217,68 @@ namespace star3map {
 		return ob;
 	}
 
-	void DrawLocalizedString2D( const std::string & s, const Bounds2f & b, Font *f, TextAlignmentEnum hAlign, TextAlignmentEnum vAlign ) {
+	void DrawLocalizedString2D( const std::string & s, const Bounds2f & b, const Vec4f & color, TextAlignmentEnum hAlign, TextAlignmentEnum vAlign ) {
 		InitAndUpdate();
-		if ( f == NULL ) {
-			f = font;
+		Bounds2f u = uiText->GetStringDimensions( s, 1 );
+		if ( u.Width() <= 0 ) {
+			return;
 		}
-		Bounds2f u = f->GetStringDimensions( s, 1 );
-		u.ll.y = f->GetDescent();
-		u.ur.y = f->GetAscent();
 		
 		float hs = b.Height() / u.Height();
 		float sc = min<float>( b.Width() / u.Width(), hs );
         float tx = b.ll.x - AlignAdjust( b.Width(), hAlign );
         float ty = b.ll.y - AlignAdjust( b.Height(), vAlign );
-		glMatrixPushEXT( GL_MODELVIEW );
-		glMatrixTranslatefEXT( GL_MODELVIEW, tx, ty, 0 );
-		glMatrixScalefEXT( GL_MODELVIEW, sc, sc, 1.f );
-		glMatrixTranslatefEXT( GL_MODELVIEW, 0, -u.ll.y, 0 );
-		f->Print( s, 0, 0, 1, hAlign, vAlign );
-		glMatrixPopEXT( GL_MODELVIEW );		
+		Matrix4f xf;
+		xf.SetScale( Vec3f( sc, sc, 1.f ) );
+		xf.SetTranslate( Vec3f( tx, ty - u.ll.y * sc, 0 ) );
+		uiText->Add( s, xf, AlignAdjust( u.Width(), hAlign ), AlignAdjust( u.Height(), vAlign ), 1, color );
+		uiText->Draw();
 	}
     
-    void DrawString2D( const std::string & nls, const Bounds2f & b, Font *f, TextAlignmentEnum hAlign, TextAlignmentEnum vAlign ) {
+    void DrawString2D( const std::string & nls, const Bounds2f & b, const Vec4f & color, TextAlignmentEnum hAlign, TextAlignmentEnum vAlign ) {
 		string s = Localize( nls );
-        DrawLocalizedString2D( s, b, f, hAlign, vAlign );
+        DrawLocalizedString2D( s, b, color, hAlign, vAlign );
     }
 	
-	void DrawString( const std::string & nls, const Vec3f & direction ) {
+	void DrawString( const std::string & nls, const Vec3f & direction, const Vec4f & color ) {
 		string s = Localize( nls );
 		InitAndUpdate();
-		Bounds2f b = font->GetStringDimensions( s, fovFontScale );
-		
-		Matrix4f m = RotateTo( direction );
-		glMatrixPushEXT( GL_MODELVIEW );
-		glMatrixMultfEXT( GL_MODELVIEW, m.Ptr() );
-		glMatrixScalefEXT( GL_MODELVIEW, app_scale.GetVal(), app_scale.GetVal(), 1.f );
-		glMatrixTranslatefEXT( GL_MODELVIEW, 0, 0, -1 );
-		font->Print( s, -b.Width() / 2.f, -1.5f * b.Height(), (float)fovFontScale );
-		glMatrixPopEXT( GL_MODELVIEW );
+		Bounds2f b = labelText->GetStringDimensions( s, fovFontScale );
+		labelText->Add( s, LabelTransform( direction ), -b.Width() / 2.f, -1.5f * b.Height(), fovFontScale, color );
 	}
 	
-	void DrawSpriteAtLocation( Texture2D *tex, const Vec3f & position, const Matrix4f & rotation ) {
+	void DrawString( DrawList & list, const std::string & nls, const Vec3f & direction, const Vec4f & color ) {
+		string s = Localize( nls );
 		InitAndUpdate();
-        float s = 150 * app_scale.GetVal();
-        ScopedPushMatrix mvp( GL_MODELVIEW );
-		glMatrixTranslatefEXT( GL_MODELVIEW, position.x, position.y, position.z );
-		glMatrixMultfEXT( GL_MODELVIEW, rotation.Ptr() );
-        {
-            Matrix4f mv, p;
-            glGetFloatv( GL_MODELVIEW_MATRIX, mv.Ptr() );
-            glGetFloatv( GL_PROJECTION_MATRIX, p.Ptr() );
-            Matrix4f mvp = p * mv;
-            Vec3f p0( 0, 0, 0 );
-            Vec3f p1( 1, 1, 0 );
-            mvp.MultMatrixVec( p0 );
-            mvp.MultMatrixVec( p1 );
-            float h = ( p1.y - p0.y ) * r_windowHeight.GetVal();
-            if( h > 1000 ) {
-                float cap = 1000 / h;
-                glMatrixScalefEXT( GL_MODELVIEW_MATRIX, cap, cap, 1.0f);
-            }
-        }
-		tex->Bind( 0 );
-		tex->Enable( 0 );
-		r3::DrawSprite( -s, -s, s, s );
-		tex->Disable( 0 );
+		Bounds2f b = labelText->GetStringDimensions( s, fovFontScale );
+		list.AddText( s, LabelTransform( direction ), -b.Width() / 2.f, -1.5f * b.Height(), fovFontScale, color );
 	}
-
-	void DrawStringAtLocation( const std::string & nls, const Vec3f & position, const Matrix4f & rotation ) {
+	
+	void DrawStringAtLocation( const std::string & nls, const Vec3f & position, const Matrix4f & rotation, const Vec4f & color ) {
 		string s = Localize( nls );
 		InitAndUpdate();
 		float fontScale = 14.f;
-		Bounds2f b = font->GetStringDimensions( s, fontScale );
-        float bh = b.Height();
-		
+		Bounds2f b = labelText->GetStringDimensions( s, fontScale );
 		
-        ScopedPushMatrix mvpush( GL_MODELVIEW );
-		glMatrixTranslatefEXT( GL_MODELVIEW, position.x, position.y, position.z );
-		glMatrixMultfEXT( GL_MODELVIEW, rotation.Ptr() );
-		float sc = 0.75 * app_scale.GetVal();
-		glMatrixScalefEXT( GL_MODELVIEW, sc, sc, 1.f );
-        {
-            Matrix4f mv, p;
-            glGetFloatv( GL_MODELVIEW_MATRIX, mv.Ptr() );
-            glGetFloatv( GL_PROJECTION_MATRIX, p.Ptr() );
-            Matrix4f mvp = p * mv;
-            Vec3f p0( 0, 0, 0 );
-            Vec3f p1( 480 * fontScale, 480 * fontScale, 0 );
-            mvp.MultMatrixVec( p0 );
-            mvp.MultMatrixVec( p1 );
-            float h = ( p1.y - p0.y ) * r_windowHeight.GetVal();
-            if( h > bh ) {
-                float cap = bh / h;
-                glMatrixScalefEXT( GL_MODELVIEW_MATRIX, cap, cap, 1.0f);
-            }
-        }
-		font->Print( s, -b.Width() / 2.f, -1.5f * b.Height(), fontScale );
+		Matrix4f t, sc;
+		t.SetTranslate( position );
+		sc.SetScale( Vec3f( 0.75f * frameSettings.scale, 0.75f * frameSettings.scale, 1.f ) );
+		labelText->Add( s, t * rotation * sc, -b.Width() / 2.f, -1.5f * b.Height(), fontScale, color );
+	}
+	
+	void FlushStrings() {
+		if ( labelText ) {
+			labelText->Draw();
+		}
+	}
+	
+	void DrawTextRuns( const TextRun * runs, int count ) {
+		InitAndUpdate();
+		for ( int i = 0; i < count; i++ ) {
+			const TextRun & r = runs[i];
+			labelText->Add( r.str, r.xf, r.x, r.y, r.scale, r.color );
+		}
+		labelText->Draw();
 	}
 	
 	void DrawDebugGrid() {
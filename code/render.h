@@ -55,8 +55,46 @@
 
 namespace star3map {
 
+	class DrawList;
+	struct TextRun;
+	
 	extern r3::Vec3f UpVector;
 	
+	// generic attribute locations bound for the shaders in base/
+	enum AttrLocations {
+		AL_Position = 0,
+		AL_Color = 1,
+		AL_TexCoord = 2
+	};
+	
+	// Var values sampled once at the top of each frame, so loops over
+	// stars, satellites and labels don't go back to the Vars per object.
+	struct FrameSettings {
+		bool cull;
+		int maxSatellites;
+		float starScale;
+		float scale;
+		int debugLabels;
+		bool pauseAging;
+		bool nightViewing;
+		bool showStars;
+		bool showConstellations;
+		bool showPlanets;
+		bool showSatellites;
+		bool showLabels;
+		bool showDirections;
+		bool showHemisphere;
+		bool showGlobe;
+		float fov;
+		float starMagnitudeLimit;  // includes the zoom dependent part
+		float starCatalogMagnitude;
+		int windowWidth;
+		int windowHeight;
+	};
+	
+	extern FrameSettings frameSettings;
+	void UpdateFrameSettings();
+	
 	
 	// we get a static list of these for each star at
 	// startup, and generate a new list for the solar system
@@ -85,15 +123,26 @@ namespace star3map {
 	
 	void DrawSprite( r3::Texture2D *tex, r3::Bounds2f bounds );
 	
-	void DrawSprite( r3::Texture2D *tex, float radius, const r3::Vec3f & direction ); 
-	void DrawSpriteAtLocation( r3::Texture2D *tex, const r3::Vec3f & position, const r3::Matrix4f & rotation );
+	// the modelview for a ( -10, -10 ) to ( 10, 10 ) sprite quad facing the
+	// eye from direction, see DrawList::Sprite
+	r3::Matrix4f SpriteTransform( float radius, const r3::Vec3f & direction );
 
-	r3::OrientedBounds2f StringBounds( const std::string & str, const r3::Vec3f & direction );
+	// bounds of the label DrawString would draw, in the normalized device
+	// coordinates of modelviewProjection; empty if any corner is behind the eye
+	r3::OrientedBounds2f StringBounds( const std::string & str, const r3::Vec3f & direction, const r3::Matrix4f & modelviewProjection );
 
-	void DrawString( const std::string & str, const r3::Vec3f & direction);
-	void DrawLocalizedString2D( const std::string & s, const r3::Bounds2f & b, r3::Font * f = NULL, r3::TextAlignmentEnum hAlign = r3::Align_Min, r3::TextAlignmentEnum vAlign = r3::Align_Min );
-	void DrawString2D( const std::string & nls, const r3::Bounds2f & b, r3::Font * f = NULL, r3::TextAlignmentEnum hAlign = r3::Align_Min, r3::TextAlignmentEnum vAlign = r3::Align_Min );
-	void DrawStringAtLocation( const std::string & str, const r3::Vec3f & position, const r3::Matrix4f & rotation );
+	// 3D labels are queued and drawn together by FlushStrings(), using the
+	// modelview that is current then
+	void DrawString( const std::string & str, const r3::Vec3f & direction, const r3::Vec4f & color );
+	// the same label, recorded into list instead
+	void DrawString( DrawList & list, const std::string & str, const r3::Vec3f & direction, const r3::Vec4f & color );
+	// fit to b, in the shared font
+	void DrawLocalizedString2D( const std::string & s, const r3::Bounds2f & b, const r3::Vec4f & color, r3::TextAlignmentEnum hAlign = r3::Align_Min, r3::TextAlignmentEnum vAlign = r3::Align_Min );
+	void DrawString2D( const std::string & nls, const r3::Bounds2f & b, const r3::Vec4f & color, r3::TextAlignmentEnum hAlign = r3::Align_Min, r3::TextAlignmentEnum vAlign = r3::Align_Min );
+	void DrawStringAtLocation( const std::string & str, const r3::Vec3f & position, const r3::Matrix4f & rotation, const r3::Vec4f & color );
+	void FlushStrings();
+	// draws recorded labels as one batch, for the DrawList backend
+	void DrawTextRuns( const TextRun * runs, int count );
 	
 	void DrawDebugGrid();
 
@@ -46,6 +46,8 @@
 #include "satellite.h"
 #include "spacetime.h"
 #include "status.h"
+#include "log.h"
+#include "profile.h"
 
 #include "sgp4/sgp4io.h"
 #include "sgp4/sgp4unit.h"
@@ -66,6 +68,8 @@ using namespace r3;
 extern VarBool app_showSatellites;
 VarInteger app_satellitePathMaxTime( "app_satellitePathMaxSteps", "maximum length of satellite paths in seconds", 0, 15 * 60 );
 VarInteger app_satellitePathTimeStep( "app_satellitePathTimeStep", "number of seconds per satellite path time step", 0, 5 );
+VarInteger app_satelliteMaxErrors( "app_satelliteMaxErrors", "number of propagation errors before a satellite is quarantined", 0, 3 );
+VarFloat app_satelliteMaxEpochAge( "app_satelliteMaxEpochAge", "days from element epoch before a satellite is considered stale", 0, 30.f );
 
 extern VarString app_satelliteUrl;
 
@@ -74,46 +78,111 @@ namespace {
 
 	vector<uchar> specialTles;
 	
+	// A record that errors leaves SH_Ok for good; it is only propagated
+	// again once a new element set replaces it in ReadSatelliteFile.  A
+	// stale epoch depends on the time, so it's lifted once the time being
+	// propagated to is back in range.
+	enum SatHealth {
+		SH_Ok,
+		SH_Quarantined,  // repeated sgp4 errors other than decay
+		SH_Decayed,      // sgp4 error 6
+		SH_StaleEpoch    // elements too far from the time being propagated to
+	};
+	
+	const char * SatHealthName( int health ) {
+		switch( health ) {
+			case SH_Ok: return "ok";
+			case SH_Quarantined: return "quarantined";
+			case SH_Decayed: return "decayed";
+			case SH_StaleEpoch: return "stale epoch";
+			default: break;
+		}
+		return "unknown";
+	}
+	
 	struct SatRecord {
-		SatRecord() : special( false ), numErrors( 0 ) {
+		SatRecord() : special( false ), numErrors( 0 ), health( SH_Ok ) {
 		}
 		elsetrec orbitalElements;
 		string name;
 		bool special;
 		int numErrors;		
+		int health;
 	};
+	
+	void SetHealth( SatRecord & sr, int health ) {
+		if ( sr.health != health ) {
+			LogOutput( R3_LOC, "Sat %s is now %s. (Error count = %d.)", sr.name.c_str(), SatHealthName( health ), sr.numErrors );
+			sr.health = health;
+		}
+	}
+	
+	// Propagates a healthy record and updates its health.  Returns false
+	// (without propagating, if already known bad) when the result shouldn't be used.
+	// Call with the satellite mutex held.
+	bool Propagate( SatRecord & sr, double minutesFromSatEpoch, double ro[3], double vo[3] ) {
+		bool inRange = fabs( minutesFromSatEpoch ) <= app_satelliteMaxEpochAge.GetVal() * MinutesPerDay;
+		if ( sr.health == SH_StaleEpoch && inRange ) {
+			SetHealth( sr, SH_Ok );
+		}
+		if ( sr.health != SH_Ok ) {
+			return false;
+		}
+		if ( inRange == false ) {
+			SetHealth( sr, SH_StaleEpoch );
+			return false;
+		}
+		elsetrec & srec = sr.orbitalElements;
+		sgp4( wgs72, srec, minutesFromSatEpoch, ro, vo );
+		if ( srec.error == 0 ) {
+			return true;
+		}
+		sr.numErrors++;
+		LogOutput( R3_LOC, "Sat %s error %d at %lf mins from sat epoch. (Error count = %d.)", sr.name.c_str(), srec.error, minutesFromSatEpoch, sr.numErrors );
+		if ( srec.error == 6 ) {
+			SetHealth( sr, SH_Decayed );
+		} else if ( sr.numErrors >= app_satelliteMaxErrors.GetVal() ) {
+			SetHealth( sr, SH_Quarantined );
+		}
+		return false;
+	}
 
 	bool satsLoaded;
 	vector< SatRecord > satrec;
 		
 	struct SatellitePathThread : public r3::Thread {
 
-		SatellitePathThread() : r3::Thread("SatellitePath"), currLL( 0, 0 ), newLL( 0, 0 ) {
+		SatellitePathThread() : r3::Thread("SatellitePath"), currLL( 0, 0 ), newLL( 0, 0 ), version( 0 ) {
 		}
 		
 		void Run() {
 			bool showSatellites = app_showSatellites.GetVal();
 			Vec3f currViewerPos;
 			bool filling;
+			bool changed;
+			ProfileSetThreadName( "SatellitePath" );
 			while( 1 ) {
                 condRender.Wait();
 				filling = false;
+				changed = false;
 				{				
-					ScopedMutex scmutex( mutex, R3_LOC );
+					PROFILE_ZONE( "SatellitePathThread::Run" );
+					ProfiledScopedMutex scmutex( mutex, R3_LOC );
 					float deltaLL = ( currLL - newLL ).Length();
 					if ( deltaLL > 0.01f || (int) paths.size() == 0 || showSatellites != app_showSatellites.GetVal() ) {
 						//Output( "Updating viewer position - prev( %f, %f ), new( %f, %f ).", currLL.x, currLL.y, newLL.x, newLL.y );
 						if ( deltaLL > 0.01f ) {
-							Output( "Update reason: deltaLL = %f", deltaLL );							
+							LogOutput( R3_LOC, "Update reason: deltaLL = %f", deltaLL );							
 						}
 						//if ( paths.size() == 0 ) {
 						//	Output( "Update reason: paths.size() == 0" );							
 						//}
 						if ( showSatellites != app_showSatellites.GetVal() ) {
-							Output( "Update reason: app_showSatellites toggled" );														
+							LogOutput( R3_LOC, "Update reason: app_showSatellites toggled" );														
 						}
 						currLL = newLL;
 						showSatellites = app_showSatellites.GetVal();
+						changed = true;
 						paths.clear();
 						for ( int i = 0; i < (int)satrec.size(); i++ ) {
 							SatellitePath path;
@@ -145,9 +214,10 @@ namespace {
 							SatRecord & sr = satrec[i];
 							SatellitePath & path = paths[i];
 							
-							if ( sr.numErrors > 10 ) {
+							if ( sr.health != SH_Ok ) {
 								if ( path.pathPoint.size() > 0 ) {
 									path.pathPoint.clear();
+									changed = true;
 								}
 								continue;
 							}
@@ -159,6 +229,7 @@ namespace {
 							// remove all old PathPoints if the current time is past the furthest prediction
 							if ( points > 4 && path.pathPoint.back().minutesFromEpoch < ( mfe - 2 * pathIncr ) ) {
 								path.pathPoint.clear();
+								changed = true;
 							}
 							// otherwise remove at most one old PathPoint from each satellite on each iteration of the main thread loop
 							else if ( points >= 4 && path.pathPoint[0].minutesFromEpoch < ( mfe - 2 * pathIncr ) ) {
@@ -169,6 +240,7 @@ namespace {
 								path.pathPoint.pop_front();
 								path.pathPoint.pop_front();
 								points -= 2;
+								changed = true;
 							}
 							
 							// add at most one new PathPoint to each satellite on each iteration of the main thread loop
@@ -193,7 +265,12 @@ namespace {
 							elsetrec & srec = sr.orbitalElements;
 							double minutesFromSatEpoch = nextTime - ( ( srec.jdsatepoch - JulianDateAtEpoch ) * MinutesPerDay );
 							
-							sgp4( wgs72, srec, minutesFromSatEpoch, ro, vo );
+							if ( Propagate( sr, minutesFromSatEpoch, ro, vo ) == false ) {
+								path.pathPoint.clear();
+								path.aboveThresholdCount = 0;
+								changed = true;
+								continue;
+							}
 							float phaseEarthRot = GetThetaG( nextTime );
 							Matrix4f phase = Rotationf( Vec3f( 0, 0, 1 ), -phaseEarthRot ).GetMatrix4();
 							PathPoint pp;
@@ -206,10 +283,6 @@ namespace {
 								path.aboveThresholdCount++;
 							}
 							path.pathPoint.push_back( pp );
-							if( srec.error > 0 ) {
-								Output( "Sat %s error %d at %lf mins from sat epoch. (Error count = %d.)", path.name.c_str(), srec.error, minutesFromSatEpoch, sr.numErrors );
-								sr.numErrors++;
-							}
 							points++;
 							if ( points >= currMaxPath ) {
 								//Output( "Sat %s adding point (%d).", path.name.c_str(), points );								
@@ -220,14 +293,22 @@ namespace {
 					
 						
 					}
+					if ( changed || filling ) {
+						version++;
+					}
 				}
 				SleepMilliseconds( filling ? 50 : 1000 );
 			}
 				
 		}
 		
-		void CopyPaths( vector< SatellitePath > & p ) {
-			ScopedMutex scmutex( mutex, R3_LOC );
+		// only copies when the paths have changed since copiedVersion
+		bool CopyPaths( vector< SatellitePath > & p, int & copiedVersion ) {
+			ProfiledScopedMutex scmutex( mutex, R3_LOC );
+			if ( copiedVersion == version ) {
+				return false;
+			}
+			copiedVersion = version;
 			p.clear();
 			int sz = (int)paths.size();
 			for ( int i = 0; i < sz; i++ ) {
@@ -236,17 +317,20 @@ namespace {
 					p.push_back( path );
 				}
 			}
+			return true;
 		}
 
 		Vec2f currLL;
 		Vec2f newLL;
 		vector< SatellitePath > paths;
+		int version;   // bumped whenever paths change
 	};
 	
 	SatellitePathThread satPathThread;
 	
 	void ReadSatelliteFile( const std::string & filename ) {
-		ScopedMutex scmutex( mutex, R3_LOC );
+		PROFILE_ZONE( "ReadSatelliteFile" );
+		ProfiledScopedMutex scmutex( mutex, R3_LOC );
 		satPathThread.paths.clear();
 		
 		if ( filename.size() == 0 ) {
@@ -322,6 +406,11 @@ namespace {
 				double ro[3];
 				double vo[3];
 				sgp4( wgs72, sr.orbitalElements, 0.0, ro, vo );
+				if ( sr.orbitalElements.error == 6 ) {
+					sr.health = SH_Decayed;
+				} else if ( sr.orbitalElements.error > 0 ) {
+					sr.health = SH_Quarantined;
+				}
 				satrec.push_back( sr );
 			}
 			
@@ -361,6 +450,7 @@ namespace {
 		}
 		
 		void Run() {
+			ProfileSetThreadName( "SatelliteRead" );
 			string satelliteUrl;
 			while( 1 ) {
                 condRender.Wait();
@@ -399,7 +489,7 @@ namespace {
 						vector<uchar> data;
 						Output( "About to fetch... %s", fullUrl.c_str() );
 						if ( UrlReadToMemory( fullUrl, data ) )  {
-							ScopedMutex scmutex( mutex, R3_LOC );
+							ProfiledScopedMutex scmutex( mutex, R3_LOC );
 							File *f = FileOpenForWrite( "satellite_" + satelliteFile );
 							if ( f ) {
 								f->Write( &data[0], 1, (int)data.size() );
@@ -445,45 +535,47 @@ namespace star3map {
 	}
 	
 	void ComputeSatellitePositions( std::vector<Satellite> & satellites ) {
+		PROFILE_ZONE( "ComputeSatellitePositions" );
 		satellites.clear();
 		double mfe = GetCurrentMinutesFromEpoch();
-		ScopedMutex scmutex( mutex, R3_LOC );
+		ProfiledScopedMutex scmutex( mutex, R3_LOC );
 		
 		float phaseEarthRot = GetThetaG( mfe );
 		Matrix4f phase = Rotationf( Vec3f( 0, 0, 1 ), -phaseEarthRot ).GetMatrix4();
 	
 		int sz = (int)satrec.size();		
 		
+		int unhealthy = 0;
 		for ( int i = 0; i < sz; i++ ) {
-			SatRecord sr = satrec[i];
-			if( sr.numErrors > 10 ) {
-				continue;
-			}
-			Satellite sat;
-			sat.name = sr.name;
-			sat.id = (int)sr.orbitalElements.satnum;
-			sat.special = sr.special;
+			// by reference, so error counts and health persist across frames
+			SatRecord & sr = satrec[i];
 			double ro[3];
 			double vo[3];
 			elsetrec & srec = sr.orbitalElements;
 			double minutesFromSatEpoch = mfe - ( ( srec.jdsatepoch - JulianDateAtEpoch ) * 1440.0 );
-			sgp4( wgs72, srec, minutesFromSatEpoch, ro, vo );
-			if ( srec.error > 0 ) {
-				Output( "Sat %s error %d at %lf mins from sat epoch. (Error count = %d.)", sat.name.c_str(), srec.error, minutesFromSatEpoch, sr.numErrors );
-				sr.numErrors++;
+			if ( Propagate( sr, minutesFromSatEpoch, ro, vo ) == false ) {
+				unhealthy++;
+				continue;
 			}
+			Satellite sat;
+			sat.name = sr.name;
+			sat.id = (int)srec.satnum;
+			sat.special = sr.special;
 			sat.pos = phase * Vec3f( ro[0], ro[1], ro[2] );
 			satellites.push_back( sat );
 		}
+		ProfileCounter( "satellites", (float)satellites.size() );
+		ProfileCounter( "satellites unhealthy", (float)unhealthy );
 	}
 	
-	void GetSatelliteFlyovers( float lat, float lon, std::vector<SatellitePath> & paths ) {
-		satPathThread.CopyPaths( paths );
+	bool GetSatelliteFlyovers( float lat, float lon, std::vector<SatellitePath> & paths, int & version ) {
+		bool copied = satPathThread.CopyPaths( paths, version );
 		Vec2f ll( lat, lon );
 		if ( ll != satPathThread.newLL ) {
-			ScopedMutex scmutex( mutex, R3_LOC );
+			ProfiledScopedMutex scmutex( mutex, R3_LOC );
 			satPathThread.newLL = ll;
 		}
+		return copied;
 	}
 	
 }
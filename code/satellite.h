@@ -76,7 +76,9 @@ namespace star3map {
 
 	bool SatellitesLoaded();
 	void ComputeSatellitePositions( std::vector<Satellite> & satellites );
-	void GetSatelliteFlyovers( float lat, float lon, std::vector<SatellitePath> & paths );
+	// paths is only refreshed, and true returned, when the flyovers have
+	// changed since version was last filled in
+	bool GetSatelliteFlyovers( float lat, float lon, std::vector<SatellitePath> & paths, int & version );
 	
 }
 
@@ -0,0 +1,581 @@
+/*
+ *  sdffont
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "sdffont.h"
+#include "profile.h"
+
+#include "r3/filesystem.h"
+#include "r3/output.h"
+#include "r3/stb_truetype.h"
+#include "r3/time.h"
+#include "r3/var.h"
+
+#include <GL/Regal.h>
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+extern VarString app_locale;
+
+namespace {
+	
+	const int AtlasSize = 1024;
+	// Glyphs are baked at BakeSize pixels high, from a rasterization
+	// Oversample times larger, with Spread pixels of field around them.
+	const float BakeSize = 32.f;
+	const int Spread = 4;
+	const int Oversample = 4;
+	
+	const char cacheMagic[8] = { 'S', '3', 'M', 'S', 'D', 'F', '0', '1' };
+	
+	SdfFont *sharedFont;
+	float lastBakeTime;
+	
+	// offset to the nearest seed pixel
+	struct Offset {
+		int dx, dy;
+	};
+	
+	int Dist2( const Offset & o ) {
+		return o.dx * o.dx + o.dy * o.dy;
+	}
+	
+	void Nearer( vector< Offset > & g, int w, int h, int x, int y, int ox, int oy ) {
+		int nx = x + ox;
+		int ny = y + oy;
+		if ( nx < 0 || nx >= w || ny < 0 || ny >= h ) {
+			return;
+		}
+		Offset o = g[ ny * w + nx ];
+		o.dx += ox;
+		o.dy += oy;
+		if ( Dist2( o ) < Dist2( g[ y * w + x ] ) ) {
+			g[ y * w + x ] = o;
+		}
+	}
+	
+	// 8SSEDT: a sweep down and a sweep up, each pixel taking the nearest
+	// seed its neighbors know of
+	void DistanceTransform( vector< Offset > & g, int w, int h ) {
+		for ( int y = 0; y < h; y++ ) {
+			for ( int x = 0; x < w; x++ ) {
+				Nearer( g, w, h, x, y, -1,  0 );
+				Nearer( g, w, h, x, y,  0, -1 );
+				Nearer( g, w, h, x, y, -1, -1 );
+				Nearer( g, w, h, x, y,  1, -1 );
+			}
+			for ( int x = w - 1; x >= 0; x-- ) {
+				Nearer( g, w, h, x, y,  1,  0 );
+			}
+		}
+		for ( int y = h - 1; y >= 0; y-- ) {
+			for ( int x = w - 1; x >= 0; x-- ) {
+				Nearer( g, w, h, x, y,  1,  0 );
+				Nearer( g, w, h, x, y,  0,  1 );
+				Nearer( g, w, h, x, y, -1,  1 );
+				Nearer( g, w, h, x, y,  1,  1 );
+			}
+			for ( int x = 0; x < w; x++ ) {
+				Nearer( g, w, h, x, y, -1,  0 );
+			}
+		}
+	}
+	
+	unsigned char ToByte( float f ) {
+		return (unsigned char)( std::max( 0.f, std::min( 1.f, f ) ) * 255.f + 0.5f );
+	}
+	
+	// 0.5 on the outline, falling to 0 at Spread pixels outside and rising
+	// to 1 at Spread pixels inside, for the g.w by g.h box of g
+	void MakeGlyphSdf( const stbtt_fontinfo *info, float scale, const SdfFont::Glyph & g, vector< unsigned char > & out ) {
+		int x0 = int( g.box.Min().x );
+		int y0 = int( -g.box.Max().y );
+		int w = g.w * Oversample;
+		int h = g.h * Oversample;
+		vector< unsigned char > hi( w * h, 0 );
+		float hs = scale * Oversample;
+		int hx0, hy0, hx1, hy1;
+		stbtt_GetGlyphBitmapBox( info, g.index, hs, hs, &hx0, &hy0, &hx1, &hy1 );
+		int ox = hx0 - x0 * Oversample;
+		int oy = hy0 - y0 * Oversample;
+		int bw = min( hx1 - hx0, w - ox );
+		int bh = min( hy1 - hy0, h - oy );
+		if ( ox >= 0 && oy >= 0 && bw > 0 && bh > 0 ) {
+			stbtt_MakeGlyphBitmap( info, &hi[ oy * w + ox ], bw, bh, w, hs, hs, g.index );
+		}
+		
+		Offset zero = { 0, 0 };
+		Offset unseeded = { 10000, 10000 };
+		vector< Offset > toInside( w * h );
+		vector< Offset > toOutside( w * h );
+		for ( int i = 0; i < w * h; i++ ) {
+			bool inside = hi[i] >= 128;
+			toInside[i] = inside ? zero : unseeded;
+			toOutside[i] = inside ? unseeded : zero;
+		}
+		DistanceTransform( toInside, w, h );
+		DistanceTransform( toOutside, w, h );
+		
+		// each texel is the mean of the four high res pixels at its center,
+		// with distances measured to the pixel edges
+		out.resize( g.w * g.h );
+		const int c = Oversample / 2 - 1;
+		const float toValue = 1.f / ( 4.f * 2.f * Spread * Oversample );
+		for ( int j = 0; j < g.h; j++ ) {
+			for ( int i = 0; i < g.w; i++ ) {
+				float sum = 0.f;
+				for ( int dy = 0; dy < 2; dy++ ) {
+					for ( int dx = 0; dx < 2; dx++ ) {
+						int p = ( j * Oversample + c + dy ) * w + i * Oversample + c + dx;
+						if ( hi[p] >= 128 ) {
+							sum -= sqrtf( float( Dist2( toOutside[p] ) ) ) - 0.5f;
+						} else {
+							sum += sqrtf( float( Dist2( toInside[p] ) ) ) - 0.5f;
+						}
+					}
+				}
+				out[ j * g.w + i ] = ToByte( 0.5f - sum * toValue );
+			}
+		}
+	}
+	
+	void SetTexCoords( SdfFont::Glyph & g ) {
+		// rows run top down, so the top of the glyph is at y
+		g.tc0 = Vec2f( float( g.x ) / AtlasSize, float( g.y + g.h ) / AtlasSize );
+		g.tc1 = Vec2f( float( g.x + g.w ) / AtlasSize, float( g.y ) / AtlasSize );
+	}
+	
+	string Stem( const string & filename ) {
+		return filename.substr( 0, filename.rfind( '.' ) );
+	}
+	
+	string CacheFilename( const string name[2] ) {
+		string fn = "fontcache_" + Stem( name[0] );
+		if ( name[1].size() > 0 ) {
+			fn += "_" + Stem( name[1] );
+		}
+		return fn + ".sdf";
+	}
+	
+	// the font files and the bake parameters
+	string CacheKey( const string name[2] ) {
+		char buf[64];
+		r3Sprintf( buf, "%g %d %d", BakeSize, Spread, Oversample );
+		string key = buf;
+		for ( int i = 0; i < 2; i++ ) {
+			int size = 0;
+			File *file = name[i].size() > 0 ? FileOpenForRead( name[i] ) : NULL;
+			if ( file ) {
+				size = file->Size();
+				delete file;
+			}
+			r3Sprintf( buf, " %d", size );
+			key += " " + name[i] + buf;
+		}
+		return key;
+	}
+	
+	void Append( vector< unsigned char > & buf, const void *data, int size ) {
+		const unsigned char *d = static_cast< const unsigned char * >( data );
+		buf.insert( buf.end(), d, d + size );
+	}
+	
+	bool Read( const vector< unsigned char > & buf, size_t & offset, void *data, size_t size ) {
+		if ( offset + size > buf.size() ) {
+			return false;
+		}
+		memcpy( data, &buf[ offset ], size );
+		offset += size;
+		return true;
+	}
+	
+	// what the cache keeps of each baked glyph
+	struct GlyphRecord {
+		int codepoint;
+		float advance;
+		float box[4];
+		int x, y, w, h;
+	};
+	
+}
+
+namespace star3map {
+	
+	struct SdfFont::Face {
+		vector< unsigned char > data;
+		stbtt_fontinfo info;
+		float scale;
+	};
+	
+	SdfFont::SdfFont( const string & fontName, const string & fallbackName )
+	: numFonts( 0 ), facesLoaded( false ), ascent( 0 ), descent( 0 ), atlasObj( 0 ), penX( 0 ), penY( 0 ), rowHeight( 0 ), generation( 0 ), dirty( false ) {
+		PROFILE_ZONE( "SdfFont::SdfFont" );
+		face[0] = face[1] = NULL;
+		name[0] = fontName;
+		name[1] = fallbackName;
+		key = CacheKey( name );
+		atlas.resize( AtlasSize * AtlasSize, 0 );
+		if ( ReadCache() ) {
+			Output( "SdfFont: %d glyphs from %s", (int)glyphs.size(), CacheFilename( name ).c_str() );
+		} else {
+			LoadFaces();
+		}
+		GLuint obj;
+		glGenTextures( 1, &obj );
+		atlasObj = obj;
+		glTextureParameteriEXT( atlasObj, GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+		glTextureParameteriEXT( atlasObj, GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTextureParameteriEXT( atlasObj, GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+		glTextureParameteriEXT( atlasObj, GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glTextureImage2DEXT( atlasObj, GL_TEXTURE_2D, 0, GL_LUMINANCE, AtlasSize, AtlasSize, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, &atlas[0] );
+	}
+	
+	SdfFont::~SdfFont() {
+		for ( int i = 0; i < numFonts; i++ ) {
+			delete face[i];
+		}
+		if ( atlasObj ) {
+			GLuint obj = atlasObj;
+			glDeleteTextures( 1, &obj );
+		}
+	}
+	
+	float SdfFont::BakeSize() const {
+		return ::BakeSize;
+	}
+	
+	float SdfFont::FieldPerPixel() const {
+		return 1.f / ( 2.f * Spread );
+	}
+	
+	bool SdfFont::LoadFaces() {
+		if ( facesLoaded ) {
+			return numFonts > 0;
+		}
+		PROFILE_ZONE( "SdfFont::LoadFaces" );
+		facesLoaded = true;
+		for ( int i = 0; i < 2; i++ ) {
+			if ( name[i].size() == 0 ) {
+				continue;
+			}
+			Face *f = new Face;
+			if ( FileReadToMemory( name[i], f->data ) == false || f->data.size() == 0 ||
+				 stbtt_InitFont( &f->info, &f->data[0], stbtt_GetFontOffsetForIndex( &f->data[0], 0 ) ) == 0 ) {
+				Output( "SdfFont: unable to init font %s", name[i].c_str() );
+				delete f;
+				continue;
+			}
+			f->scale = stbtt_ScaleForPixelHeight( &f->info, ::BakeSize );
+			if ( numFonts == 0 ) {
+				int a, d, gap;
+				stbtt_GetFontVMetrics( &f->info, &a, &d, &gap );
+				ascent = a * f->scale;
+				descent = d * f->scale;
+			}
+			face[ numFonts++ ] = f;
+		}
+		if ( numFonts == 0 ) {
+			Output( "SdfFont: no usable font in %s or %s", name[0].c_str(), name[1].c_str() );
+		}
+		return numFonts > 0;
+	}
+	
+	SdfFont::Glyph & SdfFont::Lookup( int codepoint ) {
+		map< int, Glyph >::iterator it = glyphs.find( codepoint );
+		if ( it != glyphs.end() ) {
+			return it->second;
+		}
+		Glyph & g = glyphs[ codepoint ];
+		if ( LoadFaces() == false ) {
+			return g;
+		}
+		for ( int i = 0; i < numFonts; i++ ) {
+			int index = stbtt_FindGlyphIndex( &face[i]->info, codepoint );
+			if ( index != 0 || i == numFonts - 1 ) {
+				g.font = i;
+				g.index = index;
+				break;
+			}
+		}
+		stbtt_fontinfo *info = &face[ g.font ]->info;
+		float sc = face[ g.font ]->scale;
+		int adv, lsb;
+		stbtt_GetGlyphHMetrics( info, g.index, &adv, &lsb );
+		g.advance = adv * sc;
+		int x0, y0, x1, y1;
+		stbtt_GetGlyphBitmapBox( info, g.index, sc, sc, &x0, &y0, &x1, &y1 );
+		if ( x1 > x0 && y1 > y0 ) {
+			x0 -= Spread;
+			y0 -= Spread;
+			x1 += Spread;
+			y1 += Spread;
+			g.w = x1 - x0;
+			g.h = y1 - y0;
+			g.box = Bounds2f( float( x0 ), float( -y1 ), float( x1 ), float( -y0 ) );
+		} else {
+			g.box = Bounds2f( 0, 0, 0, 0 );
+		}
+		return g;
+	}
+	
+	float SdfFont::Advance( int codepoint ) {
+		return Lookup( codepoint ).advance;
+	}
+	
+	const SdfFont::Glyph & SdfFont::GetGlyph( int codepoint ) {
+		Glyph *g = &Lookup( codepoint );
+		if ( g->baked == false && g->font < 0 && g->w > 0 ) {
+			// metrics from the cache, and evicted by a reset since, so it
+			// has to be found in the fonts to be baked again
+			glyphs.erase( codepoint );
+			g = &Lookup( codepoint );
+		}
+		if ( g->baked == false && Bake( *g ) == false ) {
+			Output( "SdfFont: glyph atlas full, resetting." );
+			ResetAtlas();
+			Bake( *g );
+		}
+		return *g;
+	}
+	
+	bool SdfFont::Bake( Glyph & g ) {
+		if ( g.w <= 0 || g.h <= 0 || g.font < 0 ) {
+			g.baked = true;
+			return true;
+		}
+		// shelf packing with a texel of padding
+		if ( penX + g.w + 1 > AtlasSize ) {
+			penX = 0;
+			penY += rowHeight + 1;
+			rowHeight = 0;
+		}
+		if ( penY + g.h + 1 > AtlasSize ) {
+			return false;
+		}
+		PROFILE_ZONE( "SdfFont::Bake" );
+		vector< unsigned char > sdf;
+		MakeGlyphSdf( &face[ g.font ]->info, face[ g.font ]->scale, g, sdf );
+		for ( int j = 0; j < g.h; j++ ) {
+			memcpy( &atlas[ ( penY + j ) * AtlasSize + penX ], &sdf[ j * g.w ], g.w );
+		}
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glTextureSubImage2DEXT( atlasObj, GL_TEXTURE_2D, 0, penX, penY, g.w, g.h, GL_LUMINANCE, GL_UNSIGNED_BYTE, &sdf[0] );
+		g.x = penX;
+		g.y = penY;
+		SetTexCoords( g );
+		g.baked = true;
+		penX += g.w + 1;
+		rowHeight = max( rowHeight, g.h );
+		dirty = true;
+		lastBakeTime = GetSeconds();
+		return true;
+	}
+	
+	void SdfFont::ResetAtlas() {
+		for ( map< int, Glyph >::iterator it = glyphs.begin(); it != glyphs.end(); ++it ) {
+			it->second.baked = false;
+		}
+		penX = penY = rowHeight = 0;
+		fill( atlas.begin(), atlas.end(), 0 );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glTextureImage2DEXT( atlasObj, GL_TEXTURE_2D, 0, GL_LUMINANCE, AtlasSize, AtlasSize, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, &atlas[0] );
+		generation++;
+		dirty = true;
+	}
+	
+	bool SdfFont::ReadCache() {
+		PROFILE_ZONE( "SdfFont::ReadCache" );
+		vector< unsigned char > buf;
+		if ( FileReadToMemory( CacheFilename( name ), buf ) == false ) {
+			return false;
+		}
+		size_t offset = 0;
+		char magic[8];
+		unsigned int keySize;
+		if ( Read( buf, offset, magic, sizeof( magic ) ) == false || memcmp( magic, cacheMagic, sizeof( magic ) ) != 0 ||
+			 Read( buf, offset, &keySize, 4 ) == false || offset + keySize > buf.size() ) {
+			return false;
+		}
+		// the fonts or the bake parameters changed
+		if ( string( (const char *)&buf[ offset ], keySize ) != key ) {
+			return false;
+		}
+		offset += keySize;
+		float a, d;
+		int px, py, rh, numGlyphs;
+		if ( Read( buf, offset, &a, 4 ) == false || Read( buf, offset, &d, 4 ) == false ||
+			 Read( buf, offset, &px, 4 ) == false || Read( buf, offset, &py, 4 ) == false ||
+			 Read( buf, offset, &rh, 4 ) == false || Read( buf, offset, &numGlyphs, 4 ) == false ) {
+			return false;
+		}
+		int rows = py + rh;
+		if ( px < 0 || px > AtlasSize || py < 0 || rh < 0 || rows > AtlasSize || numGlyphs < 0 ) {
+			return false;
+		}
+		map< int, Glyph > cached;
+		for ( int i = 0; i < numGlyphs; i++ ) {
+			GlyphRecord r;
+			if ( Read( buf, offset, &r, sizeof( r ) ) == false ) {
+				return false;
+			}
+			if ( r.x < 0 || r.y < 0 || r.w < 0 || r.h < 0 || r.x + r.w > AtlasSize || r.y + r.h > rows ) {
+				return false;
+			}
+			Glyph & g = cached[ r.codepoint ];
+			g.advance = r.advance;
+			g.box = Bounds2f( r.box[0], r.box[1], r.box[2], r.box[3] );
+			g.x = r.x;
+			g.y = r.y;
+			g.w = r.w;
+			g.h = r.h;
+			SetTexCoords( g );
+			g.baked = true;
+		}
+		if ( offset + rows * AtlasSize != buf.size() ) {
+			return false;
+		}
+		if ( rows > 0 ) {
+			memcpy( &atlas[0], &buf[ offset ], rows * AtlasSize );
+		}
+		ascent = a;
+		descent = d;
+		penX = px;
+		penY = py;
+		rowHeight = rh;
+		glyphs.swap( cached );
+		return true;
+	}
+	
+	void SdfFont::Save() {
+		if ( dirty == false ) {
+			return;
+		}
+		PROFILE_ZONE( "SdfFont::Save" );
+		dirty = false;
+		vector< GlyphRecord > records;
+		for ( map< int, Glyph >::iterator it = glyphs.begin(); it != glyphs.end(); ++it ) {
+			const Glyph & g = it->second;
+			if ( g.baked == false ) {
+				continue;
+			}
+			GlyphRecord r;
+			r.codepoint = it->first;
+			r.advance = g.advance;
+			r.box[0] = g.box.Min().x;
+			r.box[1] = g.box.Min().y;
+			r.box[2] = g.box.Max().x;
+			r.box[3] = g.box.Max().y;
+			r.x = g.x;
+			r.y = g.y;
+			r.w = g.w;
+			r.h = g.h;
+			records.push_back( r );
+		}
+		
+		vector< unsigned char > buf;
+		Append( buf, cacheMagic, sizeof( cacheMagic ) );
+		unsigned int keySize = (unsigned int)key.size();
+		Append( buf, &keySize, 4 );
+		Append( buf, key.c_str(), keySize );
+		int numGlyphs = (int)records.size();
+		Append( buf, &ascent, 4 );
+		Append( buf, &descent, 4 );
+		Append( buf, &penX, 4 );
+		Append( buf, &penY, 4 );
+		Append( buf, &rowHeight, 4 );
+		Append( buf, &numGlyphs, 4 );
+		if ( numGlyphs > 0 ) {
+			Append( buf, &records[0], numGlyphs * sizeof( GlyphRecord ) );
+		}
+		Append( buf, &atlas[0], ( penY + rowHeight ) * AtlasSize );
+		
+		string fn = CacheFilename( name );
+		File *file = FileOpenForWrite( fn );
+		if ( file == NULL ) {
+			Output( "SdfFont: unable to write %s", fn.c_str() );
+			return;
+		}
+		file->Write( &buf[0], 1, (int)buf.size() );
+		delete file;
+		Output( "SdfFont: wrote %d glyphs to %s", numGlyphs, fn.c_str() );
+	}
+	
+	SdfFont * GetSharedFont() {
+		if ( sharedFont == NULL ) {
+			string fontName = "DroidSans.ttf";
+			string fallback = "";
+			string locale = app_locale.GetVal();
+			if( locale.find( "ar_" ) != string::npos ) {
+				fallback = fontName;
+				fontName = "DroidSansArabic.ttf";
+			} else if( locale.find( "he_" ) != string::npos || locale.find( "iw_" ) != string::npos ) {
+				fallback = fontName;
+				fontName = "DroidSansHebrew.ttf";
+			} else if( locale.find( "th_" ) != string::npos ) {
+				fallback = fontName;
+				fontName = "DroidSansThai.ttf";
+			} else if( locale.find( "zh_" ) != string::npos ||
+					  locale.find( "ko_" ) != string::npos ||
+					  locale.find( "ja_" ) != string::npos ||
+					  0 // locale.find( "ru_" ) != string::npos
+					  ) {
+				fallback = fontName;
+				fontName = "DroidSansFallback.ttf";
+			}
+			sharedFont = new SdfFont( fontName, fallback );
+		}
+		return sharedFont;
+	}
+	
+	void SaveSharedFont() {
+		if ( sharedFont && sharedFont->Dirty() && GetSeconds() - lastBakeTime > 2.f ) {
+			sharedFont->Save();
+		}
+	}
+	
+}
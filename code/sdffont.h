@@ -0,0 +1,128 @@
+/*
+ *  sdffont
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_SDFFONT_H__
+#define __STAR3MAP_SDFFONT_H__
+
+#include "r3/bounds.h"
+#include "r3/linear.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace star3map {
+	
+	// A font and its fallback, baked on demand into a signed distance field
+	// glyph atlas, so one atlas draws cleanly at any size.  Metrics are in
+	// pixels at BakeSize().  The baked glyphs are cached on disk per font
+	// pair, and the fonts themselves are only read when a glyph isn't in
+	// the cache.  Context thread only.
+	class SdfFont {
+	public:
+		struct Glyph {
+			Glyph() : font( -1 ), index( 0 ), advance( 0 ), baked( false ), x( 0 ), y( 0 ), w( 0 ), h( 0 ) {}
+			int font;   // -1 until looked up in the fonts
+			int index;
+			float advance;
+			bool baked;
+			r3::Bounds2f box;  // y up, relative to the pen position, with the field's margin
+			r3::Vec2f tc0, tc1;
+			int x, y, w, h;    // in the atlas, rows top down
+		};
+		
+		SdfFont( const std::string & fontName, const std::string & fallbackName );
+		~SdfFont();
+		
+		float BakeSize() const;
+		// how much the field changes per baked pixel
+		float FieldPerPixel() const;
+		float Ascent() const { return ascent; }
+		float Descent() const { return descent; }
+		
+		// without baking the glyph
+		float Advance( int codepoint );
+		// The glyph, baked if it isn't yet.  When the atlas fills it starts
+		// over, which bumps Generation(), and glyphs from earlier generations
+		// have to be looked up again.
+		const Glyph & GetGlyph( int codepoint );
+		int Generation() const { return generation; }
+		unsigned int AtlasObject() const { return atlasObj; }
+		
+		// writes the disk cache, if glyphs were baked since it was read
+		void Save();
+		bool Dirty() const { return dirty; }
+		
+	private:
+		struct Face;
+		
+		Glyph & Lookup( int codepoint );
+		bool LoadFaces();
+		bool Bake( Glyph & g );
+		void ResetAtlas();
+		bool ReadCache();
+		
+		std::string name[2];
+		std::string key;
+		Face *face[2];  // primary and fallback
+		int numFonts;
+		bool facesLoaded;
+		float ascent;
+		float descent;
+		
+		std::map< int, Glyph > glyphs;
+		std::vector< unsigned char > atlas;  // a copy of the texture, for the cache
+		unsigned int atlasObj;
+		int penX, penY, rowHeight;
+		int generation;
+		bool dirty;
+	};
+	
+	// the font for app_locale, shared by all of the text
+	SdfFont * GetSharedFont();
+	// Saves the shared font's cache once no new glyphs have been baked for a
+	// couple of seconds.  Call once a frame.
+	void SaveSharedFont();
+	
+}
+
+#endif //__STAR3MAP_SDFFONT_H__
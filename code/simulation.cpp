@@ -0,0 +1,222 @@
+/*
+ *  simulation
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "star3map.h"
+#include "simulation.h"
+#include "spacetime.h"
+#include "profile.h"
+
+#include "r3/thread.h"
+#include "r3/time.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	// only held to hand data across, never while simulating
+	r3::Mutex simMutex;
+	
+	SimulationInput input;
+	bool haveInput;
+	SimulationFrame published;
+	vector< SatellitePath > publishedPaths;
+	int publishedPathVersion;
+	
+	void SwapFrames( SimulationFrame & a, SimulationFrame & b ) {
+		swap( a.number, b.number );
+		a.satellites.swap( b.satellites );
+		a.sorted.swap( b.sorted );
+		swap( a.numSorted, b.numSorted );
+		for ( int i = 0; i < SSB_MAX; i++ ) {
+			swap( a.planetDirection[i], b.planetDirection[i] );
+		}
+		swap( a.sunPosition, b.sunPosition );
+	}
+	
+	// special satellites first, then by distance from origin
+	struct NearestFirst {
+		const vector< Satellite > & satList;
+		Vec3f origin;
+		NearestFirst( const vector< Satellite > & inSatList, const Vec3f & inOrigin ) : satList( inSatList ), origin( inOrigin ) {
+		}
+		bool operator() ( int a, int b ) {
+			float aspecial = satList[a].special ? 0.0f : 1.0f;
+			float bspecial = satList[b].special ? 0.0f : 1.0f;
+			float la = ( satList[a].pos - origin ).Length() * aspecial;
+			float lb = ( satList[b].pos - origin ).Length() * bspecial;
+			return la < lb;
+		}
+	};
+	
+	struct SimulationThread : public r3::Thread {
+		
+		SimulationThread() : r3::Thread( "Simulation" ), frameNumber( 0 ), pathVersion( -1 ), lastSortTime( 0.0 ), lastMaxSatellites( 0 ) {
+		}
+		
+		void Run() {
+			ProfileSetThreadName( "Simulation" );
+			while( 1 ) {
+				condRender.Wait();
+				SimulationInput in;
+				{
+					ProfiledScopedMutex scmutex( simMutex, R3_LOC );
+					if ( haveInput == false ) {
+						continue;
+					}
+					in = input;
+				}
+				Step( in );
+			}
+		}
+		
+		void Step( const SimulationInput & in ) {
+			PROFILE_ZONE( "SimulationThread::Step" );
+			next.number = ++frameNumber;
+			
+			ss.Update( GetCurrentSolarDayNumber() );
+			for( int i = 0; i < SSB_MAX; ++i ) {
+				Vec3d pos = ss.body[ i ].equatorialPos;
+				pos.Normalize();
+				next.planetDirection[ i ] = Vec3f( pos.x, pos.y, pos.z );
+			}
+			next.sunPosition = ss.body[ SSB_Sun ].equatorialPos;
+			
+			if ( in.showSatellites ) {
+				ComputeSatellitePositions( next.satellites );
+				Sort( in );
+				if ( GetSatelliteFlyovers( in.latitude, in.longitude, paths, pathVersion ) ) {
+					ProfiledScopedMutex scmutex( simMutex, R3_LOC );
+					publishedPaths = paths;
+					publishedPathVersion = pathVersion;
+				}
+			} else {
+				next.satellites.clear();
+				next.numSorted = 0;
+			}
+			
+			ProfiledScopedMutex scmutex( simMutex, R3_LOC );
+			SwapFrames( next, published );
+		}
+		
+		// The order only changes slowly, so it is redone every few seconds or
+		// when the origin moves, and reused in between.
+		void Sort( const SimulationInput & in ) {
+			if ( indexes.size() != next.satellites.size() ) {
+				indexes.resize( next.satellites.size() );
+				for ( int i = 0; i < (int)indexes.size(); i++ ) {
+					indexes[i] = i;
+				}
+				lastSortTime = 0.0; // force a re-sort
+			}
+			if ( in.maxSatellites != lastMaxSatellites ) {
+				lastMaxSatellites = in.maxSatellites;
+				lastSortTime = 0.0; // force a re-sort
+			}
+			double now = GetTime();
+			if ( in.sortOrigin != origin || ( now - lastSortTime ) >= 5.0 ) {
+				PROFILE_ZONE( "SimulationThread::Sort" );
+				lastSortTime = now;
+				origin = in.sortOrigin;
+				sort( indexes.begin(), indexes.end(), NearestFirst( next.satellites, origin ) );
+			}
+			next.sorted = indexes;
+			next.numSorted = min( in.maxSatellites, (int)indexes.size() );
+		}
+		
+		int frameNumber;
+		SimulationFrame next;
+		SolarSystem ss;  // separate from the render thread's
+		vector< SatellitePath > paths;
+		int pathVersion;
+		vector< int > indexes;
+		double lastSortTime;
+		int lastMaxSatellites;
+		Vec3f origin;
+	};
+	
+	SimulationThread simThread;
+	
+	bool initialized = false;
+	
+}
+
+namespace star3map {
+	
+	void InitializeSimulation() {
+		if ( initialized ) {
+			return;
+		}
+		publishedPathVersion = -1;
+		simThread.Start();
+		initialized = true;
+	}
+	
+	void SetSimulationInput( const SimulationInput & in ) {
+		ProfiledScopedMutex scmutex( simMutex, R3_LOC );
+		input = in;
+		haveInput = true;
+	}
+	
+	bool TakeSimulationFrame( SimulationFrame & frame ) {
+		ProfiledScopedMutex scmutex( simMutex, R3_LOC );
+		if ( published.number <= frame.number ) {
+			return false;
+		}
+		SwapFrames( frame, published );
+		return true;
+	}
+	
+	bool TakeSimulationPaths( vector< SatellitePath > & paths, int & version ) {
+		ProfiledScopedMutex scmutex( simMutex, R3_LOC );
+		if ( publishedPathVersion < 0 || publishedPathVersion == version ) {
+			return false;
+		}
+		paths = publishedPaths;
+		version = publishedPathVersion;
+		return true;
+	}
+	
+}
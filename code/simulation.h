@@ -0,0 +1,90 @@
+/*
+ *  simulation
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_SIMULATION_H__
+#define __STAR3MAP_SIMULATION_H__
+
+#include "satellite.h"
+#include "solarsystem.h"
+
+#include "r3/linear.h"
+
+#include <vector>
+
+namespace star3map {
+
+	// What the render thread passes along for the next simulated frame.
+	struct SimulationInput {
+		float latitude;        // degrees, where flyovers are predicted for
+		float longitude;
+		r3::Vec3f sortOrigin;  // km, satellites are ordered by distance from here
+		int maxSatellites;
+		bool showSatellites;
+	};
+	
+	// One frame of simulation results.  The render thread reads the frame it
+	// took with TakeSimulationFrame without locking, for as long as it likes,
+	// while the simulation thread fills in the next one.
+	struct SimulationFrame {
+		SimulationFrame() : number( 0 ), numSorted( 0 ) {}
+		int number;  // 0 until a frame has been taken
+		std::vector< Satellite > satellites;
+		std::vector< int > sorted;  // indexes into satellites, special and then nearest first
+		int numSorted;              // how many of sorted to draw
+		r3::Vec3f planetDirection[ SSB_MAX ];
+		r3::Vec3d sunPosition;      // equatorial
+	};
+	
+	// The simulation thread steps once per condRender broadcast, so frame N
+	// is drawn while frame N+1 is being propagated.
+	void InitializeSimulation();
+	void SetSimulationInput( const SimulationInput & input );
+	// swaps the newest published frame into frame, returns false if there
+	// is nothing newer than frame
+	bool TakeSimulationFrame( SimulationFrame & frame );
+	// paths is only refreshed, and true returned, when the flyovers have
+	// changed since version was last filled in
+	bool TakeSimulationPaths( std::vector< SatellitePath > & paths, int & version );
+	
+}
+
+#endif //__STAR3MAP_SIMULATION_H__
@@ -0,0 +1,184 @@
+/*
+ *  skyindex
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "skyindex.h"
+
+#include "r3/common.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	// half angle of the cone around a cube face's corners
+	const float FaceRadius = 0.9553166f;
+	
+	void FaceUV( const Vec3f & d, int face, float & u, float & v ) {
+		const float * p = &d.x;
+		int a = face / 2;
+		float m = fabs( p[a] );
+		u = p[ ( a + 1 ) % 3 ] / m;
+		v = p[ ( a + 2 ) % 3 ] / m;
+	}
+	
+	int ToCell( float u, int faceDim ) {
+		return max( 0, min( faceDim - 1, int( ( u + 1.f ) * 0.5f * faceDim ) ) );
+	}
+	
+}
+
+namespace star3map {
+	
+	int CubeCell( const Vec3f & direction, int faceDim ) {
+		const float * d = &direction.x;
+		int a = 0;
+		for ( int i = 1; i < 3; i++ ) {
+			if ( fabs( d[i] ) > fabs( d[a] ) ) {
+				a = i;
+			}
+		}
+		int face = a * 2 + ( d[a] < 0 ? 1 : 0 );
+		float u, v;
+		FaceUV( direction, face, u, v );
+		return ( face * faceDim + ToCell( v, faceDim ) ) * faceDim + ToCell( u, faceDim );
+	}
+	
+	Vec3f CubeDirection( int face, float u, float v ) {
+		int a = face / 2;
+		float d[3];
+		d[ a ] = ( face & 1 ) ? -1.f : 1.f;
+		d[ ( a + 1 ) % 3 ] = u;
+		d[ ( a + 2 ) % 3 ] = v;
+		Vec3f dir( d[0], d[1], d[2] );
+		dir.Normalize();
+		return dir;
+	}
+	
+	SkyIndex::SkyIndex( int dim ) : faceDim( dim ) {
+	}
+	
+	void SkyIndex::Build( const vector< Vec3f > & directions, const vector< int > & ids ) {
+		int cells = 6 * faceDim * faceDim;
+		vector< int > cellOf( directions.size() );
+		cellStart.assign( cells + 1, 0 );
+		for ( int i = 0; i < (int)directions.size(); i++ ) {
+			cellOf[i] = CubeCell( directions[i], faceDim );
+			cellStart[ cellOf[i] + 1 ]++;
+		}
+		for ( int c = 0; c < cells; c++ ) {
+			cellStart[ c + 1 ] += cellStart[ c ];
+		}
+		vector< int > fill( cellStart.begin(), cellStart.end() - 1 );
+		items.resize( directions.size() );
+		for ( int i = 0; i < (int)directions.size(); i++ ) {
+			items[ fill[ cellOf[i] ]++ ] = ids[i];
+		}
+	}
+	
+	void SkyIndex::AddCells( int face, int i0, int i1, int j0, int j1, vector< int > & result ) const {
+		for ( int j = j0; j <= j1; j++ ) {
+			int row = ( face * faceDim + j ) * faceDim;
+			int begin = cellStart[ row + i0 ];
+			int end = cellStart[ row + i1 + 1 ];
+			result.insert( result.end(), items.begin() + begin, items.begin() + end );
+		}
+	}
+	
+	void SkyIndex::Query( const Vec3f & direction, float radius, vector< int > & result ) const {
+		if ( items.size() == 0 ) {
+			return;
+		}
+		float cosR = cos( min( radius, float( R3_PI ) ) );
+		float sinR = sin( min( radius, float( R3_PI ) ) );
+		// tangent basis for walking the cone's rim
+		Vec3f t1 = fabs( direction.x ) < 0.9f ? Vec3f( 1, 0, 0 ) : Vec3f( 0, 1, 0 );
+		t1 = t1 - direction * t1.Dot( direction );
+		t1.Normalize();
+		Vec3f t2 = direction.Cross( t1 );
+		
+		const int RimSamples = 16;
+		for ( int face = 0; face < 6; face++ ) {
+			Vec3f axis = CubeDirection( face, 0, 0 );
+			if ( direction.Dot( axis ) < cos( min( float( R3_PI ), radius + FaceRadius ) ) ) {
+				continue;
+			}
+			int a = face / 2;
+			float sign = ( face & 1 ) ? -1.f : 1.f;
+			// The rim projects onto the face plane as an ellipse, so its
+			// samples bound the cells, give or take one.  Any part of the cone
+			// behind the plane makes the projection unbounded; use the whole face.
+			bool whole = radius > 1.3f || ( &direction.x )[a] * sign <= 0.f;
+			float umin = 1, umax = -1, vmin = 1, vmax = -1;
+			for ( int k = 0; k < RimSamples && whole == false; k++ ) {
+				float theta = 2.f * float( R3_PI ) * k / RimSamples;
+				Vec3f p = direction * cosR + ( t1 * cos( theta ) + t2 * sin( theta ) ) * sinR;
+				if ( ( &p.x )[a] * sign <= 0.01f ) {
+					whole = true;
+					break;
+				}
+				float u, v;
+				FaceUV( p, face, u, v );
+				umin = min( umin, u );
+				umax = max( umax, u );
+				vmin = min( vmin, v );
+				vmax = max( vmax, v );
+			}
+			if ( whole ) {
+				AddCells( face, 0, faceDim - 1, 0, faceDim - 1, result );
+				continue;
+			}
+			if ( umax < -1.f || umin > 1.f || vmax < -1.f || vmin > 1.f ) {
+				continue;
+			}
+			int i0 = max( 0, ToCell( umin, faceDim ) - 1 );
+			int i1 = min( faceDim - 1, ToCell( umax, faceDim ) + 1 );
+			int j0 = max( 0, ToCell( vmin, faceDim ) - 1 );
+			int j1 = min( faceDim - 1, ToCell( vmax, faceDim ) + 1 );
+			AddCells( face, i0, i1, j0, j1, result );
+		}
+	}
+	
+}
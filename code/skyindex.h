@@ -0,0 +1,82 @@
+/*
+ *  skyindex
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_SKYINDEX_H__
+#define __STAR3MAP_SKYINDEX_H__
+
+#include "r3/linear.h"
+
+#include <vector>
+
+namespace star3map {
+	
+	// Cube map cells over the sphere of directions.  Face f has major axis
+	// f / 2, negative when f is odd, and each face is split into
+	// faceDim x faceDim cells over u, v in [-1,1].
+	int CubeCell( const r3::Vec3f & direction, int faceDim );
+	r3::Vec3f CubeDirection( int face, float u, float v );
+	
+	// A static index of directions on the sky, bucketed by cube map cell,
+	// so cone queries only visit the cells the cone touches.
+	class SkyIndex {
+	public:
+		SkyIndex( int faceDim = 16 );
+		
+		// ids[i] is reported for directions[i]
+		void Build( const std::vector< r3::Vec3f > & directions, const std::vector< int > & ids );
+		int Size() const { return (int)items.size(); }
+		
+		// Appends the ids in every cell that may be within radius (in
+		// radians) of direction.  Callers still need to test each one.
+		void Query( const r3::Vec3f & direction, float radius, std::vector< int > & result ) const;
+		
+	private:
+		void AddCells( int face, int i0, int i1, int j0, int j1, std::vector< int > & result ) const;
+		
+		int faceDim;
+		std::vector< int > cellStart;   // items of cell c are [ cellStart[c], cellStart[c+1] )
+		std::vector< int > items;
+	};
+	
+}
+
+#endif //__STAR3MAP_SKYINDEX_H__
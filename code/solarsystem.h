@@ -40,6 +40,9 @@
  Cass Everitt
  */
 
+#ifndef __STAR3MAP_SOLARSYSTEM_H__
+#define __STAR3MAP_SOLARSYSTEM_H__
+
 #include "r3/linear.h"
 
 namespace star3map {
@@ -91,4 +94,4 @@ namespace star3map {
 
 }
 
-
+#endif //__STAR3MAP_SOLARSYSTEM_H__
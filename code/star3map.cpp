@@ -43,6 +43,7 @@
 
 #include "star3map.h"
 #include "satellite.h"
+#include "simulation.h"
 #include "spacetime.h"
 #include "drawstring.h"
 #include "localize.h"
@@ -51,6 +52,18 @@
 #include "status.h"
 #include "transient.h"
 #include "solarsystem.h"
+#include "profile.h"
+#include "atlas.h"
+#include "billboard.h"
+#include "drawlist.h"
+#include "lineset.h"
+#include "loadgraph.h"
+#include "sdffont.h"
+#include "texmanager.h"
+#include "flyover.h"
+#include "starfield.h"
+#include "starcatalog.h"
+#include "skyindex.h"
 
 #include "r3/command.h"
 #include "r3/common.h"
@@ -73,6 +86,7 @@
 #include <GL/Regal.h>
 
 #include <map>
+#include <string.h>
 
 using namespace std;
 using namespace star3map;
@@ -94,12 +108,6 @@ extern VarBool app_cull;
 
 extern VarFloat app_ntpTimeOffset;
 
-enum AttrLocations {
-  AL_Position = 0,
-  AL_Color = 1,
-  AL_TexCoord = 2
-};
-
 #if ANDROID
 VarBool app_license( "app_license", "allow licensed mode", 0, 0 );
 #else
@@ -113,25 +121,38 @@ VarString app_satelliteUrl( "app_satelliteUrl", "url to use for satellite data",
 VarInteger app_maxSatellites( "app_maxSatellites", "maximum number of satellites to display", 0, 40 );
 VarFloat app_inputDrag( "app_inputDrag", "drag factor on input for inertia effect", 0, .9 );
 VarInteger app_loadProgress( "app_loadProgress", "indicator of loading progress", 0, 0 );
+VarInteger app_loadWorkers( "app_loadWorkers", "loader threads for startup, 0 does all loading on the initializer thread", 0, 2 );
 VarInteger app_loadProgressFinal( "app_loadProgressFinal", "largest value of app_loadProgress", Var_Archive, 100 );
 VarBool app_nightViewing( "app_nightViewing", "disable green and blue channels when viewing at night", 0, false );
 
 VarFloat app_debugPhase( "app_debugPhase", "phase adjustment", 0, 0.0f );
 
 VarBool app_showStars( "app_showStars", "draw stars", 0, true );
+VarFloat app_starMagnitudeLimit( "app_starMagnitudeLimit", "faintest star magnitude drawn", 0, 4.0f );
+VarString app_starCatalog( "app_starCatalog", "binary star catalog to map for faint stars, as written by writeStarCatalog", 0, "stars.s3sc" );
+VarFloat app_starCatalogMagnitude( "app_starCatalogMagnitude", "stars fainter than this come from the star catalog, when one is mapped", 0, 4.0f );
+VarFloat app_starMagnitudeZoom( "app_starMagnitudeZoom", "fainter magnitude limit for each halving of the field of view below 60 degrees", 0, 0.0f );
 VarBool app_showConstellations( "app_showConstellations", "draw constellations", 0, true );
 VarBool app_showPlanets( "app_showPlanets", "draw planets", 0, true );
 VarBool app_showGlobe( "app_showGlobe", "draw globe (in globe view)", 0, true );
+VarFloat app_globeMeshError( "app_globeMeshError", "largest gap in pixels between the globe mesh and a true sphere before a finer mesh is used", 0, 0.5f );
 VarBool app_showDirections( "app_showDirections", "show direction labels", 0, true );
 VarBool app_showLabels( "app_showLabels", "draw labels", 0, true );
 VarBool app_showHemisphere( "app_showHemisphere", "draw hemisphere", 0, true );
 VarBool app_showQR( "app_showQR", "Show the QR code for the app.", 0, false );
+VarBool app_redrawOnChange( "app_redrawOnChange", "only draw a new frame when something visibly changes", 0, true );
+VarInteger app_redrawMaxMsec( "app_redrawMaxMsec", "longest time between frames when nothing changes", 0, 500 );
+VarInteger app_redrawAnimationMsec( "app_redrawAnimationMsec", "frame interval for satellite color cycling and sighting pulses", 0, 100 );
+VarFloat app_redrawPixels( "app_redrawPixels", "screen space motion in pixels that needs a new frame", 0, 0.5f );
 
 Matrix4f Projection;
 Matrix4f ModelView;
 
 extern VarFloat app_scale;
 extern VarFloat app_starScale;
+extern VarInteger app_debugLabels;
+extern VarBool app_pauseAging;
+extern VarBool app_showProfile;
 
 r3::Condition condRender;
 
@@ -184,6 +205,7 @@ VarInteger app_asyncLoad( "app_asyncLoad", "enable asynchronous loading", 0, Asy
 vector< Sprite > stars;
 vector< Sprite > solarsystem;
 vector< Lines > constellations;
+LineSet constellationLines;
 MenuBar menu;
 
 double frameBeginTime;
@@ -238,13 +260,13 @@ void OpenURL( const char *url) {
 
 namespace {
     
-    map< string, Texture * > tex;
     map< string, Shader * > shd;
     map< string, Model * > mod;
     map< string, Button * > btn;
     
-	vector<Satellite> satellite;
 	vector<SatellitePath> satPath;
+	int satPathVersion = -1;
+	FlyoverPaths flyoverPaths;
 	SolarSystem ss;
     
     
@@ -314,148 +336,98 @@ namespace {
 	
 	void UpdateManualOrientation();
 	
-	struct SatelliteSorter {
-		
-		SatelliteSorter( const vector< Satellite > & satelliteList ) : satList( satelliteList ), lastMaxSatellites( 0 ), num( 0 ) {
-		}
-		
-		struct Comp {
-			const vector< Satellite > & satList;
-			Vec3f origin;
-			Comp( const vector< Satellite > & inSatList, const Vec3f & inOrigin ) : satList( inSatList ), origin( inOrigin ) {
-			}
-			bool operator() ( int a, int b ) {
-				float aspecial = satList[a].special ? 0.0f : 1.0f;
-				float bspecial = satList[b].special ? 0.0f : 1.0f;
-				float la = ( satList[a].pos - origin ).Length() * aspecial;
-				float lb = ( satList[b].pos - origin ).Length() * bspecial;
-				return la < lb;
-			}
-		};
-		
-		void Sort( const Vec3f & inOrigin ) {
-			
-			if ( indexes.size() != satList.size() ) {
-				indexes.resize( satellite.size() );				
-				for ( int i = 0; i < (int)indexes.size(); i++ ) {
-					indexes[i] = i;
-				}
-				lastSortTime = 0.0; // force a re-sort
-			}
-            if ( app_maxSatellites.GetVal() != lastMaxSatellites ) {
-                lastMaxSatellites = app_maxSatellites.GetVal();
-                lastSortTime = 0.0; // force a re-sort
-            }
-            
-			double now = GetTime();
-            if ( inOrigin == origin && ( now - lastSortTime ) < 5.0 ) {
-				return;
-			}
-            
-			lastSortTime = now;
-			origin = inOrigin;			
-			sort( indexes.begin(), indexes.end(), Comp( satList, origin ) );		
-			
-			num = min( app_maxSatellites.GetVal(), (int)satList.size() );			
-		}
-		
-		int Count() {
-			return num;
+	// the simulation results being drawn this frame
+	SimulationFrame sim;
+	BillboardBatch satBillboards( "satBillboards" );
+	
+	StarField starField;
+	StarCatalog starCatalog;
+	SkyIndex starIndex;           // the stars bright enough to label or pick
+	SkyIndex constellationIndex;  // constellation centers
+	vector< int > skyQuery;
+	
+	// the platform loaders fill in constellations, so this is built on first use
+	void UpdateConstellationIndex() {
+		if ( constellationIndex.Size() == (int)constellations.size() ) {
+			return;
 		}
-		
-		int operator[] ( int i ) {
-			return indexes[i];
+		vector< Vec3f > dirs;
+		vector< int > ids;
+		for ( int i = 0; i < (int)constellations.size(); i++ ) {
+			dirs.push_back( constellations[i].center );
+			ids.push_back( i );
 		}
-		
-		const vector< Satellite > & satList;
-		vector<int> indexes;
-		double lastSortTime;
-        int lastMaxSatellites;
-		Vec3f origin;
-		int num;
-	};
-	SatelliteSorter satSorter( satellite );
+		constellationIndex.Build( dirs, ids );
+	}
 	
-	struct StarVert {
-		Vec3f pos;
-		uchar c[4];
-		Vec2f tc;
-	};
 	struct EarthVert {
 		Vec3f pos;
 	};
 	
-	float magToDiam[] = { 2.0f, 1.5f, 1.25f, 1.0f, .85f, .75f, .5f };
-	
-	float GetSpriteDiameter( float magnitude ) {
-		int mag = max( 0, min( 6, (int)magnitude ) );
-		return magToDiam[ mag ];
+	// the star data as a tiled catalog, with a bucket per magnitude step
+	// past the labeled stars
+	bool WriteStarCatalog( const string & filename ) {
+		const float limits[] = { 2, 3, 4, 5, 6, 7, 8, 30 };
+		vector< float > bucketLimits( limits, limits + sizeof( limits ) / sizeof( limits[0] ) );
+		bool ok = StarCatalog::Write( filename, stars, 4, bucketLimits );
+		Output( "%s star catalog %s from %d stars", ok ? "Wrote" : "Failed to write", filename.c_str(), (int)stars.size() );
+		return ok;
 	}
 	
-	float magToColor[] = { 1.0f, .9f, .7f, .5f, .3f, .2f, .1f };
-	
-	float GetSpriteColorScale( float magnitude ) {
-		int mag = max( 0, min( 6, (int)magnitude ) );
-		return magToColor[ mag ];
+	void WriteStarCatalogCommand( const vector< Token > & tokens ) {
+		string filename = tokens.size() > 1 ? tokens[1].valString : app_starCatalog.GetVal();
+		// the mapping can't outlive the file being rewritten under it
+		bool active = starCatalog.IsOpen() && filename == app_starCatalog.GetVal();
+		if ( active ) {
+			starCatalog.Close();
+		}
+		if ( WriteStarCatalog( filename ) && active ) {
+			starCatalog.Open( filename, StarCatalog::SourceHash( stars ) );
+		}
 	}
+	CommandFunc WriteStarCatalogCmd( "writeStarCatalog", "write the loaded stars as a binary star catalog", WriteStarCatalogCommand );
 	
 	void InitStarsModel() {
-		{
-			Model * m = mod["stars"] = new Model( "stars" );
-			vector< StarVert > data;
-			for ( int i = 0; i < (int)stars.size(); i++ ) {
-				Sprite & s = stars[i];
-				if ( s.magnitude > 4 ) {
-					continue;
-				}
-				Vec4f c = s.color * GetSpriteColorScale( s.magnitude ) * 255.f;
-				Matrix4f mRot = RotateTo( s.direction );
-				Matrix4f mScale;
-				float sc = s.scale * GetSpriteDiameter( s.magnitude ) * app_starScale.GetVal() * app_scale.GetVal();
-				mScale.SetScale( Vec3f( sc, sc, 1 ) );
-				Matrix4f mTrans;
-				mTrans.SetTranslate( Vec3f( 0, 0, -1 ) );
-				Matrix4f m = mRot * mScale * mTrans;
-				StarVert v;
-				v.c[0] = c.x; v.c[1] = c.y; v.c[2] = c.z; v.c[3] = c.w;
-				v.pos = m * Vec3f( -10, -10, 0 );
-				v.tc = Vec2f( 0, 0 );
-				data.push_back( v );
-				v.pos = m * Vec3f(  10, -10, 0 );
-				v.tc = Vec2f( 1, 0 );
-				data.push_back( v );
-				v.pos = m * Vec3f(  10,  10, 0 );
-				v.tc = Vec2f( 1, 1 );
-				data.push_back( v );
-				v.pos = m * Vec3f( -10,  10, 0 );
-				v.tc = Vec2f( 0, 1 );
-				data.push_back( v );				
+		starField.Build( stars );
+		vector< Vec3f > dirs;
+		vector< int > ids;
+		for ( int i = 0; i < (int)stars.size(); i++ ) {
+			if ( stars[i].magnitude <= 4 ) {
+				dirs.push_back( stars[i].direction );
+				ids.push_back( i );
 			}
-			m->GetVertexBuffer().SetData( (int)data.size() * sizeof( StarVert ), & data[0] );
-            int offset = 0;
-            m->AddAttributeArray( AttributeArray( GL_VERTEX_ARRAY, 3, GL_FLOAT, GL_FALSE, sizeof( StarVert ), offset ) );
-            offset += sizeof( Vec3f );
-            m->AddAttributeArray( AttributeArray( GL_COLOR_ARRAY , 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( StarVert ), offset )  );
-            offset += 4;
-            m->AddAttributeArray( AttributeArray( GL_TEXTURE0    , 2, GL_FLOAT, GL_FALSE, sizeof( StarVert ), offset ) );
-            m->SetNumVertexes( data.size() );
-			m->SetPrimitive( GL_QUADS );
+		}
+		starIndex.Build( dirs, ids );
+		// without a current catalog the star field draws everything;
+		// writeStarCatalog makes one
+		const string & catalog = app_starCatalog.GetVal();
+		if ( catalog.size() > 0 ) {
+			starCatalog.Open( catalog, StarCatalog::SourceHash( stars ) );
 		}
 		IncrementLoadProgress();
 	}
 	
+	// planet textures can be evicted, so look them up again when drawing
+	vector< string > planetTexture;
+	vector< TextureRegion > planetSprite;
+	
+	void UsePlanetSprites() {
+		for ( int i = 0; i < (int)planetTexture.size(); i++ ) {
+			planetSprite[i] = UseSprite( planetTexture[i] );
+		}
+	}
+	
 	void UpdateSolarSystemSprites() {
-		ss.Update( GetCurrentSolarDayNumber() );
+		if ( sim.number == 0 ) {
+			return;
+		}
 		for( int i = 0; i < SSB_MAX; ++i ) {
-			Sprite & s = solarsystem[i];
-			Elements & e = ss.body[ i ];
-			Vec3d pos = e.equatorialPos; // e.geocentricPos;
-			pos.Normalize();
-			s.direction = Vec3f( pos.x, pos.y, pos.z );
+			solarsystem[i].direction = sim.planetDirection[ i ];
 		}
 	}
 	
 	void InitSolarSystemSprites() {
+		PROFILE_ZONE( "InitSolarSystemSprites" );
 		ss.Update( GetCurrentSolarDayNumber() );
 		
 		float scale[] = { 6, 5, 2, 2, 2, 4, 6, 2, 2, 2 };
@@ -467,48 +439,30 @@ namespace {
 			for ( int j = 0; j < (int)s.name.size(); j++ ) {
 				texname.push_back( tolower( s.name[ j ] ) );
 			}
-            s.tex = static_cast<Texture2D *>( tex[ texname ] );
+            planetTexture.push_back( texname );
+            planetSprite.push_back( TextureRegion() );
+            s.tex = NULL;
 			s.scale = 1.0f;
 			s.color = Vec4f( 1,1,1,1 );
 			s.magnitude = 1;
 			s.scale = scale[ i ];
+			Vec3d pos = ss.body[ i ].equatorialPos; // ss.body[ i ].geocentricPos;
+			pos.Normalize();
+			s.direction = Vec3f( pos.x, pos.y, pos.z );
 			solarsystem.push_back( s );
 			IncrementLoadProgress( "planets" );
 		}		
-		UpdateSolarSystemSprites();
 	}
 	
-	void UpdateEarthModel() {
-		if ( mod.count( "sphere" ) == 0 ) {
-			mod["sphere"] = new Model( "globe" );
-            Shader * s = shd["earth"] = CreateShaderFromFile( "earth" );
-            glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
-            glBindAttribLocation( s->pgObject, AL_Color, "Color" );
-            glBindAttribLocation( s->pgObject, AL_TexCoord + 0, "TexCoord0" );
-            glLinkProgram( s->pgObject );
-            s = shd["earth-lite"] = CreateShaderFromFile( "earth-lite" );
-            glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
-            glBindAttribLocation( s->pgObject, AL_Color, "Color" );
-            glBindAttribLocation( s->pgObject, AL_TexCoord + 0, "TexCoord0" );
-            glLinkProgram( s->pgObject );
-            //s->SetUniform( "Sampler0", 0 );
-            //s->SetUniform( "Sampler1", 1 );
-		}
-		static double lastUpdateTime = 0;
-		double time = GetTime();
-		if ( ( time - lastUpdateTime ) < 60.0 ) {
-			return;
-		}
-		lastUpdateTime = time;
-		
-		Vec3d sunPos = ss.body[ SSB_Sun ].equatorialPos;
-		Vec3f sunDir( sunPos.x, sunPos.y, sunPos.z );
-		sunDir.Normalize();
-		sunDir = Rotationf( Vec3f( 0, 0, 1 ), -GetCurrentEarthPhase() ).GetMatrix3() * sunDir;
-		
+	// cube sphere resolutions, in vertexes along a face edge
+	const int NumEarthLods = 3;
+	const int earthLodDim[ NumEarthLods ] = { 10, 18, 34 };
+	Model * earthLod[ NumEarthLods ];
+	
+	void BuildEarthMesh( Model * s, int dim ) {
 		vector<EarthVert> data;
-        int jdim = 18;
-        int idim = 18;
+        int jdim = dim;
+        int idim = dim;
         for( int face = 0; face < 6; face++ ) {
             Matrix4f xf;
             switch( face ) {
@@ -562,17 +516,55 @@ namespace {
                 }
             }            
         }
-        Model * s = mod["sphere"];
 		s->GetVertexBuffer().SetData( (int)data.size() * sizeof( EarthVert ), & data[0] );
 		s->GetIndexBuffer().SetData( (int)index.size() * sizeof( ushort ), & index[0] );
         s->AddAttributeArray( AttributeArray( AL_Position, 3, GL_FLOAT, GL_FALSE, sizeof( Vec3f ), 0 ) );
         s->AddAttributeArray( AttributeArray( AL_TexCoord, 3, GL_FLOAT, GL_FALSE, sizeof( Vec3f ), 0 ) );
 		s->SetPrimitive( GL_TRIANGLES );
 	}
+	
+	// the globe geometry never changes, so every level is built once here
+	void InitEarthModel() {
+		PROFILE_ZONE( "InitEarthModel" );
+        Shader * s = shd["earth"] = CreateShaderFromFile( "earth" );
+        glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
+        glBindAttribLocation( s->pgObject, AL_Color, "Color" );
+        glBindAttribLocation( s->pgObject, AL_TexCoord + 0, "TexCoord0" );
+        glLinkProgram( s->pgObject );
+        s = shd["earth-lite"] = CreateShaderFromFile( "earth-lite" );
+        glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
+        glBindAttribLocation( s->pgObject, AL_Color, "Color" );
+        glBindAttribLocation( s->pgObject, AL_TexCoord + 0, "TexCoord0" );
+        glLinkProgram( s->pgObject );
+		for ( int i = 0; i < NumEarthLods; i++ ) {
+			char name[32];
+			r3Sprintf( name, "sphere%d", earthLodDim[i] );
+			earthLod[i] = mod[ name ] = new Model( name );
+			BuildEarthMesh( earthLod[i], earthLodDim[i] );
+		}
+	}
+	
+	// The coarsest level whose silhouette stays within app_globeMeshError
+	// pixels of a true sphere.  At the default and an 80 degree fov, that's
+	// the 18 vertex mesh for windows from about 440 to 1570 pixels high.
+	Model * ChooseEarthLod( float pixelRadius ) {
+		for ( int i = 0; i < NumEarthLods - 1; i++ ) {
+			// a face edge spans about a quarter turn, in earthLodDim - 1 chords
+			float halfAngle = float( R3_PI ) * 0.25f / ( earthLodDim[i] - 1 );
+			if ( pixelRadius * ( 1.f - cosf( halfAngle ) ) <= app_globeMeshError.GetVal() ) {
+				return earthLod[i];
+			}
+		}
+		return earthLod[ NumEarthLods - 1 ];
+	}
     
     using namespace ujson;
     
-    void LoadConfigTextures( Json & j ) {
+    // Every config.json texture is declared to the texture manager, and the
+    // ones not marked "lazy" are preloaded by the startup graph.  Ones with
+    // an "atlas" are always preloaded, and packed with the rest of their
+    // group; atlas gets the group name for each load, or "".
+    void LoadConfigTextures( Json & j, vector< TextureLoad > & loads, vector< string > & atlas ) {
         if( j.GetType() != Json::Type_Object ) {
             return;
         }
@@ -586,6 +578,7 @@ namespace {
             }
             Json & t = j(n);
             r3::TextureFormatEnum fmt = TextureFormat_RGBA;
+            CompressedFormatEnum compress = CompressedFormat_None;
             if( t("format").GetType() == Json::Type_String ) {
                 const string & s = t("format").s;
                 /*
@@ -596,6 +589,7 @@ namespace {
                 if( s == "RGB" ) {
                     fmt = TextureFormat_RGB;
                 }
+                compress = CompressedFormatFromString( s );
             }
             r3::TextureTargetEnum tgt = TextureTarget_2D;
             if( t( "target" ).GetType() == Json::Type_String ) {
@@ -604,19 +598,58 @@ namespace {
                     tgt = TextureTarget_Cube;
                 }
             }
-            switch( tgt ) {
-                case r3::TextureTarget_Cube:
-                    tex[ n ] = CreateTextureCubeFromFile( t("src").s, fmt );
-                    break;
-                case r3::TextureTarget_2D:
-                default:
-                    tex[ n ] = CreateTexture2DFromFile( t("src").s, fmt );                    
-                    break;
-            }                        
-            Output( "Loaded texture %s", n.c_str() );
-            IncrementLoadProgress();
+            TextureDesc d;
+            d.name = n;
+            d.src = t("src").s;
+            d.format = fmt;
+            d.target = tgt;
+            d.compress = compress;
+            d.clampToEdge = t("wrap").GetType() == Json::Type_String && t("wrap").s == "CLAMP";
+            DeclareTexture( d );
+            bool inAtlas = t("atlas").GetType() == Json::Type_String && tgt == TextureTarget_2D;
+            if( inAtlas == false && t("lazy").GetType() == Json::Type_Bool && t("lazy").b ) {
+                continue;
+            }
+            TextureLoad tl;
+            tl.desc = d;
+            tl.image = NULL;
+            loads.push_back( tl );
+            atlas.push_back( inAtlas ? t("atlas").s : string() );
+        }
+    }
+    
+    void DecodeTextureNode( void *data ) {
+        DecodeTexture( *static_cast< TextureLoad * >( data ) );
+    }
+    
+    void UploadTextureNode( void *data ) {
+        UploadTexture( *static_cast< TextureLoad * >( data ) );
+    }
+    
+    void ReadAtlasCacheNode( void *data ) {
+        static_cast< AtlasBuilder * >( data )->ReadCache();
+    }
+    
+    struct AtlasMember {
+        AtlasBuilder * atlas;
+        TextureLoad * load;
+    };
+    
+    // nothing to decode when the pages came from the cache
+    void DecodeAtlasMemberNode( void *data ) {
+        AtlasMember * m = static_cast< AtlasMember * >( data );
+        if( m->atlas->Cached() == false ) {
+            DecodeTexture( *m->load );
         }
     }
+    
+    void PackAtlasNode( void *data ) {
+        static_cast< AtlasBuilder * >( data )->Pack();
+    }
+    
+    void UploadAtlasNode( void *data ) {
+        static_cast< AtlasBuilder * >( data )->Upload();
+    }
 
     // "nightmode" : { "type" : "toggle", "tex" : "nightmode", "var" : "app_nightViewing" },
     ToggleButton * LoadConfigUiToggle( Json & j ) {
@@ -629,7 +662,7 @@ namespace {
             return NULL;
         }
         
-        return new ToggleButton( static_cast<r3::Texture2D *>( tex[ j("tex").s ] ), j("var").s );
+        return new ToggleButton( PinSprite( j("tex").s ), j("var").s );
 
     }
 
@@ -650,12 +683,12 @@ namespace {
                 Output( "Invalid UiSequence definition" );
                 continue;
             }
-            Texture2D * t = static_cast<Texture2D *>( tex[ im("tex").s ] );
-            if( t == NULL ) {
+            TextureRegion r = PinSprite( im("tex").s );
+            if( r.tex == NULL ) {
                 Output( "Invalid texture reference %s in UiSequence", im("tex").s.c_str() );
                 continue;
             }
-            sb->items.push_back( SequenceButton::Item( t, im("cmd").s ) );            
+            sb->items.push_back( SequenceButton::Item( r, im("cmd").s ) );            
         }
 
         if( sb->items.size() == 0 ) {
@@ -692,31 +725,101 @@ namespace {
         }
     }
     
-    void LoadConfig( const string & filename ) {
-        vector<unsigned char> buf;
-        if( FileReadToMemory( filename, buf ) ) {
-            Json * j = Decode( (const char *)&buf[0], (int)buf.size() );
-            //if( DidDecodeSucceed() == false ) {
-            //    Output( "Parse of json file %s failed.\n", filename.c_str() );
-            //}
-            if( j ) { // && json->GetType() == Json::Type_Map ) {
-                LoadConfigTextures( (*j)("textures") );
-                LoadConfigUi( (*j)( "buttons" ) );
-            }
-            Delete( j );
+	void BuildHemiModel() {
+		Model * m = mod["hemi"] = new Model( "hemi" );
+		float data[ 37 * 2 * 5 ];
+		float *d = data;
+		for( int i = 0; i <= 36; i++ ) {
+			Vec3f p0 = SphericalToCartesian( 1.0f, 0.0f, ( 2.0 * R3_PI * i ) / 36.f );
+			d[0] = p0.x;
+			d[1] = p0.y;
+			d[2] = p0.z;
+			d[3] = 0.5f;
+			d[4] = 0.0f;
+			d+=5;
+			Vec3f p1 = SphericalToCartesian( 1.0f, ToRadians( 45.0f ), ( 2.0 * R3_PI * i ) / 36.f );
+			d[0] = p1.x;
+			d[1] = p1.y;
+			d[2] = p1.z;
+			d[3] = 0.5f;
+			d[4] = 0.5f;
+			d+=5;
 		}
-    }
-    
-    
-	    
+		m->GetVertexBuffer().SetData( 37 * 2 * 5 * sizeof( float ), data );
+		m->SetNumVertexes( 37 * 2 );
+		m->AddAttributeArray( AttributeArray( GL_VERTEX_ARRAY, 3, GL_FLOAT, GL_FALSE, 5 * sizeof( float ), 0 ) );
+		m->AddAttributeArray( AttributeArray( GL_TEXTURE0    , 2, GL_FLOAT, GL_FALSE, 5 * sizeof( float ), 3 * sizeof( float ) ) );
+		m->SetPrimitive( GL_TRIANGLE_STRIP );
+	}
+	
+	// Load graph steps.  The cpu ones run on loader threads and must not touch
+	// GL; the upload ones run on the initializer thread, which owns the context.
+	
+	void LoadClock( void * ) {
+		SetTimeOffsetViaNtp(); // Sadly, we can't trust the system clock on iOS (and perhaps Android).
+	}
+	
+	void LoadSpaceTime( void * ) {
+		InitializeSpaceTime();
+	}
+	
+	void LoadSatellites( void * ) {
+		InitializeSatellites();
+		InitializeSimulation();
+	}
+	
+	void UploadFonts( void * ) {
+		InitializeRender();
+		textDepthBias = float( 1 << 16 ) * -0.025f;
+	}
+	
+	void UploadPlanets( void * ) {
+		InitSolarSystemSprites();
+	}
+	
+	void UploadMisc( void * ) {
+		// platform specific, and it creates textures, so not split any further
+		AsyncInitMisc();
+	}
+	
+	void UploadModels( void * ) {
+		BuildHemiModel();
+	}
+	
+	void UploadStarsModel( void * ) {
+		InitStarsModel();
+	}
+	
+	void UploadEarthModel( void * ) {
+		InitEarthModel();
+	}
+	
+	void UploadButtons( void *data ) {
+		Json * config = static_cast< Json * >( data );
+		if( config ) {
+			LoadConfigUi( (*config)( "buttons" ) );
+		}
+		btn["fblogin"] = new PushButton( PinSprite( "fblogin" ), "loginToFacebook" );
+		btn["fbpublish"] = new PushButton( PinSprite( "fbicon" ), "publishOnFacebook", "logoutOfFacebook" );
+#if APP_spacejunklite
+		btn["appstore"] = new PushButton( PinSprite( "sjpicon" ), "goToAppStore" );
+#endif		
+		btn["showflyovers"] = new PushButton( PinSprite( "flyover" ), "showFlyovers" );
+	}
+	
+	// texture nodes are named "textures:<name>", and all show as "textures"
+	void LoadGraphProgress( const string & name ) {
+		IncrementLoadProgress( name.substr( 0, name.find( ':' ) ) );
+	}
+	
 	struct InitializerThread : public r3::Thread {
         InitializerThread() : r3::Thread( "Initializer" ) {}
         
 		virtual void Run() {
+			ProfileSetThreadName( "Initializer" );
+			PROFILE_ZONE( "InitializerThread::Run" );
 			
 			GfxContext *ctx = app_asyncLoad.GetVal() == AsyncLoad_MultiContext ? loadContext : drawContext;
-			
-			SetTimeOffsetViaNtp(); // Sadly, we can't trust the system clock on iOS (and perhaps Android).
             
 			menu.borderWidth = 0.05f * r_windowDpi.GetVal(); 
 			menu.buttonWidth = 0.2f * r_windowDpi.GetVal();		
@@ -724,104 +827,86 @@ namespace {
 			if( app_asyncLoad.GetVal() != AsyncLoad_Synchronous ) {
 				ctx->Acquire();				
 			}
-			InitializeRender();
-			IncrementLoadProgress( "fonts" );
-			textDepthBias = float( 1 << 16 ) * -0.025f;
-            
-			InitializeSpaceTime();
-            
-            LoadConfig( "config.json" );
+			InitializeTextureCache();
 			
-			InitSolarSystemSprites();
+			// config.json is small, and its texture list shapes the graph
+			Json * config = NULL;
+			vector< TextureLoad > textures;
+			vector< string > atlas;
+			{
+				PROFILE_ZONE( "LoadConfig" );
+				vector<unsigned char> buf;
+				if( FileReadToMemory( "config.json", buf ) ) {
+					config = Decode( (const char *)&buf[0], (int)buf.size() );
+				}
+				if( config ) {
+					LoadConfigTextures( (*config)( "textures" ), textures, atlas );
+				}
+			}
 			
-			AsyncInitMisc();
-            
-			InitializeSatellites();
-			ComputeSatellitePositions( satellite );
-			IncrementLoadProgress( "satellites" );
-            
-			// construct hemi model
-			{			
-				Model * m = mod["hemi"] = new Model( "hemi" );
-				float data[ 37 * 2 * 5 ];
-				float *d = data;
-				for( int i = 0; i <= 36; i++ ) {
-					Vec3f p0 = SphericalToCartesian( 1.0f, 0.0f, ( 2.0 * R3_PI * i ) / 36.f );
-					d[0] = p0.x;
-					d[1] = p0.y;
-					d[2] = p0.z;
-					d[3] = 0.5f;
-					d[4] = 0.0f;
-					d+=5;
-					Vec3f p1 = SphericalToCartesian( 1.0f, ToRadians( 45.0f ), ( 2.0 * R3_PI * i ) / 36.f );
-					d[0] = p1.x;
-					d[1] = p1.y;
-					d[2] = p1.z;
-					d[3] = 0.5f;
-					d[4] = 0.5f;
-					d+=5;
+			LoadGraph graph;
+			int clock = graph.Add( "clock", LoadClock, NULL );
+			int spacetime = graph.Add( "spacetime", LoadSpaceTime, NULL );
+			graph.Add( "fonts", NULL, UploadFonts );
+			int planets = graph.Add( "planets", NULL, UploadPlanets );
+			int misc = graph.Add( "stars", NULL, UploadMisc );
+			int satellites = graph.Add( "satellites", LoadSatellites, NULL );
+			graph.Add( "models", NULL, UploadModels );
+			int starsModel = graph.Add( "starfield", NULL, UploadStarsModel );
+			graph.Add( "globe", NULL, UploadEarthModel );
+			int buttons = graph.Add( "buttons", NULL, UploadButtons, config );
+			graph.DependsOn( planets, clock );
+			graph.DependsOn( planets, spacetime );
+			graph.DependsOn( satellites, clock );
+			graph.DependsOn( satellites, spacetime );
+			graph.DependsOn( starsModel, misc );
+			// Atlas members are only decoded, then packed and uploaded together,
+			// unless the atlas's cache check, which runs first, finds the pages.
+			map< string, AtlasBuilder * > atlases;
+			map< string, int > atlasNode;
+			map< string, int > atlasCacheNode;
+			vector< AtlasMember > members;
+			members.reserve( textures.size() );
+			for( size_t i = 0; i < textures.size(); i++ ) {
+				TextureLoad & tl = textures[i];
+				if( atlas[i].empty() ) {
+					// cube maps have nothing to decode ahead of the upload
+					LoadFunc decode = tl.desc.target == TextureTarget_2D ? DecodeTextureNode : NULL;
+					int t = graph.Add( "textures:" + tl.desc.name, decode, UploadTextureNode, &tl );
+					graph.DependsOn( buttons, t );
+					continue;
 				}
-				m->GetVertexBuffer().SetData( 37 * 2 * 5 * sizeof( float ), data );
-                m->SetNumVertexes( 37 * 2 );
-                m->AddAttributeArray( AttributeArray( GL_VERTEX_ARRAY, 3, GL_FLOAT, GL_FALSE, 5 * sizeof( float ), 0 ) );
-                m->AddAttributeArray( AttributeArray( GL_TEXTURE0    , 2, GL_FLOAT, GL_FALSE, 5 * sizeof( float ), 3 * sizeof( float ) ) );
-				m->SetPrimitive( GL_TRIANGLE_STRIP );
-			} 
-			IncrementLoadProgress( "models" );
-            
-			InitStarsModel();
-            
-			UpdateEarthModel();
-			IncrementLoadProgress();
-            
-			glTextureParameteriEXT( tex["earth"]->Object(), GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-			glTextureParameteriEXT( tex["earth"]->Object(), GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-			glTextureParameteriEXT( tex["earthnorm"]->Object(), GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-			glTextureParameteriEXT( tex["earthnorm"]->Object(), GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-			tex["daynight"]->ClampToEdge();
-            
-            
-            /*{
-                SequenceButton *sb = new SequenceButton();
-                sb->items.push_back( SequenceButton::Item( (Texture2D *)tex["viewstars"], "setAppMode viewStars" ) );
-                sb->items.push_back( SequenceButton::Item( (Texture2D *)tex["viewglobe"], "setAppMode viewGlobe" ) );
-                btn["viewmode"] = sb;
-            }*/
-            
-            /*{
-                SequenceButton *sb = new SequenceButton();
-                tex["brightest"] = CreateTexture2DFromFile( "brightest.png", TextureFormat_RGBA );
-                IncrementLoadProgress();
-                sb->items.push_back( SequenceButton::Item( (Texture2D *)tex["brightest"], "chooseBrightestSatellites" ) );
-                tex["heart"] = CreateTexture2DFromFile( "heart.png", TextureFormat_RGBA );
-                IncrementLoadProgress();                
-                sb->items.push_back( SequenceButton::Item( (Texture2D *)tex["heart"], "chooseFavoriteSatellites" ) );
-#if ! APP_spacejunklite
-                tex["amateur"] = CreateTexture2DFromFile( "amateurradio.png", TextureFormat_RGBA );
-                IncrementLoadProgress();                
-                sb->items.push_back( SequenceButton::Item( (Texture2D *)tex["amateur"], "chooseAmateurRadioSatellites" ) );
-                tex["iridium"] = CreateTexture2DFromFile( "iridium.png", TextureFormat_RGBA );
-                IncrementLoadProgress();                
-                sb->items.push_back( SequenceButton::Item( (Texture2D *)tex["iridium"], "chooseIridiumSatellites" ) );
-#endif
-                btn["satlist"] = sb;
-            }*/
-            
-            btn["fblogin"] = new PushButton( "fblogin.png", "loginToFacebook" );
-			IncrementLoadProgress();
-			btn["fbpublish"] = new PushButton( "fbicon.png", "publishOnFacebook", "logoutOfFacebook" );
-			IncrementLoadProgress();
-#if APP_spacejunklite
-			btn["appstore"] = new PushButton( "star3map_icon.png", "goToAppStore" );
-#endif		
-            btn["showflyovers"] = new PushButton( "flyover.png", "showFlyovers" );
-            
+				if( atlases.count( atlas[i] ) == 0 ) {
+					AtlasBuilder * ab = atlases[ atlas[i] ] = new AtlasBuilder( atlas[i] );
+					int a = atlasNode[ atlas[i] ] = graph.Add( "textures:atlas:" + atlas[i], PackAtlasNode, UploadAtlasNode, ab );
+					atlasCacheNode[ atlas[i] ] = graph.Add( "textures:atlascache:" + atlas[i], ReadAtlasCacheNode, NULL, ab );
+					graph.DependsOn( buttons, a );
+				}
+				atlases[ atlas[i] ]->Add( &tl, tl.desc.compress );
+				tl.desc.compress = CompressedFormat_None;
+				AtlasMember m = { atlases[ atlas[i] ], &tl };
+				members.push_back( m );
+				int t = graph.Add( "textures:" + tl.desc.name, DecodeAtlasMemberNode, NULL, &members.back() );
+				graph.DependsOn( t, atlasCacheNode[ atlas[i] ] );
+				graph.DependsOn( atlasNode[ atlas[i] ], t );
+			}
+			
+			graph.Run( app_loadWorkers.GetVal(), LoadGraphProgress );
+			graph.Report();
+			for( map< string, AtlasBuilder * >::iterator it = atlases.begin(); it != atlases.end(); ++it ) {
+				delete it->second;
+			}
+			Delete( config );
             
 			UpdateManualOrientation();
 			IncrementLoadProgress("Done");
 			if( app_asyncLoad.GetVal() != AsyncLoad_Synchronous ) {
 				ctx->Release();
 			}
+			// free now, so on demand cube maps can load on it
+			if( app_asyncLoad.GetVal() == AsyncLoad_MultiContext ) {
+				SetTextureLoadContext( loadContext );
+			}
 			
 			appMode = AM_Initialized;
 		}
@@ -829,21 +914,29 @@ namespace {
 	};
 	
 	InitializerThread *initThread;
+	
+	// only drawn while initializing, and released after
+	Texture2D * LoadSplash() {
+		Texture2D * splash;
+		if( r_windowWidth.GetVal() <= 640 ) {
+			splash = CreateTexture2DFromFile( "splash-iphone.png", TextureFormat_RGBA );
+		} else {
+			splash = CreateTexture2DFromFile( "splash-ipad.png", TextureFormat_RGBA );
+		}
+		AdoptTexture( "splash", splash );
+		return splash;
+	}
     
 	void Initialize() {
 		if ( app_asyncLoad.GetVal() != AsyncLoad_Synchronous ) {
 			switch( appMode ) {
 				case AM_Uninitialized:
 					appMode = AM_Initializing;
-					if( r_windowWidth.GetVal() <= 640 ) {
-						tex["splash"] = CreateTexture2DFromFile( "splash-iphone.png", TextureFormat_RGBA );
-					} else {
-						tex["splash"] = CreateTexture2DFromFile( "splash-ipad.png", TextureFormat_RGBA );
-					}
 				{
-					SamplerParams samp = tex["splash"]->Sampler();
+					Texture2D * splash = LoadSplash();
+					SamplerParams samp = splash->Sampler();
 					samp.mipFilter = TextureFilter_None;
-					tex["splash"]->SetSampler( samp );
+					splash->SetSampler( samp );
 				}
 					InitializeLocalize();
 					Output( "Creating Draw GfxContext!" );
@@ -859,6 +952,7 @@ namespace {
 				case AM_Initialized:
 					delete initThread;
 					initThread = NULL;
+					ReleaseTexture( "splash" );
 					appMode = AM_ViewStars;
 					app_loadProgressFinal.SetVal( app_loadProgress.GetVal() );
 					EnableStatusMessages();
@@ -874,16 +968,13 @@ namespace {
 			Output( "Creating Draw GfxContext!" );
 			drawContext = CreateGfxContext( NULL );
 			Output( "Created Draw GfxContext!" );
-			if( r_windowWidth.GetVal() <= 640 ) {
-				tex["splash"] = CreateTexture2DFromFile( "splash-iphone.png", TextureFormat_RGBA );
-			} else {
-				tex["splash"] = CreateTexture2DFromFile( "splash-ipad.png", TextureFormat_RGBA );
-			}
+			LoadSplash();
 			IncrementLoadProgress();
 			initThread = new InitializerThread;
 			initThread->Run();
 			delete initThread;
 			initThread = NULL;
+			ReleaseTexture( "splash" );
 			appMode = AM_ViewStars;
 			app_loadProgressFinal.SetVal( app_loadProgress.GetVal() );
 			EnableStatusMessages();
@@ -918,28 +1009,22 @@ namespace {
         menu.AddButton( btn["showqr"] );
 	}
     
-	// Draw something to illustrate the horizon
-	void DrawUpHemisphere() {
-		//Output("DrawUpHemisphere");
-		tex["hemi"]->Bind( 0 );
-		tex["hemi"]->Enable( 0 );
-        glMultiTexEnviEXT( GL_TEXTURE0, GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
-		glColor4f( 1, 1, 1, 1 ) ;
-		mod["hemi"]->Draw();
-		tex["hemi"]->Disable( 0 );
-	}
-	
-	void DrawEarth() {
-		UpdateEarthModel();
+	void DrawEarth( float pixelRadius ) {
+		Model * sphere = ChooseEarthLod( pixelRadius );
 		
-        Vec3d sunPos = ss.body[ SSB_Sun ].equatorialPos;
+        Vec3d sunPos = sim.number > 0 ? sim.sunPosition : ss.body[ SSB_Sun ].equatorialPos;
 		Vec3f sunDir( sunPos.x, sunPos.y, sunPos.z );
 		sunDir.Normalize();
 		sunDir = Rotationf( Vec3f( 0, 0, 1 ), -GetCurrentEarthPhase() ).GetMatrix3() * sunDir;
 
         
-		tex["earth"]->Bind( 0 );
-		tex["earthnorm"]->Bind( 1 );
+		Texture * earth = UseTexture( "earth" );
+		Texture * earthNorm = UseTexture( "earthnorm" );
+		if ( earth == NULL || earthNorm == NULL ) {
+			return;
+		}
+		earth->Bind( 0 );
+		earthNorm->Bind( 1 );
 #if APP_spacejunklite
         Shader * s = proTimeLeft >= 0 ? shd["earth"] : shd["earth-lite"];
 #else
@@ -947,10 +1032,10 @@ namespace {
 #endif
         glUseProgram( s->pgObject );
         s->SetUniform( "SunDir", sunDir );
-        mod["sphere"]->Draw();
+        sphere->Draw();
         glUseProgram( 0 );
 		//tex["daynight"]->Disable( 1 );
-		tex["earth"]->Disable( 0 );
+		earth->Disable( 0 );
 	}
     
     void ResetDrawContext( const vector< Token > & tokens ) {
@@ -1065,6 +1150,8 @@ namespace {
 			} else if ( tokens[1].valString == "viewGlobe" ) {
 				r_fov.SetVal( viewGlobeFov );
 				appMode = AM_ViewGlobe;
+				PrefetchTexture( "earth" );
+				PrefetchTexture( "earthnorm" );
 				if ( hasViewedGlobe == false ) {
 					hasViewedGlobe = true;
 					globeViewLat = app_latitude.GetVal();
@@ -1167,8 +1254,8 @@ namespace star3map {
         
 		// satellites
 		if ( app_showSatellites.GetVal() ) {
-			for ( int i = 0; i < satSorter.Count(); i++ ) {
-				Satellite & sat = satellite[ satSorter[ i ] ];
+			for ( int i = 0; i < sim.numSorted; i++ ) {
+				Satellite & sat = sim.satellites[ sim.sorted[ i ] ];
 				Vec3f satDir = sat.pos - viewer;
 				satDir.Normalize();
 				
@@ -1186,9 +1273,16 @@ namespace star3map {
 		// Need to figure out why this is required...  I'd like everything to be done in the same space.
 		clickDir = phase * clickDir;
 		
+		// only objects within this of the click can be picked
+		const float pickRadius = acos( maxDot );
+		
 		// constellations
 		if ( app_showConstellations.GetVal() ) {
-			for ( int i = 0; i < (int)constellations.size(); i++ ) {
+			UpdateConstellationIndex();
+			skyQuery.clear();
+			constellationIndex.Query( clickDir, pickRadius, skyQuery );
+			for ( int k = 0; k < (int)skyQuery.size(); k++ ) {
+				int i = skyQuery[ k ];
 				Lines &l = constellations[ i ];
 				float dot = clickDir.Dot( l.center );
 				if ( dot <= maxDot ) {
@@ -1202,9 +1296,12 @@ namespace star3map {
 		}
         
 		// stars
-		for ( int i = 0; i < (int)stars.size(); i++ ) {
+		skyQuery.clear();
+		starIndex.Query( clickDir, pickRadius, skyQuery );
+		for ( int k = 0; k < (int)skyQuery.size(); k++ ) {
+			int i = skyQuery[ k ];
 			Sprite & s = stars[i];
-			if ( s.magnitude > 4 || s.name.size() == 0 ) {
+			if ( s.name.size() == 0 ) {
 				continue;
 			}
 			float dot = clickDir.Dot( s.direction );
@@ -1214,6 +1311,7 @@ namespace star3map {
 			sighting.name = s.name;
 			sighting.SetNum( i );
 			sighting.SetType( SOT_Star );			
+			maxDot = dot;
 		}
 		
 		
@@ -1227,6 +1325,7 @@ namespace star3map {
 				sighting.name = s.name;
 				sighting.SetNum( i );
 				sighting.SetType( SOT_Planet );			
+				maxDot = dot;
 			}			
 		}
 		
@@ -1247,6 +1346,7 @@ namespace star3map {
 	bool ProcessInput( bool active, int x, int y ) {
 		ScopedGfxContextAcquire ctx( drawContext );
         
+		InvalidateDisplay();
 		bool handled = menu.ProcessInput( active, x, y );
 		
 		if ( app_useCoreLocation.GetVal() == true && GotLocationUpdate == false ) {
@@ -1263,7 +1363,7 @@ namespace star3map {
 		}
 		
 		if ( handled == false ) {			
-			if ( appMode == AM_ViewStars && DetectClick( active, x, y ) && satSorter.Count() > 0 ) {
+			if ( appMode == AM_ViewStars && DetectClick( active, x, y ) && sim.numSorted > 0 ) {
 				TraceFromClick( x, y );
 			}			
 		}
@@ -1314,303 +1414,268 @@ namespace star3map {
 		return true;
 	}
 	
-	void DisplayViewStars();
-	void DisplayViewStars() {
-		DrawNonOverlappingStrings *nos = CreateNonOverlappingStrings();
+	// kept across frames so the label grid keeps its allocations
+	DrawNonOverlappingStrings *starLabels;
+	// kept across frames so its arrays keep their allocations
+	DrawList starsList;
+	DrawList globePlanetsList;
+	
+	// Records the star view into list.  The objects the list points at are
+	// prepared by DisplayViewStars before it is built, but this still needs
+	// the context: text creates the label batches on first use, and bakes
+	// glyphs it hasn't seen into the shared font atlas.
+	void BuildViewStars( DrawList & list );
+	void BuildViewStars( DrawList & list ) {
+		PROFILE_ZONE( "BuildViewStars" );
+		if ( starLabels == NULL ) {
+			starLabels = CreateNonOverlappingStrings();
+		}
+		DrawNonOverlappingStrings *nos = starLabels;
 		
 		float sightingAlpha = sin( frameBeginTime * R3_PI ) * 0.125f + 0.25f;
 		
-        { 
-            ScopedPushMatrix push( GL_MODELVIEW );
-            glMatrixLoadIdentityEXT( GL_MODELVIEW );
-            r3::Matrix4f proj = r3::Perspective( r_fov.GetVal(), float(r_windowWidth.GetVal()) / r_windowHeight.GetVal(), 0.5f, 100.0f );
-            Projection = proj;
-            glMatrixLoadfEXT( GL_PROJECTION, proj.Ptr() );
-            
-            
-            float latitude = ToRadians( app_latitude.GetVal() );
-            float longitude = ToRadians( app_longitude.GetVal() );
-            Matrix4f xout = Rotationf( Vec3f( 0, 1, 0 ), -R3_PI / 2.0f ).GetMatrix4(); // current Lat/Lon now at { 0, 0, 1 }, with z up
-            Matrix4f zup = Rotationf( Vec3f( 1, 0, 0 ), -R3_PI / 2.0f ).GetMatrix4();  // current Lat/Lon now at { 1, 0, 0 }, with z up
-            Matrix4f lat = Rotationf( Vec3f( 0, 1, 0 ), latitude ).GetMatrix4();       // current Lat/Lon now at { 1, 0, 0 }, with y up
-            Matrix4f lon = Rotationf( Vec3f( 0, 0, 1 ), -longitude ).GetMatrix4();
-            float phaseEarthRot = GetCurrentEarthPhase();
-            Matrix4f phase = Rotationf( Vec3f( 0, 0, 1 ), -phaseEarthRot ).GetMatrix4();
-            
-            Matrix4f comp = ( xout * zup * lat * lon * phase );
-            
-            ModelView = orientation * comp;
-            glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-            ScopedEnable blend( GL_BLEND );
-            ScopedDisable ddt( GL_DEPTH_TEST );
-            
-            glColor3f( 1, 1, 1 );
-            
-            // compute culling info
-            Matrix4f mvp = proj * orientation * comp;
-            Matrix4f imvp = mvp.Inverse();
-            Vec3f lookDir = imvp * Vec3f( 0, 0, -1 );
-            lookDir.Normalize();
-            Vec3f corner = imvp * Vec3f( 1, 1, 1 );
-            corner.Normalize();
-            float limit = lookDir.Dot( corner );
-            
-            float labelLimit = ( limit + 8 ) / 9.0f;
-            
-            { 
-                ScopedPushMatrix push( GL_MODELVIEW );
-                glMatrixMultfEXT( GL_MODELVIEW, orientation.Ptr() );
-                
-                // draw horizon hemisphere indicator
-                if ( app_showHemisphere.GetVal() ) {
-                    DrawUpHemisphere();	
-                }
-                
-                glMatrixMultfEXT( GL_MODELVIEW, comp.Ptr() );
-                
-                Matrix3f local = ToMatrix3( comp );
-                UpVector = local.GetRow(2); // to orient text correctly		
-                
-                // draw constellations
-                if ( app_showConstellations.GetVal() ) {
-                    for ( int i = 0; i < (int)constellations.size(); i++ ) {
-                        Lines &l = constellations[ i ];
-                        Vec4f c( .5, .5, .7, .5 );
-                        Vec4f cl( .5, .5, .7, .8 );
-                        Sighting sighting;
-                        sighting.SetNum( i );
-                        sighting.SetType( SOT_Constellation );
-                        if ( sightings.count( sighting.id ) != 0 ) {
-                            Vec4f c( .5, .5, .5, sightingAlpha );
-                            glColor4fv( c.Ptr() );
-                            glBegin( GL_LINES );
-                            for( int j = 0; j < (int)l.vert.size(); j++ ) {
-                                Vec3f & v = l.vert[ j ];
-                                glVertex3f( v.x, v.y, v.z );
-                            }
-                            glEnd();
-                            DrawString( l.name, l.center );
-                        } else if ( lookDir.Dot( l.center ) > l.limit ) {
-                            DynamicLinesInView( &l, c, cl, lookDir );
-                        }
-                    }
-                }
-                AgeDynamicLines();
-                DrawDynamicLines();
-                
-                glColor4f( 1, 1, 1, 1 );
-                
-                
-                // Reserve space for planet labels.
-                {
-                    for ( int i = 0; i < (int)solarsystem.size(); i++ ) {
-                        Sprite & s = solarsystem[i];
-                        nos->ReserveString( s.name, s.direction, lookDir, limit );
-                    }
-                }
-                
-                UpVector = local.GetRow(2); // to orient text correctly
-                
-                if ( app_showDirections.GetVal() ) {
-                    glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
-                    nos->DrawString( "Up", local.GetRow(2), lookDir, 0.3f );
-                    nos->DrawString( "Down", -local.GetRow(2), lookDir, 0.3f );
-                    glColor4f( 1, 1, 1, 1 );
-                    DrawSprite( (Texture2D *)tex["north"], 10, local.GetRow(1) );
-                    DrawSprite( (Texture2D *)tex["south"], 10, -local.GetRow(1) );
-                    DrawSprite( (Texture2D *)tex["east"], 10, local.GetRow(0) );
-                    DrawSprite( (Texture2D *)tex["west"], 10, -local.GetRow(0) );
-                }
-                
-                float dynamicLabelDot = 0.0f;
-                string dynamicLabel;
-                Vec4f dynamicLabelColor;
-                Vec3f dynamicLabelDirection;
-                
-                static int prev_culled;
-                int culled = 0;
-                int drew = 0;
-                for ( int i = 0; i < (int)stars.size(); i++ ) {
-                    Sprite & s = stars[i];
-                    if ( s.magnitude > 4 ) {
-                        continue;
-                    }
-                    float dot = lookDir.Dot( s.direction );
-                    if ( app_cull.GetVal() && dot < limit ) {
-                        culled++;
-                        continue;
-                    }			
-                    drew++;
-                    Sighting sighting;
-                    sighting.SetNum( i );
-                    sighting.SetType( SOT_Star );
-                    if ( sightings.count( sighting.id ) != 0 ) {
-                        glColor4f( 1, 1, 1, sightingAlpha );
-                        DrawString( s.name, s.direction );
-                    } else if ( s.name.size() > 0 && dot > labelLimit && dot > dynamicLabelDot && s.magnitude < 2.5 ) {
-                        glColor4f( 1, 1, 1, 1 );
-                        float c = ( dot - labelLimit ) / ( 1.0 - labelLimit );
-                        c = pow( c, 4 );
-                        dynamicLabelDot = dot;
-                        dynamicLabel = s.name;
-                        dynamicLabelColor = Vec4f( 1, 1, 1, c );
-                        dynamicLabelDirection = s.direction;
-                    }
-                }
-                
-                // draw stars
-                if ( app_showStars.GetVal() ) {
-                    r3Assert( stars.size() > 0 );
-                    Sprite & s = stars[0];
-                    s.tex->Bind( 0 );
-                    s.tex->Enable( 0 );
-                    glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
-                    mod["stars"]->Draw();
-                    s.tex->Disable( 0 );
-                }
-                
-                // draw satellites
-                if ( app_showSatellites.GetVal() ) {
-                    double t = GetTime() / 1.0;
-                    t = t - floor( t );
-                    float r = t + 0;
-                    float g = t + 1.0 / 3.0;
-                    float b = t + 2.0 / 3.0;
-                    r = ( cos( r * R3_PI * 2.0 ) * .5 + .5 ) * .5 + .5;
-                    g = ( cos( g * R3_PI * 2.0 ) * .5 + .5 ) * .5 + .5;
-                    b = ( cos( b * R3_PI * 2.0 ) * .5 + .5 ) * .5 + .5;
-                    glColor4f( r, g, b, 1 );
-                    Matrix4f invPhase = Rotationf( Vec3f( 0, 0, 1 ), phaseEarthRot ).GetMatrix4();
-                    //Matrix4f phase = Rotationf( Vec3f( 0, 0, 1 ), -phaseEarthRot ).GetMatrix4();
-                    Vec3f viewer = invPhase * SphericalToCartesian( RadiusEarthKm, latitude, longitude );
-                    
-
-#if APP_spacejunklite
-                    Vec3f pos;
-                    if( proTimeLeft >= 0 ) {
-                        pos = SphericalToCartesian( RadiusEarthKm, latitude, longitude );                
-                    } else {
-                        pos = SphericalToCartesian( RadiusEarthKm, ToRadians( app_latitude.GetVal() ), ToRadians( app_longitude.GetVal() ) );
-                        
-                    }
-#else
-                    Vec3f pos = SphericalToCartesian( RadiusEarthKm, latitude, longitude );                
-#endif
-                    satSorter.Sort( pos );
-                    
-                    
-                    for ( int i = 0; i < satSorter.Count(); i++ ) {
-                        Satellite & sat = satellite[ satSorter[ i ] ];
-                        Vec3f dir = invPhase * sat.pos - viewer;
-                        dir.Normalize();
-                        
-                        float dot = lookDir.Dot( dir );
-                        if ( app_cull.GetVal() && dot < limit ) {
-                            continue;
-                        }
-                        
-                        DrawSprite( (Texture2D *)tex["sat"], 5, dir );
-                        
-                        Sighting sighting;
-                        sighting.SetNum( sat.id );
-                        sighting.SetType( SOT_Satellite );
-                        if ( sightings.count( sighting.id ) != 0 ) {
-                            glColor4f( 1, 1, 1, sightingAlpha );
-                            DrawString( sat.name, dir );
-                        } else if ( dot > labelLimit && dot > dynamicLabelDot ) {
-                            float c = ( dot - labelLimit ) / ( 1.0 - labelLimit );
-                            c = pow( c, 4 );
-                            dynamicLabelDot = dot;
-                            dynamicLabel = sat.name;
-                            dynamicLabelColor = Vec4f( 1, 1, 1, c );
-                            dynamicLabelDirection = dir;
-                        }
-                        
-                    }
-                    
-                    glColor4f( 1, 1, 0, .5 );
-                    for( int i = 0; i < (int)satPath.size(); i++ ) {
-                        SatellitePath & sp = satPath[i];
-                        int last = (int)sp.pathPoint.size() - 1;
-                        while( last >= 0 && sp.pathPoint[ last ].aboveThreshold == false ) {
-                            last--;
-                        }
-                        if ( sp.special ) {
-                            glColor4f( 1, 1, 1, .5f );
-                        } else {
-                            glColor4f( 1, 1, 0, .5f );					
-                        }
-                        // hashes
-                        glBegin( GL_LINES );
-                        for( int j = 0; j < last; j++ ) {
-                            if ( ( j & 1 ) == 0 && j < (last - 2) ) {
-                                int now = int( sp.pathPoint[ j + 0 ].minutesFromEpoch );
-                                int nxt = int( sp.pathPoint[ j + 2 ].minutesFromEpoch );
-                                if( now != nxt ) {
-                                    j++;
-                                    continue;
-                                }
-                            }
-                            Vec3f p =   ( invPhase * sp.pathPoint[j].pos - viewer );
-                            p.Normalize();
-                            glVertex3f( p.x, p.y, p.z );
-                        }
-                        glEnd();
-                    }
-                    
-                }
-                
-                
-                AgeDynamicLabels();
-                DrawDynamicLabels( nos );
-                
-                if ( dynamicLabelDot > 0.0f ) {
-                    DynamicLabelInView( nos, dynamicLabel, dynamicLabelDirection, Vec4f( 1, 1, 1, 1), lookDir, limit );
-                }
-                
-                
-                if ( culled != prev_culled ) {
-                    //Output( "Culled %d and drew %d", culled, drew );
-                    prev_culled = culled;
-                }
-                
-                nos->ClearReservations();
-                {
-                    if ( app_showPlanets.GetVal() ) {
-                        for ( int i = 0; i < (int)solarsystem.size(); i++ ) {
-                            Sprite & s = solarsystem[i];
-                            Sighting sighting;
-                            sighting.SetNum( i );
-                            sighting.SetType( SOT_Planet );
-                            Vec4f c = s.color;
-                            if ( sightings.count( sighting.id ) != 0 ) {
-                                c.w = sightingAlpha;
-                            }
-                            glColor4fv( c.Ptr() );
-                            DrawSprite( s.tex, s.scale, s.direction );
-                            if ( app_showLabels.GetVal() ) {
-                                nos->DrawString( s.name, s.direction, lookDir, limit );
-                            }
-                        }
-                        
-                    }
-                }
-            }
-        }
-		delete nos;
+		r3::Matrix4f proj = r3::Perspective( frameSettings.fov, float( frameSettings.windowWidth ) / frameSettings.windowHeight, 0.5f, 100.0f );
+		Projection = proj;
+		list.Projection( proj );
+		
+		float latitude = ToRadians( app_latitude.GetVal() );
+		float longitude = ToRadians( app_longitude.GetVal() );
+		Matrix4f xout = Rotationf( Vec3f( 0, 1, 0 ), -R3_PI / 2.0f ).GetMatrix4(); // current Lat/Lon now at { 0, 0, 1 }, with z up
+		Matrix4f zup = Rotationf( Vec3f( 1, 0, 0 ), -R3_PI / 2.0f ).GetMatrix4();  // current Lat/Lon now at { 1, 0, 0 }, with z up
+		Matrix4f lat = Rotationf( Vec3f( 0, 1, 0 ), latitude ).GetMatrix4();       // current Lat/Lon now at { 1, 0, 0 }, with y up
+		Matrix4f lon = Rotationf( Vec3f( 0, 0, 1 ), -longitude ).GetMatrix4();
+		float phaseEarthRot = GetCurrentEarthPhase();
+		Matrix4f phase = Rotationf( Vec3f( 0, 0, 1 ), -phaseEarthRot ).GetMatrix4();
+		
+		Matrix4f comp = ( xout * zup * lat * lon * phase );
+		
+		ModelView = orientation * comp;
+		list.BlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+		list.Enable( GL_BLEND, true );
+		list.Enable( GL_DEPTH_TEST, false );
+		
+		// compute culling info
+		Matrix4f mvp = proj * orientation * comp;
+		Matrix4f imvp = mvp.Inverse();
+		nos->Begin( mvp );
+		Vec3f lookDir = imvp * Vec3f( 0, 0, -1 );
+		lookDir.Normalize();
+		Vec3f corner = imvp * Vec3f( 1, 1, 1 );
+		corner.Normalize();
+		float limit = lookDir.Dot( corner );
+		
+		float labelLimit = ( limit + 8 ) / 9.0f;
+		
+		// draw horizon hemisphere indicator
+		if ( frameSettings.showHemisphere ) {
+			list.Modelview( orientation );
+			list.Mesh( mod["hemi"], (Texture2D *)UseTexture( "hemi" ), Vec4f( 1, 1, 1, 1 ) );
+		}
+		
+		list.Modelview( orientation * comp );
+		
+		Matrix3f local = ToMatrix3( comp );
+		UpVector = local.GetRow(2); // to orient text correctly		
+		
+		// draw constellations
+		if ( frameSettings.showConstellations ) {
+			for ( int i = 0; i < (int)constellations.size(); i++ ) {
+				Lines &l = constellations[ i ];
+				Vec4f c( .5, .5, .7, .5 );
+				Vec4f cl( .5, .5, .7, .8 );
+				Sighting sighting;
+				sighting.SetNum( i );
+				sighting.SetType( SOT_Constellation );
+				if ( sightings.count( sighting.id ) != 0 ) {
+					Vec4f c( .5, .5, .5, sightingAlpha );
+					list.AddLineColor( i, c );
+					DrawString( list, l.name, l.center, c );
+				} else if ( lookDir.Dot( l.center ) > l.limit ) {
+					DynamicLinesInView( &l, i, c, cl, lookDir );
+				}
+			}
+		}
+		AgeDynamicLines();
+		DrawDynamicLines( list );
+		list.Lines( &constellationLines );
+		
+		// Reserve space for planet labels.
+		for ( int i = 0; i < (int)solarsystem.size(); i++ ) {
+			Sprite & s = solarsystem[i];
+			nos->ReserveString( s.name, s.direction, lookDir, limit );
+		}
+		
+		if ( frameSettings.showDirections ) {
+			Vec4f white( 1, 1, 1, 1 );
+			nos->DrawString( "Up", local.GetRow(2), lookDir, 0.3f, white, LabelPriority( 0, true ) );
+			nos->DrawString( "Down", -local.GetRow(2), lookDir, 0.3f, white, LabelPriority( 0, true ) );
+			list.Sprite( UseSprite( "north" ), SpriteTransform( 10, local.GetRow(1) ), white );
+			list.Sprite( UseSprite( "south" ), SpriteTransform( 10, -local.GetRow(1) ), white );
+			list.Sprite( UseSprite( "east" ), SpriteTransform( 10, local.GetRow(0) ), white );
+			list.Sprite( UseSprite( "west" ), SpriteTransform( 10, -local.GetRow(0) ), white );
+		}
+		
+		float dynamicLabelDot = 0.0f;
+		string dynamicLabel;
+		Vec4f dynamicLabelColor;
+		Vec3f dynamicLabelDirection;
+		float dynamicLabelPriority = 0.0f;
+		
+		int culled = 0;
+		int drew = 0;
+		skyQuery.clear();
+		starIndex.Query( lookDir, frameSettings.cull ? acos( limit ) : float( R3_PI ), skyQuery );
+		for ( int k = 0; k < (int)skyQuery.size(); k++ ) {
+			int i = skyQuery[ k ];
+			Sprite & s = stars[i];
+			float dot = lookDir.Dot( s.direction );
+			if ( frameSettings.cull && dot < limit ) {
+				culled++;
+				continue;
+			}			
+			drew++;
+			Sighting sighting;
+			sighting.SetNum( i );
+			sighting.SetType( SOT_Star );
+			if ( sightings.count( sighting.id ) != 0 ) {
+				DrawString( list, s.name, s.direction, Vec4f( 1, 1, 1, sightingAlpha ) );
+			} else if ( s.name.size() > 0 && dot > labelLimit && dot > dynamicLabelDot && s.magnitude < 2.5 ) {
+				float c = ( dot - labelLimit ) / ( 1.0 - labelLimit );
+				c = pow( c, 4 );
+				dynamicLabelDot = dot;
+				dynamicLabel = s.name;
+				dynamicLabelColor = Vec4f( 1, 1, 1, c );
+				dynamicLabelDirection = s.direction;
+				dynamicLabelPriority = LabelPriority( s.magnitude );
+			}
+		}
+		
+		// draw stars
+		if ( frameSettings.showStars ) {
+			r3Assert( stars.size() > 0 );
+			float starScale = frameSettings.starScale * frameSettings.scale;
+			float magLimit = frameSettings.starMagnitudeLimit;
+			if ( starCatalog.IsOpen() ) {
+				float split = min( frameSettings.starCatalogMagnitude, magLimit );
+				list.Stars( &starField, stars[0].tex, -1000.f, split, starScale );
+				float aspect = float( frameSettings.windowWidth ) / max( 1, frameSettings.windowHeight );
+				list.Stars( &starCatalog, stars[0].tex, lookDir, frameSettings.fov, aspect, split, magLimit, starScale );
+			} else {
+				list.Stars( &starField, stars[0].tex, -1000.f, magLimit, starScale );
+			}
+		}
+		
+		// draw satellites
+		if ( frameSettings.showSatellites ) {
+			double t = GetTime() / 1.0;
+			t = t - floor( t );
+			float r = t + 0;
+			float g = t + 1.0 / 3.0;
+			float b = t + 2.0 / 3.0;
+			r = ( cos( r * R3_PI * 2.0 ) * .5 + .5 ) * .5 + .5;
+			g = ( cos( g * R3_PI * 2.0 ) * .5 + .5 ) * .5 + .5;
+			b = ( cos( b * R3_PI * 2.0 ) * .5 + .5 ) * .5 + .5;
+			Vec4f satColor( r, g, b, 1 );
+			Matrix4f invPhase = Rotationf( Vec3f( 0, 0, 1 ), phaseEarthRot ).GetMatrix4();
+			Vec3f viewer = invPhase * SphericalToCartesian( RadiusEarthKm, latitude, longitude );
+			
+			// same size as SpriteTransform( 5, dir )
+			const float satRadius = 5 * 10 * frameSettings.starScale * frameSettings.scale;
+			for ( int i = 0; i < sim.numSorted; i++ ) {
+				Satellite & sat = sim.satellites[ sim.sorted[ i ] ];
+				Vec3f dir = invPhase * sat.pos - viewer;
+				dir.Normalize();
+				
+				float dot = lookDir.Dot( dir );
+				if ( frameSettings.cull && dot < limit ) {
+					continue;
+				}
+				
+				list.AddBillboard( dir, satRadius, satColor );
+				
+				Sighting sighting;
+				sighting.SetNum( sat.id );
+				sighting.SetType( SOT_Satellite );
+				if ( sightings.count( sighting.id ) != 0 ) {
+					DrawString( list, sat.name, dir, Vec4f( 1, 1, 1, sightingAlpha ) );
+				} else if ( dot > labelLimit && dot > dynamicLabelDot ) {
+					float c = ( dot - labelLimit ) / ( 1.0 - labelLimit );
+					c = pow( c, 4 );
+					dynamicLabelDot = dot;
+					dynamicLabel = sat.name;
+					dynamicLabelColor = Vec4f( 1, 1, 1, c );
+					dynamicLabelDirection = dir;
+					dynamicLabelPriority = LabelPriority( 0, sat.special );
+				}
+				
+			}
+			list.Billboards( &satBillboards, (Texture2D *)UseTexture( "sat" ) );
+			
+			list.Flyover( &flyoverPaths, invPhase, viewer, true, false );
+		}
+		
+		{
+			PROFILE_ZONE( "LabelLayout" );
+			AgeDynamicLabels();
+			DrawDynamicLabels( nos );
+			
+			if ( dynamicLabelDot > 0.0f ) {
+				DynamicLabelInView( nos, dynamicLabel, dynamicLabelDirection, Vec4f( 1, 1, 1, 1), lookDir, limit, dynamicLabelPriority );
+			}
+		}
+		
+		ProfileCounter( "stars culled", (float)( starIndex.Size() - drew ) );
+		ProfileCounter( "stars tested", (float)( drew + culled ) );
+		ProfileCounter( "stars drawn", (float)drew );
+		
+		nos->ClearReservations();
+		if ( frameSettings.showPlanets ) {
+			UsePlanetSprites();
+			for ( int i = 0; i < (int)solarsystem.size(); i++ ) {
+				Sprite & s = solarsystem[i];
+				Sighting sighting;
+				sighting.SetNum( i );
+				sighting.SetType( SOT_Planet );
+				Vec4f c = s.color;
+				bool sighted = sightings.count( sighting.id ) != 0;
+				if ( sighted ) {
+					c.w = sightingAlpha;
+				}
+				if ( planetSprite[i].tex ) {
+					list.Sprite( planetSprite[i], SpriteTransform( s.scale, s.direction ), c );
+				}
+				if ( frameSettings.showLabels ) {
+					nos->DrawString( s.name, s.direction, lookDir, limit, c, LabelPriority( 0, true, sighted ) );
+				}
+			}
+		}
+		nos->End( list );
+		list.Text();
+	}
+	
+	void DisplayViewStars();
+	void DisplayViewStars() {
+		PROFILE_ZONE( "DisplayViewStars" );
+		// GPU objects the list refers to are (re)built here, on the render thread
+		if ( frameSettings.showConstellations && constellationLines.Size() != min( (int)constellations.size(), (int)LineSet::MaxSets ) ) {
+			constellationLines.Build( constellations );
+		}
+		starsList.Clear();
+		BuildViewStars( starsList );
+		Submit( starsList );
 	}
     
 	void DisplayViewGlobe();	
 	void DisplayViewGlobe() {
-		DrawNonOverlappingStrings * nos = CreateNonOverlappingStrings();
+		PROFILE_ZONE( "DisplayViewGlobe" );
 		
         glDepthFunc( GL_LESS );
         glEnable( GL_DEPTH_TEST );
         { 
             ScopedPushMatrix push( GL_MODELVIEW ); // 0
             glMatrixLoadIdentityEXT( GL_MODELVIEW );
-            r3::Matrix4f proj = r3::Perspective( r_fov.GetVal(),
-                                                float(r_windowWidth.GetVal()) / r_windowHeight.GetVal(), 0.5f, 100.0f );
+            r3::Matrix4f proj = r3::Perspective( frameSettings.fov,
+                                                float( frameSettings.windowWidth ) / frameSettings.windowHeight, 0.5f, 100.0f );
             Projection = proj;
             glMatrixLoadfEXT( GL_PROJECTION, proj.Ptr() );
             
@@ -1637,14 +1702,16 @@ namespace star3map {
                     ScopedPushMatrix push( GL_MODELVIEW ); // 1
                     glMatrixMultfEXT( GL_MODELVIEW, comp.Ptr() );
                     
-                    if( app_showGlobe.GetVal() ) {
-                        DrawEarth();			
+                    if( frameSettings.showGlobe ) {
+                        // the globe has unit radius, 2 units from the eye
+                        float pixelRadius = 0.5f / tan( ToRadians( frameSettings.fov * 0.5f ) ) * frameSettings.windowHeight * 0.5f;
+                        DrawEarth( pixelRadius );			
                     }
                     Vec3f lookDir;
                     Vec3f frust[8];
                     {
                         r3::Matrix4f svproj = 
-                        r3::Perspective( viewStarsFov, float(r_windowWidth.GetVal()) / r_windowHeight.GetVal(), 0.5f, 100.0f );
+                        r3::Perspective( viewStarsFov, float( frameSettings.windowWidth ) / frameSettings.windowHeight, 0.5f, 100.0f );
                         float svlatitude = ToRadians( app_latitude.GetVal() );
                         float svlongitude = ToRadians( app_longitude.GetVal() );
                         Matrix4f svlat = Rotationf( Vec3f( 0, 1, 0 ), svlatitude ).GetMatrix4();       // current Lat/Lon now at { 1, 0, 0 }, with y up
@@ -1673,6 +1740,9 @@ namespace star3map {
                     Matrix4f currTrans;
                     glGetFloatv( GL_MODELVIEW_MATRIX, currTrans.Ptr() );
                     Matrix4f billboard = ToMatrix4( ToMatrix3( currTrans.Inverse() ) );
+                    // sprite size and on-screen cap that DrawSpriteAtLocation used
+                    const float globeSpriteRadius = 150 * frameSettings.scale;
+                    const float globeSpriteMaxUnitHeight = 1000;
                     // current view position
                     {
                         Vec3f currPos = SphericalToCartesian( 1.005, ToRadians( app_latitude.GetVal() ), ToRadians( app_longitude.GetVal() ) );
@@ -1708,100 +1778,47 @@ namespace star3map {
                         {
                             glPolygonOffset( 0, textDepthBias );
                             ScopedEnable po( GL_POLYGON_OFFSET_FILL );                            
-                            glMultiTexEnviEXT( GL_TEXTURE0 + 0, GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
-                            DrawSpriteAtLocation( stars[0].tex, currPos, billboard );
-                            DrawStringAtLocation( "you are here", currPos, billboard );
+                            satBillboards.Clear();
+                            satBillboards.Add( currPos, globeSpriteRadius, Vec4f( 1, 0, 0, 1 ) );
+                            satBillboards.Draw( stars[0].tex, globeSpriteMaxUnitHeight, 0.1f );
+                            DrawStringAtLocation( "you are here", currPos, billboard, Vec4f( 1, 0, 0, 1 ) );
+                            FlushStrings();
                         }
                         
                     }
                     
-                    if ( app_showSatellites.GetVal() ) {
+                    if ( frameSettings.showSatellites ) {
                         //glPointSize( 3 );
                         //ApplyTransform( phase );
                         ScopedEnable bl( GL_BLEND );
                         glMultiTexEnviEXT( GL_TEXTURE0 + 0, GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
 
                         
-#if APP_spacejunklite
-                        Vec3f pos;
-                        if( proTimeLeft >= 0 ) {
-                            pos = SphericalToCartesian( RadiusEarthKm, latitude, longitude );                
-                        } else {
-                            pos = SphericalToCartesian( RadiusEarthKm, ToRadians( app_latitude.GetVal() ), ToRadians( app_longitude.GetVal() ) );
-                            
-                        }
-#else
-                        Vec3f pos = SphericalToCartesian( RadiusEarthKm, latitude, longitude );                
-#endif
-                        satSorter.Sort( pos );
-                        
-                        glColor4f( 1, 1, 0, 1 );
-                        
-
                         glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-                        for ( int i = 0; i < satSorter.Count(); i++ ) {
-                            Satellite & s = satellite[ satSorter[ i ] ];
-                            if ( s.special ) {
-                                glColor4f( 1, 1, 1, 1 );
-                            } else {
-                                glColor4f( 1, 1, 0, 1 );					
-                            }
+                        satBillboards.Clear();
+                        for ( int i = 0; i < sim.numSorted; i++ ) {
+                            Satellite & s = sim.satellites[ sim.sorted[ i ] ];
                             Vec3f p = s.pos;
                             p /= RadiusEarthKm;
-                            DrawSpriteAtLocation( stars[0].tex, p, billboard );
+                            satBillboards.Add( p, globeSpriteRadius, s.special ? Vec4f( 1, 1, 1, 1 ) : Vec4f( 1, 1, 0, 1 ) );
                         }
+                        satBillboards.Draw( stars[0].tex, globeSpriteMaxUnitHeight, 0.1f );
                         
                         { 
                             ScopedPushMatrix push( GL_MODELVIEW );     // 3
                             ScopedEnable po( GL_POLYGON_OFFSET_FILL );
-                            for ( int i = 0; i < satSorter.Count(); i++ ) {
-                                Satellite & s = satellite[ satSorter[ i ] ];
-                                if ( s.special ) {
-                                    glColor4f( 1, 1, 1, 1 );
-                                } else {
-                                    glColor4f( 1, 1, 0, 1 );					
-                                }
+                            for ( int i = 0; i < sim.numSorted; i++ ) {
+                                Satellite & s = sim.satellites[ sim.sorted[ i ] ];
                                 Vec3f p = s.pos;
                                 p /= RadiusEarthKm;
-                                DrawStringAtLocation( s.name, p, billboard );
+                                DrawStringAtLocation( s.name, p, billboard, s.special ? Vec4f( 1, 1, 1, 1 ) : Vec4f( 1, 1, 0, 1 ) );
                             }
+                            FlushStrings();
                         }
                         
-                        for( int i = 0; i < (int)satPath.size(); i++ ) {
-                            SatellitePath & sp = satPath[i];
-                            int last = (int)sp.pathPoint.size() - 1;
-                            while( last >= 0 && sp.pathPoint[ last ].aboveThreshold == false ) {
-                                last--;
-                            }
-                            if ( sp.special ) {
-                                glColor4f( 1, 1, 1, .5f );
-                            } else {
-                                glColor4f( 1, 1, 0, .5f );					
-                            }
-                            // hashes
-                            glBegin( GL_LINES );
-                            for( int j = 0; j < last; j++ ) {
-                                if ( ( j & 1 ) == 0 && j < (last - 2) ) {
-                                    int now = int( sp.pathPoint[ j + 0 ].minutesFromEpoch );
-                                    int nxt = int( sp.pathPoint[ j + 2 ].minutesFromEpoch );
-                                    if( now != nxt ) {
-                                        j++;
-                                        continue;
-                                    }
-                                }
-                                Vec3f p = sp.pathPoint[j].pos / float( RadiusEarthKm );
-                                glVertex3f( p.x, p.y, p.z );
-                            }
-                            glEnd();
-                            // the space between hashes
-                            glColor4f( 0, 0, 0, .5 );
-                            glBegin( GL_LINES );
-                            for( int j = 1; j < last; j++ ) {
-                                Vec3f p = sp.pathPoint[j].pos / float( RadiusEarthKm );
-                                glVertex3f( p.x, p.y, p.z );
-                            }
-                            glEnd();				
-                        }
+                        Matrix4f toEarthRadii;
+                        toEarthRadii.SetScale( 1.0f / float( RadiusEarthKm ) );
+                        flyoverPaths.Draw( toEarthRadii, Vec3f( 0, 0, 0 ), false, true );
                         
                     }
                     
@@ -1838,19 +1855,21 @@ namespace star3map {
                         glMultiTexEnviEXT( GL_TEXTURE0 + 0, GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
 
                         // draw stars
-                        if ( app_showStars.GetVal() ) {
-                            stars[0].tex->Bind( 0 );
-                            stars[0].tex->Enable( 0 );
-                            mod["stars"]->Draw();
-                            stars[0].tex->Disable( 0 );
+                        if ( frameSettings.showStars ) {
+                            starField.Draw( stars[0].tex, -1000.f, frameSettings.starMagnitudeLimit, frameSettings.starScale * frameSettings.scale );
                         }
                         
-                        if ( app_showPlanets.GetVal() ) {
+                        if ( frameSettings.showPlanets ) {
+                            UsePlanetSprites();
+                            globePlanetsList.Clear();
                             for ( int i = 0; i < (int)solarsystem.size(); i++ ) {
                                 Sprite & s = solarsystem[i];
-                                glColor4fv( s.color.Ptr() );
-                                DrawSprite( s.tex, s.scale, s.direction );
+                                if ( planetSprite[i].tex ) {
+                                    globePlanetsList.Sprite( planetSprite[i], SpriteTransform( s.scale, s.direction ), s.color );
+                                }
                             }
+                            // one bind for the planets atlas, rather than one per planet
+                            Submit( globePlanetsList );
                         }                        
                     }
                 }
@@ -1858,7 +1877,6 @@ namespace star3map {
             }
         }
         glDisable( GL_DEPTH_TEST );
-		delete nos;
 	}
     
 	void DisplayInitializing() {
@@ -1874,7 +1892,7 @@ namespace star3map {
             float dt = t - t0;
             float darken = std::max( 0.2f, 1.0f - ( dt * 0.2f ) );
             glColor4f( darken, darken, darken, 1.0f );
-            DrawSprite( (Texture2D *)tex["splash"], Bounds2f( -1, -1, 1, 1 ) );
+            DrawSprite( (Texture2D *)UseTexture( "splash" ), Bounds2f( -1, -1, 1, 1 ) );
 
             glDisableIndexedEXT( GL_TEXTURE_2D, 0 );
             
@@ -1905,7 +1923,7 @@ namespace star3map {
                 string ls = loadingString;
                 glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
                 ScopedEnable blend( GL_BLEND );
-                DrawString2D( ls, Bounds2f( 0.05, 0.42, 0.95, 0.48 ) ); 
+                DrawString2D( ls, Bounds2f( 0.05, 0.42, 0.95, 0.48 ), Vec4f( 1, 1, 1, 1 ) ); 
             }
         }
         
@@ -1931,8 +1949,12 @@ namespace star3map {
             scaleBias.SetScale( Vec3f( w, w, 1 ) );
             glMatrixMultfEXT( GL_MODELVIEW, scaleBias.Ptr() );
             
-            tex["qr"]->Bind( 0 );
-            tex["qr"]->Enable( 0 );
+            Texture * qr = UseTexture( "qr" );
+            if ( qr == NULL ) {
+                return;
+            }
+            qr->Bind( 0 );
+            qr->Enable( 0 );
             TexEnvCombineAlphaModulate( 0 );
             
             glDisable( GL_BLEND );
@@ -1952,7 +1974,7 @@ namespace star3map {
             
             glEnable( GL_BLEND );
             
-            tex["qr"]->Disable( 0 );
+            qr->Disable( 0 );
             
         }
         
@@ -1979,8 +2001,6 @@ namespace star3map {
             btn["appstore"]->color = Vec4f( 1,1,1,1 );
         }
         
-        glColor4fv( c.Ptr() );
-        
         char buf[80];
         string s;
         if( proTimeLeft >= 0 ) {
@@ -1991,7 +2011,7 @@ namespace star3map {
             r3Sprintf( buf, ": %d", proTimeWindow - proTimeDuty + proTimeLeft );            
             
         }
-		DrawLocalizedString2D( s + buf, b, NULL, Align_Mid );
+		DrawLocalizedString2D( s + buf, b, c, Align_Mid );
         //glColor4f( 1, 1, 1, 1 );
         
     }
@@ -2074,7 +2094,222 @@ namespace star3map {
 	}
 	
 	
+	FrameSettings frameSettings;
+	
+	void UpdateFrameSettings() {
+		FrameSettings & fs = frameSettings;
+		// padding too, so snapshots can be compared with memcmp
+		memset( &fs, 0, sizeof( fs ) );
+		fs.cull = app_cull.GetVal();
+		fs.maxSatellites = app_maxSatellites.GetVal();
+		fs.starScale = app_starScale.GetVal();
+		fs.scale = app_scale.GetVal();
+		fs.debugLabels = app_debugLabels.GetVal();
+		fs.pauseAging = app_pauseAging.GetVal();
+		fs.nightViewing = app_nightViewing.GetVal();
+		fs.showStars = app_showStars.GetVal();
+		fs.showConstellations = app_showConstellations.GetVal();
+		fs.showPlanets = app_showPlanets.GetVal();
+		fs.showSatellites = app_showSatellites.GetVal();
+		fs.showLabels = app_showLabels.GetVal();
+		fs.showDirections = app_showDirections.GetVal();
+		fs.showHemisphere = app_showHemisphere.GetVal();
+		fs.showGlobe = app_showGlobe.GetVal();
+		fs.fov = r_fov.GetVal();
+		fs.starCatalogMagnitude = app_starCatalogMagnitude.GetVal();
+		fs.starMagnitudeLimit = app_starMagnitudeLimit.GetVal() + app_starMagnitudeZoom.GetVal() * max( 0.f, log( 60.f / fs.fov ) / log( 2.f ) );
+		fs.windowWidth = r_windowWidth.GetVal();
+		fs.windowHeight = r_windowHeight.GetVal();
+	}
+	
+	// The simulation works a frame ahead, so it gets the viewer as of this one.
+	SimulationInput GetSimulationInput() {
+		SimulationInput in;
+		in.latitude = app_latitude.GetVal();
+		in.longitude = app_longitude.GetVal();
+		float lat = in.latitude;
+		float lon = in.longitude;
+#if APP_spacejunklite
+		bool sortFromGlobeView = proTimeLeft >= 0;
+#else
+		bool sortFromGlobeView = true;
+#endif
+		if ( appMode == AM_ViewGlobe && sortFromGlobeView ) {
+			lat = globeViewLat;
+			lon = globeViewLon;
+		}
+		in.sortOrigin = SphericalToCartesian( RadiusEarthKm, ToRadians( lat ), ToRadians( lon ) );
+		in.maxSatellites = app_maxSatellites.GetVal();
+		in.showSatellites = app_showSatellites.GetVal();
+		return in;
+	}
+	
+	// What the last frame was drawn from, so DisplayNeeded() can tell
+	// whether the next one would look any different.
+	struct DrawnFrame {
+		DrawnFrame() : time( 0.0 ), appMode( AM_Uninitialized ), earthPhase( 0.f ) {
+			memset( &settings, 0, sizeof( settings ) );
+		}
+		double time;
+		AppModeEnum appMode;
+		FrameSettings settings;
+		Matrix4f orientation;
+		Vec2f location;
+		Vec2f globeView;
+		float earthPhase;
+		Vec3f sunDir;                // earth fixed
+		vector< int > satelliteId;   // the drawn satellites, in sim.sorted order
+		vector< Vec3f > satellitePos;
+	};
+	DrawnFrame drawn;
+	bool displayInvalid = true;
+	
+	// The worker threads step once per published input, so input is only
+	// published for a frame that will be drawn, or at the animation rate
+	// while satellites are shown so DisplayNeeded() can see them move.  A
+	// frame that DisplayNeeded() asked for doesn't publish again in Display().
+	bool inputPublished;
+	double inputPublishedTime;
+	
+	void PublishSimulationInput() {
+		SetSimulationInput( GetSimulationInput() );
+		condRender.Broadcast();
+		inputPublished = true;
+		inputPublishedTime = GetTime();
+	}
+	
+	Vec3f EarthFixedSunDirection() {
+		Vec3d sunPos = sim.number > 0 ? sim.sunPosition : ss.body[ SSB_Sun ].equatorialPos;
+		Vec3f sunDir( sunPos.x, sunPos.y, sunPos.z );
+		sunDir.Normalize();
+		return Rotationf( Vec3f( 0, 0, 1 ), -GetCurrentEarthPhase() ).GetMatrix3() * sunDir;
+	}
+	
+	void RecordDrawnFrame() {
+		drawn.time = GetTime();
+		drawn.appMode = appMode;
+		drawn.settings = frameSettings;
+		drawn.orientation = orientation;
+		drawn.location = Vec2f( app_latitude.GetVal(), app_longitude.GetVal() );
+		drawn.globeView = Vec2f( globeViewLat, globeViewLon );
+		drawn.earthPhase = GetCurrentEarthPhase();
+		drawn.sunDir = EarthFixedSunDirection();
+		drawn.satelliteId.clear();
+		drawn.satellitePos.clear();
+		for ( int i = 0; i < sim.numSorted; i++ ) {
+			Satellite & sat = sim.satellites[ sim.sorted[ i ] ];
+			drawn.satelliteId.push_back( sat.id );
+			drawn.satellitePos.push_back( sat.pos );
+		}
+		displayInvalid = false;
+	}
+	
+	// How far, in pixels, anything on screen has moved since the last frame.
+	// Angles are small, so chord lengths stand in for them.
+	float DrawnFrameMotion( const Matrix4f & currOrientation ) {
+		float pixelsPerRadian = 0.5f * frameSettings.windowHeight / tan( ToRadians( frameSettings.fov ) * 0.5f );
+		float angle = 0.f;
+		for ( int i = 0; i < 3; i++ ) {
+			Vec4f d = currOrientation.GetRow( i ) - drawn.orientation.GetRow( i );
+			angle = max( angle, Vec3f( d.x, d.y, d.z ).Length() );
+		}
+		float motion = angle * pixelsPerRadian;
+		
+		bool satellites = frameSettings.showSatellites && sim.numSorted > 0;
+		if ( satellites && sim.numSorted != (int)drawn.satelliteId.size() ) {
+			return 1e6f;
+		}
+		if ( appMode == AM_ViewStars ) {
+			// the whole sky turns with the earth
+			motion += fabs( GetCurrentEarthPhase() - drawn.earthPhase ) * pixelsPerRadian;
+			Vec3f viewer = SphericalToCartesian( RadiusEarthKm, ToRadians( app_latitude.GetVal() ), ToRadians( app_longitude.GetVal() ) );
+			for ( int i = 0; satellites && i < sim.numSorted; i++ ) {
+				Satellite & sat = sim.satellites[ sim.sorted[ i ] ];
+				if ( sat.id != drawn.satelliteId[ i ] ) {
+					return 1e6f;
+				}
+				Vec3f d0 = drawn.satellitePos[ i ] - viewer;
+				Vec3f d1 = sat.pos - viewer;
+				d0.Normalize();
+				d1.Normalize();
+				motion = max( motion, ( d1 - d0 ).Length() * pixelsPerRadian );
+			}
+		} else if ( appMode == AM_ViewGlobe ) {
+			// the globe has unit radius at a distance of 2
+			float pixelsPerUnit = 0.5f * pixelsPerRadian;
+			motion += ( EarthFixedSunDirection() - drawn.sunDir ).Length() * pixelsPerUnit;
+			for ( int i = 0; satellites && i < sim.numSorted; i++ ) {
+				Satellite & sat = sim.satellites[ sim.sorted[ i ] ];
+				if ( sat.id != drawn.satelliteId[ i ] ) {
+					return 1e6f;
+				}
+				motion = max( motion, ( sat.pos - drawn.satellitePos[ i ] ).Length() / float( RadiusEarthKm ) * pixelsPerUnit );
+			}
+		}
+		return motion;
+	}
+	
+	void InvalidateDisplay() {
+		displayInvalid = true;
+	}
+	
+	bool DisplayChanged() {
+		if ( app_redrawOnChange.GetVal() == false || displayInvalid ) {
+			return true;
+		}
+		if ( appMode == AM_Uninitialized || appMode == AM_Initializing ) {
+			return true;
+		}
+		double sinceDrawn = GetTime() - drawn.time;
+		if ( sinceDrawn * 1000.0 >= app_redrawMaxMsec.GetVal() ) {
+			return true;
+		}
+		
+		// anything in motion on its own
+		if ( touchActive || inputInertia.Length() > 1 || DynamicObjectsAnimating() || StatusActive() || app_showProfile.GetVal() ) {
+			return true;
+		}
+		
+		UpdateFrameSettings();
+		if ( appMode != drawn.appMode || memcmp( &frameSettings, &drawn.settings, sizeof( frameSettings ) ) != 0 ) {
+			return true;
+		}
+		if ( Vec2f( app_latitude.GetVal(), app_longitude.GetVal() ) != drawn.location || Vec2f( globeViewLat, globeViewLon ) != drawn.globeView ) {
+			return true;
+		}
+		
+		// satellite color cycling and sighting pulses only need a modest rate
+		bool decorated = appMode == AM_ViewStars && ( sightings.size() > 0 || ( frameSettings.showSatellites && sim.numSorted > 0 ) );
+		if ( decorated && sinceDrawn * 1000.0 >= app_redrawAnimationMsec.GetVal() ) {
+			return true;
+		}
+		
+		// satellite motion is judged from the last published step, and the
+		// simulation only steps again once per animation interval
+		TakeSimulationFrame( sim );
+		Matrix4f currOrientation = app_useCompass.GetVal() ? platformOrientation : manualOrientation;
+		if ( DrawnFrameMotion( currOrientation ) >= app_redrawPixels.GetVal() ) {
+			return true;
+		}
+		double sincePublished = GetTime() - inputPublishedTime;
+		if ( frameSettings.showSatellites && sincePublished * 1000.0 >= app_redrawAnimationMsec.GetVal() ) {
+			PublishSimulationInput();
+		}
+		return false;
+	}
+	
+	bool DisplayNeeded() {
+		PROFILE_ZONE( "DisplayNeeded" );
+		if ( DisplayChanged() == false ) {
+			return false;
+		}
+		PublishSimulationInput();
+		return true;
+	}
+	
 	void Display() {
+		ProfileFrame();
+		PROFILE_ZONE( "Display" );
 		Initialize();  // do this once instead?
 		
         static int displayCount = 0;
@@ -2082,7 +2317,10 @@ namespace star3map {
         if( ( displayCount % 0x1f ) == 0 ) {
             //Output( "Display()" );
         } 
-        condRender.Broadcast();
+		if ( inputPublished == false ) {
+			PublishSimulationInput();
+		}
+		inputPublished = false;
         
 		frameBeginTime = GetTime();
 		CleanupSightings();
@@ -2096,6 +2334,8 @@ namespace star3map {
             app_maxSatellites.SetVal( 5 );
         }
 #endif
+		// after the lite mode adjustment above, so it sees this frame's limit
+		UpdateFrameSettings();
         
 		ScopedGfxContextAcquire ctx( drawContext );
         glMatrixLoadIdentityEXT( GL_PROJECTION );
@@ -2108,22 +2348,26 @@ namespace star3map {
         
 		CheckStatusMessageTriggers();
 		
+		// the newest frame from the simulation thread, which is already
+		// working on the next one
+		TakeSimulationFrame( sim );
 		UpdateSolarSystemSprites();
 		ApplyInputInertia();		
 		
-		if ( app_nightViewing.GetVal() ) {
+		if ( frameSettings.nightViewing ) {
 			glColorMask( true, false, false, true );
 		} 
         
-		if ( app_showSatellites.GetVal() ) {
-			ComputeSatellitePositions( satellite );
-            
-			GetSatelliteFlyovers( app_latitude.GetVal(), app_longitude.GetVal(), satPath );
+		if ( frameSettings.showSatellites ) {
+			if ( TakeSimulationPaths( satPath, satPathVersion ) ) {
+				flyoverPaths.Update( satPath );
+			}
 		}
         
 		orientation = app_useCompass.GetVal() ? platformOrientation : manualOrientation;
         
 		UpdateLatLon();
+		RecordDrawnFrame();
         
 		
 		switch ( appMode ) {
@@ -2160,19 +2404,21 @@ namespace star3map {
             if ( app_satelliteUrl.GetVal().find( "favorites.php" ) != string::npos ) {
                 float w = r_windowWidth.GetVal();
                 float h = r_windowHeight.GetVal();
-                glColor4f( 1.0, .4, .2, .5 );
+                Vec4f c( 1.0, .4, .2, .5 );
                 glBlendFunc( GL_SRC_ALPHA,  GL_ONE_MINUS_SRC_ALPHA );
                 glEnable( GL_BLEND );
                 if( app_fbId.GetVal().size() == 0 ) {
-                    DrawString2D( "log in to Facebook for favorites", Bounds2f(  0.0f,  h / 2.0f - 50.f, w, h / 2.0f + 50.f ) );
-                } else if ( satellite.size() == 0 ) {
-                    DrawString2D( "No favorites selected.", Bounds2f(  0.0f,  h / 2.0f + 50.f, w, h / 2.0f + 100.f ) );
-                    DrawString2D( "Manage favorites at", Bounds2f(  0.0f,  h / 2.0f +  0.f, w, h / 2.0f + 50.f ) );
-                    DrawString2D( "http://home.xyzw.us/star3map/user.php", Bounds2f(  0.0f,  h / 2.0f - 50.f, w, h / 2.0f +  0.f ) );
+                    DrawString2D( "log in to Facebook for favorites", Bounds2f(  0.0f,  h / 2.0f - 50.f, w, h / 2.0f + 50.f ), c );
+                } else if ( sim.satellites.size() == 0 ) {
+                    DrawString2D( "No favorites selected.", Bounds2f(  0.0f,  h / 2.0f + 50.f, w, h / 2.0f + 100.f ), c );
+                    DrawString2D( "Manage favorites at", Bounds2f(  0.0f,  h / 2.0f +  0.f, w, h / 2.0f + 50.f ), c );
+                    DrawString2D( "http://home.xyzw.us/star3map/user.php", Bounds2f(  0.0f,  h / 2.0f - 50.f, w, h / 2.0f +  0.f ), c );
                 }
                 glDisable( GL_BLEND );
             }
             
+            RenderProfileOverlay();
+            
             if( console != NULL ) {
                 console->Draw();
             }
@@ -2185,7 +2431,7 @@ namespace star3map {
 			Output( "Swapping first frame now." );
 		}
 		
-		if ( app_nightViewing.GetVal() ) {
+		if ( frameSettings.nightViewing ) {
 			glColorMask( true, true, true, true );
 		} 
         
@@ -2193,7 +2439,9 @@ namespace star3map {
 		
 		GfxSwapBuffers();
 		GfxCheckErrors();
-        
+		
+		TrimTextures();
+		SaveSharedFont();
 	}		
     
 	
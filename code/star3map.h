@@ -77,6 +77,13 @@ namespace star3map {
 	void Display();	
 	bool ProcessInput( bool active, int x, int y );
 	
+	// For the platform's update timer, in place of drawing unconditionally.
+	// Steps the worker threads, and returns true when Display() would draw
+	// something visibly different from the last frame.
+	bool DisplayNeeded();
+	// makes the next DisplayNeeded() true, e.g. after a key press
+	void InvalidateDisplay();
+	
 	inline float ModuloRange( float f, float lower, float upper ) {
 		float delta = upper - lower;
 		float fndiff = ( f - lower ) / delta;
@@ -0,0 +1,415 @@
+/*
+ *  starcatalog
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "starcatalog.h"
+#include "skyindex.h"
+#include "profile.h"
+
+#include "r3/filesystem.h"
+#include "r3/output.h"
+#include "r3/var.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#if _WIN32
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+VarInteger app_starCatalogTiles( "app_starCatalogTiles", "most star catalog tile buckets kept uploaded", 0, 512 );
+VarInteger app_starCatalogUploads( "app_starCatalogUploads", "most star catalog tile buckets uploaded per frame", 0, 8 );
+
+namespace {
+	
+	const int CatalogVersion = 2;
+	
+	// FNV-1a
+	unsigned int Hash( unsigned int h, const void *data, int size ) {
+		const unsigned char *p = (const unsigned char *)data;
+		for ( int i = 0; i < size; i++ ) {
+			h = ( h ^ p[i] ) * 16777619u;
+		}
+		return h;
+	}
+	
+	template< typename T > void Append( vector< unsigned char > & buf, const T *data, size_t count ) {
+		const unsigned char *p = (const unsigned char *)data;
+		buf.insert( buf.end(), p, p + count * sizeof( T ) );
+	}
+	
+	bool OlderFirst( const pair< int, int > & a, const pair< int, int > & b ) {
+		return a.first < b.first;
+	}
+	
+}
+
+namespace star3map {
+	
+	// Maps the file when filename is a plain path, and otherwise reads it in
+	// through r3's file system, which is where writeStarCatalog puts it.
+	struct StarCatalog::MappedFile {
+		const unsigned char *data;
+		size_t size;
+		bool mapped;
+		vector< unsigned char > copy;
+#if _WIN32
+		HANDLE file;
+		HANDLE mapping;
+#else
+		int fd;
+#endif
+		
+		MappedFile() : data( NULL ), size( 0 ), mapped( false ) {}
+		
+		bool Open( const string & filename ) {
+			if ( Map( filename ) ) {
+				mapped = true;
+				return true;
+			}
+			if ( FileReadToMemory( filename, copy ) == false || copy.size() == 0 ) {
+				copy.clear();
+				return false;
+			}
+			data = &copy[0];
+			size = copy.size();
+			return true;
+		}
+		
+		bool Map( const string & filename ) {
+#if _WIN32
+			file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+			if ( file == INVALID_HANDLE_VALUE ) {
+				return false;
+			}
+			size = GetFileSize( file, NULL );
+			mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+			if ( mapping == NULL ) {
+				CloseHandle( file );
+				return false;
+			}
+			data = (const unsigned char *)MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+			if ( data == NULL ) {
+				CloseHandle( mapping );
+				CloseHandle( file );
+				return false;
+			}
+#else
+			fd = open( filename.c_str(), O_RDONLY );
+			if ( fd < 0 ) {
+				return false;
+			}
+			struct stat st;
+			if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) {
+				close( fd );
+				return false;
+			}
+			size = (size_t)st.st_size;
+			void *p = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+			if ( p == MAP_FAILED ) {
+				close( fd );
+				return false;
+			}
+			data = (const unsigned char *)p;
+#endif
+			return true;
+		}
+		
+		void Close() {
+			if ( data == NULL ) {
+				return;
+			}
+			if ( mapped == false ) {
+				vector< unsigned char >().swap( copy );
+				data = NULL;
+				size = 0;
+				return;
+			}
+#if _WIN32
+			UnmapViewOfFile( data );
+			CloseHandle( mapping );
+			CloseHandle( file );
+#else
+			munmap( (void *)data, size );
+			close( fd );
+#endif
+			mapped = false;
+			data = NULL;
+			size = 0;
+		}
+	};
+	
+	StarCatalog::StarCatalog() : file( NULL ), header( NULL ), tiles( NULL ), records( NULL ), frame( 0 ) {
+	}
+	
+	StarCatalog::~StarCatalog() {
+		Close();
+	}
+	
+	bool StarCatalog::Open( const string & filename, unsigned int sourceHash ) {
+		Close();
+		file = new MappedFile;
+		if ( file->Open( filename ) == false ) {
+			Output( "No star catalog %s.", filename.c_str() );
+			Close();
+			return false;
+		}
+		const StarCatalogHeader *h = (const StarCatalogHeader *)file->data;
+		if ( file->size < sizeof( StarCatalogHeader ) || memcmp( h->magic, "S3SC", 4 ) != 0 || h->version != CatalogVersion ||
+			h->faceDim < 1 || h->numBuckets < 1 || h->numBuckets > StarCatalogHeader::MaxBuckets || h->numRecords < 0 ) {
+			Output( "Star catalog %s has a bad header.", filename.c_str() );
+			Close();
+			return false;
+		}
+		if ( h->sourceHash != sourceHash ) {
+			Output( "Star catalog %s is out of date with the star data.", filename.c_str() );
+			Close();
+			return false;
+		}
+		int numTiles = 6 * h->faceDim * h->faceDim;
+		size_t tableSize = (size_t)numTiles * h->numBuckets * sizeof( StarCatalogTile );
+		if ( file->size < sizeof( StarCatalogHeader ) + tableSize + (size_t)h->numRecords * sizeof( StarRecord ) ) {
+			Output( "Star catalog %s is truncated.", filename.c_str() );
+			Close();
+			return false;
+		}
+		const StarCatalogTile *t = (const StarCatalogTile *)( file->data + sizeof( StarCatalogHeader ) );
+		for ( int i = 0; i < numTiles * h->numBuckets; i++ ) {
+			if ( t[i].first < 0 || t[i].count < 0 || t[i].first + t[i].count > h->numRecords ) {
+				Output( "Star catalog %s has a bad tile table.", filename.c_str() );
+				Close();
+				return false;
+			}
+		}
+		header = h;
+		tiles = t;
+		records = (const StarRecord *)( file->data + sizeof( StarCatalogHeader ) + tableSize );
+		
+		// bounding cone of each tile
+		int n = header->faceDim;
+		tileCenter.resize( numTiles );
+		tileRadius.resize( numTiles );
+		for ( int f = 0; f < 6; f++ ) {
+			for ( int j = 0; j < n; j++ ) {
+				for ( int i = 0; i < n; i++ ) {
+					float u0 = 2.f * i / n - 1.f, u1 = 2.f * ( i + 1 ) / n - 1.f;
+					float v0 = 2.f * j / n - 1.f, v1 = 2.f * ( j + 1 ) / n - 1.f;
+					int ti = ( f * n + j ) * n + i;
+					Vec3f c = CubeDirection( f, ( u0 + u1 ) * 0.5f, ( v0 + v1 ) * 0.5f );
+					float minDot = min( min( c.Dot( CubeDirection( f, u0, v0 ) ), c.Dot( CubeDirection( f, u1, v0 ) ) ),
+									   min( c.Dot( CubeDirection( f, u0, v1 ) ), c.Dot( CubeDirection( f, u1, v1 ) ) ) );
+					tileCenter[ ti ] = c;
+					tileRadius[ ti ] = acos( max( -1.f, min( 1.f, minDot ) ) );
+				}
+			}
+		}
+		Output( "Mapped star catalog %s: %d stars in %d tiles.", filename.c_str(), header->numRecords, numTiles );
+		return true;
+	}
+	
+	void StarCatalog::Close() {
+		Evict( 0 );
+		if ( file ) {
+			file->Close();
+			delete file;
+			file = NULL;
+		}
+		header = NULL;
+		tiles = NULL;
+		records = NULL;
+		tileCenter.clear();
+		tileRadius.clear();
+	}
+	
+	void StarCatalog::Evict( int budget ) {
+		if ( (int)resident.size() <= budget ) {
+			return;
+		}
+		vector< pair< int, int > > age;
+		for ( map< int, Resident >::iterator it = resident.begin(); it != resident.end(); ++it ) {
+			if ( it->second.lastUsed != frame || budget == 0 ) {
+				age.push_back( make_pair( it->second.lastUsed, it->first ) );
+			}
+		}
+		sort( age.begin(), age.end(), OlderFirst );
+		int excess = (int)resident.size() - budget;
+		for ( int i = 0; i < (int)age.size() && i < excess; i++ ) {
+			map< int, Resident >::iterator it = resident.find( age[i].second );
+			delete it->second.field;
+			resident.erase( it );
+		}
+	}
+	
+	void StarCatalog::Draw( Texture2D *tex, const Vec3f & lookDir, float fov, float aspect,
+						    float minMagnitude, float maxMagnitude, float scale ) {
+		if ( header == NULL || tex == NULL ) {
+			return;
+		}
+		PROFILE_ZONE( "StarCatalog::Draw" );
+		frame++;
+		
+		// half angle of the cone around the frustum's corners
+		float t = tan( ToRadians( fov * 0.5f ) );
+		float a = max( aspect, 1.f / max( aspect, 0.0001f ) );
+		float viewRadius = atan( t * sqrt( 1.f + a * a ) );
+		
+		// brighter buckets first, so they win the upload budget
+		visible.clear();
+		int numTiles = (int)tileCenter.size();
+		int buckets = header->numBuckets;
+		for ( int b = 0; b < buckets; b++ ) {
+			float lo = b > 0 ? header->bucketLimit[ b - 1 ] : -1000.f;
+			float hi = header->bucketLimit[ b ];
+			if ( hi <= minMagnitude || lo >= maxMagnitude ) {
+				continue;
+			}
+			for ( int i = 0; i < numTiles; i++ ) {
+				float r = min( float( R3_PI ), viewRadius + tileRadius[ i ] );
+				if ( lookDir.Dot( tileCenter[ i ] ) < cos( r ) ) {
+					continue;
+				}
+				int key = i * buckets + b;
+				if ( tiles[ key ].count > 0 ) {
+					visible.push_back( key );
+				}
+			}
+		}
+		
+		int uploads = 0;
+		int drawn = 0;
+		StarField::Begin( tex, minMagnitude, maxMagnitude, scale );
+		for ( int i = 0; i < (int)visible.size(); i++ ) {
+			int key = visible[ i ];
+			map< int, Resident >::iterator it = resident.find( key );
+			if ( it == resident.end() ) {
+				if ( uploads >= app_starCatalogUploads.GetVal() ) {
+					continue;
+				}
+				uploads++;
+				Resident r;
+				r.field = new StarField;
+				r.field->Build( records + tiles[ key ].first, tiles[ key ].count );
+				it = resident.insert( make_pair( key, r ) ).first;
+			}
+			it->second.lastUsed = frame;
+			it->second.field->DrawPoints();
+			drawn += it->second.field->Size();
+		}
+		StarField::End();
+		Evict( app_starCatalogTiles.GetVal() );
+		
+		ProfileCounter( "catalog tiles resident", (float)resident.size() );
+		ProfileCounter( "catalog tiles uploaded", (float)uploads );
+		ProfileCounter( "catalog stars drawn", (float)drawn );
+	}
+	
+	unsigned int StarCatalog::SourceHash( const vector< Sprite > & stars ) {
+		unsigned int h = 2166136261u;
+		for ( int i = 0; i < (int)stars.size(); i++ ) {
+			StarRecord r = MakeStarRecord( stars[i] );
+			h = Hash( h, &r, sizeof( r ) );
+		}
+		return h;
+	}
+	
+	bool StarCatalog::Write( const string & filename, const vector< Sprite > & stars,
+							 int faceDim, const vector< float > & bucketLimits ) {
+		int buckets = (int)bucketLimits.size();
+		if ( faceDim < 1 || buckets < 1 || buckets > StarCatalogHeader::MaxBuckets ) {
+			return false;
+		}
+		int numTiles = 6 * faceDim * faceDim;
+		vector< vector< StarRecord > > bins( numTiles * buckets );
+		for ( int i = 0; i < (int)stars.size(); i++ ) {
+			const Sprite & s = stars[i];
+			int b = int( lower_bound( bucketLimits.begin(), bucketLimits.end(), s.magnitude ) - bucketLimits.begin() );
+			if ( b == buckets ) {
+				continue; // fainter than the last bucket
+			}
+			bins[ CubeCell( s.direction, faceDim ) * buckets + b ].push_back( MakeStarRecord( s ) );
+		}
+		
+		StarCatalogHeader h;
+		memset( &h, 0, sizeof( h ) );
+		memcpy( h.magic, "S3SC", 4 );
+		h.version = CatalogVersion;
+		h.faceDim = faceDim;
+		h.numBuckets = buckets;
+		h.sourceHash = SourceHash( stars );
+		vector< StarCatalogTile > table( bins.size() );
+		for ( int i = 0; i < (int)bins.size(); i++ ) {
+			table[i].first = h.numRecords;
+			table[i].count = (int)bins[i].size();
+			h.numRecords += table[i].count;
+		}
+		for ( int b = 0; b < buckets; b++ ) {
+			h.bucketLimit[ b ] = bucketLimits[ b ];
+		}
+		
+		vector< unsigned char > buf;
+		Append( buf, &h, 1 );
+		Append( buf, &table[0], table.size() );
+		for ( int i = 0; i < (int)bins.size(); i++ ) {
+			if ( bins[i].size() ) {
+				Append( buf, &bins[i][0], bins[i].size() );
+			}
+		}
+		
+		File *out = FileOpenForWrite( filename );
+		if ( out == NULL ) {
+			return false;
+		}
+		out->Write( &buf[0], 1, (int)buf.size() );
+		delete out;
+		return true;
+	}
+	
+}
@@ -0,0 +1,131 @@
+/*
+ *  starcatalog
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_STARCATALOG_H__
+#define __STAR3MAP_STARCATALOG_H__
+
+#include "starfield.h"
+
+#include "r3/linear.h"
+#include "r3/texture.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace star3map {
+	
+	// A large star catalog, memory mapped from a binary file and drawn a
+	// tile at a time.  The sky is split along the faces of a cube, each face
+	// into faceDim x faceDim tiles, and each tile's stars into magnitude
+	// buckets.  Only buckets that are in view and bright enough for the
+	// current magnitude limit get uploaded, and tiles that go unused are
+	// dropped again, so cost tracks what is on screen.
+	//
+	// Catalogs are only written by the writeStarCatalog command.  The header
+	// carries a hash of the star data it was built from, and Open() refuses a
+	// catalog built from different stars.
+	//
+	// File layout, native endian:
+	//   StarCatalogHeader
+	//   StarCatalogTile[ 6 * faceDim * faceDim ][ numBuckets ]
+	//   StarRecord[ numRecords ]
+	
+	struct StarCatalogHeader {
+		enum { MaxBuckets = 8 };
+		char magic[4];        // "S3SC"
+		int version;
+		int faceDim;
+		int numBuckets;
+		int numRecords;
+		unsigned int sourceHash;   // StarCatalog::SourceHash() of the stars written
+		// faintest magnitude in each bucket, ascending
+		float bucketLimit[ MaxBuckets ];
+	};
+	
+	struct StarCatalogTile {
+		int first;    // index into the records
+		int count;
+	};
+	
+	class StarCatalog {
+	public:
+		StarCatalog();
+		~StarCatalog();
+		
+		bool Open( const std::string & filename, unsigned int sourceHash );
+		void Close();
+		bool IsOpen() const { return header != NULL; }
+		
+		// Draws the catalog stars with magnitudes in ( minMagnitude, maxMagnitude ]
+		// that may be within the view cone, uploading tiles as needed.  fov is
+		// in degrees.  The remaining arguments are as for StarField.
+		void Draw( r3::Texture2D *tex, const r3::Vec3f & lookDir, float fov, float aspect,
+				   float minMagnitude, float maxMagnitude, float scale );
+		
+		static unsigned int SourceHash( const std::vector< Sprite > & stars );
+		static bool Write( const std::string & filename, const std::vector< Sprite > & stars,
+						   int faceDim, const std::vector< float > & bucketLimits );
+		
+	private:
+		struct MappedFile;
+		struct Resident {
+			StarField *field;
+			int lastUsed;
+		};
+		
+		void Evict( int budget );
+		
+		MappedFile *file;
+		const StarCatalogHeader *header;
+		const StarCatalogTile *tiles;
+		const StarRecord *records;
+		std::vector< r3::Vec3f > tileCenter;
+		std::vector< float > tileRadius;   // radians
+		std::map< int, Resident > resident;
+		std::vector< int > visible;
+		int frame;
+	};
+	
+}
+
+#endif //__STAR3MAP_STARCATALOG_H__
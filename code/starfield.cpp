@@ -0,0 +1,194 @@
+/*
+ *  starfield
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "starfield.h"
+#include "profile.h"
+
+#include "r3/shader.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	Shader *starFieldShader;
+	
+	Shader * GetStarFieldShader() {
+		if ( starFieldShader == NULL ) {
+			Shader * s = starFieldShader = CreateShaderFromFile( "starfield" );
+			glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
+			glBindAttribLocation( s->pgObject, AL_Color, "Color" );
+			glBindAttribLocation( s->pgObject, AL_TexCoord + 0, "Magnitude" );
+			glLinkProgram( s->pgObject );
+		}
+		return starFieldShader;
+	}
+	
+	// the largest gl_PointSize the implementation draws, which can be as
+	// small as 1 on ES
+	float MaxPointSize() {
+		static float maxPointSize = 0.f;
+		if ( maxPointSize == 0.f ) {
+			GLfloat range[2] = { 1.f, 1.f };
+			glGetFloatv( GL_ALIASED_POINT_SIZE_RANGE, range );
+			maxPointSize = max( range[1], 1.f );
+		}
+		return maxPointSize;
+	}
+	
+	// indexed by whole magnitude, clamped to [0,6]
+	const float magToDiam[] = { 2.0f, 1.5f, 1.25f, 1.0f, .85f, .75f, .5f };
+	const float magToColor[] = { 1.0f, .9f, .7f, .5f, .3f, .2f, .1f };
+	
+	short ToShort( float f ) {
+		return (short)( max( -1.f, min( 1.f, f ) ) * 32767.f );
+	}
+	
+	unsigned char ToByte( float f ) {
+		return (unsigned char)( max( 0.f, min( 1.f, f ) ) * 255.f + 0.5f );
+	}
+	
+}
+
+namespace star3map {
+	
+	StarField::StarField() : buffer( 0 ), numStars( 0 ) {
+	}
+	
+	StarField::~StarField() {
+		if ( buffer ) {
+			glDeleteBuffers( 1, &buffer );
+		}
+	}
+	
+	StarRecord MakeStarRecord( const Sprite & s ) {
+		StarRecord r;
+		r.dir[0] = ToShort( s.direction.x );
+		r.dir[1] = ToShort( s.direction.y );
+		r.dir[2] = ToShort( s.direction.z );
+		r.magnitude = (short)( max( -127.f, min( 127.f, s.magnitude ) ) * 256.f );
+		r.c[0] = ToByte( s.color.x );
+		r.c[1] = ToByte( s.color.y );
+		r.c[2] = ToByte( s.color.z );
+		// alpha carries the sprite scale, over [0,2]
+		r.c[3] = ToByte( s.scale * 0.5f );
+		return r;
+	}
+	
+	void StarField::Build( const vector< Sprite > & stars ) {
+		PROFILE_ZONE( "StarField::Build" );
+		vector< StarRecord > data( stars.size() );
+		for ( int i = 0; i < (int)stars.size(); i++ ) {
+			data[i] = MakeStarRecord( stars[i] );
+		}
+		Build( data.size() ? &data[0] : NULL, (int)data.size() );
+	}
+	
+	void StarField::Build( const StarRecord * records, int count ) {
+		numStars = count;
+		if ( numStars == 0 ) {
+			return;
+		}
+		if ( buffer == 0 ) {
+			glGenBuffers( 1, &buffer );
+		}
+		glNamedBufferDataEXT( buffer, numStars * sizeof( StarRecord ), records, GL_STATIC_DRAW );
+	}
+	
+	void StarField::Draw( Texture2D *tex, float minMagnitude, float maxMagnitude, float scale ) {
+		if ( numStars == 0 || tex == NULL ) {
+			return;
+		}
+		PROFILE_ZONE( "StarField::Draw" );
+		Begin( tex, minMagnitude, maxMagnitude, scale );
+		DrawPoints();
+		End();
+	}
+	
+	void StarField::Begin( Texture2D *tex, float minMagnitude, float maxMagnitude, float scale ) {
+		Shader *s = GetStarFieldShader();
+		tex->Bind( 0 );
+		glUseProgram( s->pgObject );
+		glUniform1fv( glGetUniformLocation( s->pgObject, "MagToDiam" ), 7, magToDiam );
+		glUniform1fv( glGetUniformLocation( s->pgObject, "MagToColor" ), 7, magToColor );
+		s->SetUniform( "MagnitudeRange", Vec2f( minMagnitude, maxMagnitude ) );
+		s->SetUniform( "Scale", scale );
+		s->SetUniform( "WindowHeight", (float)frameSettings.windowHeight );
+		s->SetUniform( "MaxPointSize", MaxPointSize() );
+		s->SetUniform( "TexScale", Vec2f( float( tex->Width() ) / tex->PaddedWidth(), float( tex->Height() ) / tex->PaddedHeight() ) );
+#if ! ( ANDROID || IPHONE )
+		// always on in ES 2.0, and not valid enables there
+		glEnable( GL_PROGRAM_POINT_SIZE );
+		glEnable( GL_POINT_SPRITE );
+#endif
+		glEnableVertexAttribArray( AL_Position );
+		glEnableVertexAttribArray( AL_TexCoord + 0 );
+		glEnableVertexAttribArray( AL_Color );
+	}
+	
+	void StarField::DrawPoints() {
+		if ( numStars == 0 ) {
+			return;
+		}
+		glBindBuffer( GL_ARRAY_BUFFER, buffer );
+		glVertexAttribPointer( AL_Position, 3, GL_SHORT, GL_TRUE, sizeof( StarRecord ), 0 );
+		glVertexAttribPointer( AL_TexCoord + 0, 1, GL_SHORT, GL_FALSE, sizeof( StarRecord ), (const GLvoid *)( 3 * sizeof( short ) ) );
+		glVertexAttribPointer( AL_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( StarRecord ), (const GLvoid *)( 4 * sizeof( short ) ) );
+		glDrawArrays( GL_POINTS, 0, numStars );
+	}
+	
+	void StarField::End() {
+		glDisableVertexAttribArray( AL_Color );
+		glDisableVertexAttribArray( AL_TexCoord + 0 );
+		glDisableVertexAttribArray( AL_Position );
+		glBindBuffer( GL_ARRAY_BUFFER, 0 );
+#if ! ( ANDROID || IPHONE )
+		glDisable( GL_POINT_SPRITE );
+		glDisable( GL_PROGRAM_POINT_SIZE );
+#endif
+		glUseProgram( 0 );
+	}
+	
+}
@@ -0,0 +1,95 @@
+/*
+ *  starfield
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_STARFIELD_H__
+#define __STAR3MAP_STARFIELD_H__
+
+#include "render.h"
+
+#include "r3/texture.h"
+
+#include <vector>
+
+namespace star3map {
+	
+	// One star, as stored in the vertex buffer and in star catalog files.
+	struct StarRecord {
+		short dir[3];       // normalized
+		short magnitude;    // 8.8 fixed point
+		unsigned char c[4]; // rgb, and the sprite scale / 2 in a
+	};
+	
+	StarRecord MakeStarRecord( const Sprite & star );
+
+	// Every star as a single point sprite.  A star is one 12 byte vertex:
+	// its direction, magnitude and color.  Base/starfield.vp applies the
+	// magnitude limit and the size and brightness ramps, so changing them
+	// does not touch the vertex buffer.
+	class StarField {
+	public:
+		StarField();
+		~StarField();
+		
+		void Build( const std::vector< Sprite > & stars );
+		void Build( const StarRecord * records, int count );
+		int Size() const { return numStars; }
+		
+		// Draws with the current modelview and projection.  Only stars with
+		// magnitudes in ( minMagnitude, maxMagnitude ] are drawn.  A star's
+		// half size is 10 * scale times its size ramp value, as the old star
+		// quads were.
+		void Draw( r3::Texture2D *tex, float minMagnitude, float maxMagnitude, float scale );
+		
+		// For drawing several fields with the same settings: Begin, then
+		// DrawPoints on each, then End.
+		static void Begin( r3::Texture2D *tex, float minMagnitude, float maxMagnitude, float scale );
+		void DrawPoints();
+		static void End();
+		
+	private:
+		GLuint buffer;
+		int numStars;
+	};
+	
+}
+
+#endif //__STAR3MAP_STARFIELD_H__
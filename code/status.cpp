@@ -46,7 +46,6 @@
 #include <GL/Regal.h>
 
 #include "r3/draw.h"
-#include "r3/font.h"
 #include "r3/time.h"
 #include "r3/var.h"
 
@@ -59,50 +58,15 @@ using namespace std;
 extern VarInteger r_windowWidth;
 extern VarInteger r_windowHeight;
 extern VarInteger r_windowDpi;
-extern VarString app_locale;
 
 namespace {
 
 	const float messageDuration = 3.0f;
 	
-	Font *font;
 	float startTime;
 	float lastUpdateTime;
 	string statusMsg;
 	
-	bool initialized = false;
-	void Initialize() {
-		if( initialized ) {
-			return;
-		}
-        
-        string fontName = "DroidSans.ttf";
-        string fallback = "";
-        string locale = app_locale.GetVal();
-        if( locale.find( "ar_" ) != string::npos ) {
-            fallback = fontName;
-            fontName = "DroidSansArabic.ttf";
-        } else if( locale.find( "he_" ) != string::npos || locale.find( "iw_" ) != string::npos ) {
-            fallback = fontName;
-            fontName = "DroidSansHebrew.ttf";
-        } else if( locale.find( "th_" ) != string::npos ) {
-            fallback = fontName;
-            fontName = "DroidSansThai.ttf";
-        } else if( locale.find( "zh_" ) != string::npos ||
-                  locale.find( "ko_" ) != string::npos ||
-                  locale.find( "ja_" ) != string::npos ||
-                  0 // locale.find( "ru_" ) != string::npos
-                  ) {
-            fallback = fontName;
-            fontName = "DroidSansFallback.ttf";
-        }
-
-		font = r3::CreateStbFont( fontName, fallback, 24 );
-		//font = r3::CreateStbFont( "LiberationSans-Regular.ttf", 24 );
-		
-		initialized  = true;
-	}
-	
 	bool enable = false;
 }
 
@@ -129,6 +93,11 @@ namespace star3map {
 	}
 	
 	
+	// a message is showing or fading out
+	bool StatusActive() {
+		return enable && statusMsg.size() > 0;
+	}
+	
 	void RenderStatus() {
 		if( enable == false ) {
 			return;
@@ -136,7 +105,6 @@ namespace star3map {
 		if ( statusMsg.size() == 0 ) {
 			return;
 		}
-		Initialize();
 		
 		float t = GetSeconds();
 		float alphaRampIn = min( 1.0f, ( t - startTime ) * 2.0f );
@@ -164,9 +132,8 @@ namespace star3map {
 		glEnd();
 		
 		
-		glColor4f( 0.8f, 0.8f, 0.8f, 0.8 * alpha );
-
-		DrawString2D( statusMsg, b , font );
+		// in the shared font, which DrawString2D sizes to b
+		DrawString2D( statusMsg, b, Vec4f( 0.8f, 0.8f, 0.8f, 0.8f * alpha ) );
         glDisable( GL_BLEND );
 
 		if( alphaRampOut == 0.0f ) {
@@ -50,6 +50,7 @@ namespace star3map {
 	void EnableStatusMessages();
 	void DisableStatusMessages();
 	void SetStatus( const char *msg );
+	bool StatusActive();
 	void RenderStatus();
 
 }
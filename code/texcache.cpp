@@ -0,0 +1,677 @@
+/*
+ *  texcache
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "texcache.h"
+
+#include "r3/filesystem.h"
+#include "r3/output.h"
+
+#include <GL/Regal.h>
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+# define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+# define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_ETC1_RGB8_OES
+# define GL_ETC1_RGB8_OES 0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+# define GL_COMPRESSED_RGB8_ETC2 0x9274
+#endif
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	// the internal format the driver takes for each, 0 when it takes none
+	GLenum etc1Format;
+	GLenum bc1Format;
+	GLenum bc3Format;
+	
+	bool HasExtension( const char *extensions, const char *name ) {
+		if ( extensions == NULL ) {
+			return false;
+		}
+		size_t len = strlen( name );
+		for ( const char *p = strstr( extensions, name ); p != NULL; p = strstr( p + len, name ) ) {
+			if ( ( p == extensions || p[-1] == ' ' ) && ( p[len] == ' ' || p[len] == 0 ) ) {
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	GLenum InternalFormat( CompressedFormatEnum f ) {
+		switch( f ) {
+			case CompressedFormat_ETC1: return etc1Format;
+			case CompressedFormat_BC1: return bc1Format;
+			case CompressedFormat_BC3: return bc3Format;
+			default: return 0;
+		}
+	}
+	
+	// Auto becomes the first supported format that fits the channels
+	CompressedFormatEnum Resolve( CompressedFormatEnum f, int components ) {
+		bool alpha = components == 2 || components == 4;
+		if ( f == CompressedFormat_Auto ) {
+			if ( alpha ) {
+				f = CompressedFormat_BC3;
+			} else {
+				f = etc1Format ? CompressedFormat_ETC1 : CompressedFormat_BC1;
+			}
+		}
+		if ( alpha && f != CompressedFormat_BC3 ) {
+			return CompressedFormat_None;
+		}
+		return InternalFormat( f ) ? f : CompressedFormat_None;
+	}
+	
+	const char * FormatName( CompressedFormatEnum f ) {
+		switch( f ) {
+			case CompressedFormat_Auto: return "COMPRESSED";
+			case CompressedFormat_ETC1: return "ETC1";
+			case CompressedFormat_BC1: return "BC1";
+			case CompressedFormat_BC3: return "BC3";
+			default: return "";
+		}
+	}
+	
+	bool IsPowerOfTwo( int x ) {
+		return x > 0 && ( x & ( x - 1 ) ) == 0;
+	}
+	
+	struct Pixels {
+		int width;
+		int height;
+		vector< unsigned char > rgba;
+	};
+	
+	void Expand( const unsigned char *src, int width, int height, int components, Pixels & out ) {
+		out.width = width;
+		out.height = height;
+		out.rgba.resize( width * height * 4 );
+		for ( int i = 0; i < width * height; i++ ) {
+			const unsigned char *s = src + i * components;
+			unsigned char *d = &out.rgba[ i * 4 ];
+			if ( components < 3 ) {
+				d[0] = d[1] = d[2] = s[0];
+				d[3] = components == 2 ? s[1] : 255;
+			} else {
+				d[0] = s[0];
+				d[1] = s[1];
+				d[2] = s[2];
+				d[3] = components == 4 ? s[3] : 255;
+			}
+		}
+	}
+	
+	// box filter to the next mip level
+	void Downsample( const Pixels & src, Pixels & dst ) {
+		dst.width = max( 1, src.width / 2 );
+		dst.height = max( 1, src.height / 2 );
+		dst.rgba.resize( dst.width * dst.height * 4 );
+		int dx = src.width > 1 ? 1 : 0;
+		int dy = src.height > 1 ? 1 : 0;
+		for ( int y = 0; y < dst.height; y++ ) {
+			for ( int x = 0; x < dst.width; x++ ) {
+				const unsigned char *s0 = &src.rgba[ ( ( y * 2 ) * src.width + x * 2 ) * 4 ];
+				const unsigned char *s1 = s0 + dy * src.width * 4;
+				for ( int c = 0; c < 4; c++ ) {
+					int sum = s0[c] + s0[ dx * 4 + c ] + s1[c] + s1[ dx * 4 + c ];
+					dst.rgba[ ( y * dst.width + x ) * 4 + c ] = (unsigned char)( ( sum + 2 ) / 4 );
+				}
+			}
+		}
+	}
+	
+	// the 4x4 block at block coordinates bx, by, with edge pixels repeated
+	// for levels smaller than a block
+	void GetBlock( const Pixels & p, int bx, int by, unsigned char block[16][4] ) {
+		for ( int y = 0; y < 4; y++ ) {
+			int sy = min( by * 4 + y, p.height - 1 );
+			for ( int x = 0; x < 4; x++ ) {
+				int sx = min( bx * 4 + x, p.width - 1 );
+				memcpy( block[ y * 4 + x ], &p.rgba[ ( sy * p.width + sx ) * 4 ], 4 );
+			}
+		}
+	}
+	
+	int ColorDistance( const int a[3], const unsigned char b[4] ) {
+		int dr = a[0] - b[0];
+		int dg = a[1] - b[1];
+		int db = a[2] - b[2];
+		return dr * dr + dg * dg + db * db;
+	}
+	
+	unsigned short To565( const unsigned char c[4] ) {
+		return (unsigned short)( ( ( c[0] * 31 + 127 ) / 255 ) << 11 | ( ( c[1] * 63 + 127 ) / 255 ) << 5 | ( ( c[2] * 31 + 127 ) / 255 ) );
+	}
+	
+	void From565( unsigned short v, int c[3] ) {
+		int r = ( v >> 11 ) & 31;
+		int g = ( v >> 5 ) & 63;
+		int b = v & 31;
+		c[0] = ( r << 3 ) | ( r >> 2 );
+		c[1] = ( g << 2 ) | ( g >> 4 );
+		c[2] = ( b << 3 ) | ( b >> 2 );
+	}
+	
+	// BC1 color block, in four color mode.  The endpoints are the pixels
+	// furthest apart along the block's bounding box diagonal, with the
+	// diagonal's direction flipped to follow the color correlation.
+	void EncodeBc1( const unsigned char block[16][4], unsigned char *out ) {
+		int mean[3] = { 0, 0, 0 };
+		int lo[3] = { 255, 255, 255 };
+		int hi[3] = { 0, 0, 0 };
+		for ( int i = 0; i < 16; i++ ) {
+			for ( int c = 0; c < 3; c++ ) {
+				mean[c] += block[i][c];
+				lo[c] = min( lo[c], (int)block[i][c] );
+				hi[c] = max( hi[c], (int)block[i][c] );
+			}
+		}
+		int covRG = 0;
+		int covBG = 0;
+		for ( int i = 0; i < 16; i++ ) {
+			int g = block[i][1] * 16 - mean[1];
+			covRG += ( block[i][0] * 16 - mean[0] ) * g;
+			covBG += ( block[i][2] * 16 - mean[2] ) * g;
+		}
+		int axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+		if ( covRG < 0 ) {
+			axis[0] = -axis[0];
+		}
+		if ( covBG < 0 ) {
+			axis[2] = -axis[2];
+		}
+		int minI = 0;
+		int maxI = 0;
+		int minP = 0x7fffffff;
+		int maxP = -0x7fffffff;
+		for ( int i = 0; i < 16; i++ ) {
+			int p = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+			if ( p < minP ) {
+				minP = p;
+				minI = i;
+			}
+			if ( p > maxP ) {
+				maxP = p;
+				maxI = i;
+			}
+		}
+		unsigned short c0 = To565( block[ maxI ] );
+		unsigned short c1 = To565( block[ minI ] );
+		if ( c0 < c1 ) {
+			swap( c0, c1 );
+		}
+		int palette[4][3];
+		From565( c0, palette[0] );
+		From565( c1, palette[1] );
+		for ( int c = 0; c < 3; c++ ) {
+			palette[2][c] = ( 2 * palette[0][c] + palette[1][c] ) / 3;
+			palette[3][c] = ( palette[0][c] + 2 * palette[1][c] ) / 3;
+		}
+		unsigned int indexes = 0;
+		if ( c0 != c1 ) {
+			for ( int i = 0; i < 16; i++ ) {
+				int best = 0;
+				int bestDist = ColorDistance( palette[0], block[i] );
+				for ( int j = 1; j < 4; j++ ) {
+					int d = ColorDistance( palette[j], block[i] );
+					if ( d < bestDist ) {
+						bestDist = d;
+						best = j;
+					}
+				}
+				indexes |= best << ( i * 2 );
+			}
+		}
+		out[0] = c0 & 0xff;
+		out[1] = c0 >> 8;
+		out[2] = c1 & 0xff;
+		out[3] = c1 >> 8;
+		for ( int i = 0; i < 4; i++ ) {
+			out[ 4 + i ] = ( indexes >> ( i * 8 ) ) & 0xff;
+		}
+	}
+	
+	// BC3 alpha block, in eight value mode, then the BC1 color block
+	void EncodeBc3( const unsigned char block[16][4], unsigned char *out ) {
+		int a0 = 0;
+		int a1 = 255;
+		for ( int i = 0; i < 16; i++ ) {
+			a0 = max( a0, (int)block[i][3] );
+			a1 = min( a1, (int)block[i][3] );
+		}
+		int palette[8];
+		palette[0] = a0;
+		palette[1] = a1;
+		for ( int j = 1; j < 7; j++ ) {
+			palette[ j + 1 ] = ( ( 7 - j ) * a0 + j * a1 ) / 7;
+		}
+		unsigned char bits[6] = { 0, 0, 0, 0, 0, 0 };
+		if ( a0 != a1 ) {
+			for ( int i = 0; i < 16; i++ ) {
+				int best = 0;
+				int bestDist = 256;
+				for ( int j = 0; j < 8; j++ ) {
+					int d = abs( palette[j] - block[i][3] );
+					if ( d < bestDist ) {
+						bestDist = d;
+						best = j;
+					}
+				}
+				int bit = i * 3;
+				bits[ bit / 8 ] |= ( best << ( bit % 8 ) ) & 0xff;
+				if ( bit % 8 > 5 ) {
+					bits[ bit / 8 + 1 ] |= best >> ( 8 - bit % 8 );
+				}
+			}
+		}
+		out[0] = (unsigned char)a0;
+		out[1] = (unsigned char)a1;
+		memcpy( out + 2, bits, 6 );
+		EncodeBc1( block, out + 8 );
+	}
+	
+	const int etcModifier[8][2] = {
+		{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+	};
+	
+	int Clamp255( int v ) {
+		return v < 0 ? 0 : ( v > 255 ? 255 : v );
+	}
+	
+	// One half of an ETC1 block in individual mode: a 4-bit base color and
+	// the modifier table with the least error.  Returns the error, and the
+	// pixel indexes in ETC1's order ( +a, +b, -a, -b ).
+	int EncodeEtc1Half( const unsigned char block[16][4], const int pixel[8], unsigned int base[3], unsigned int & table, int index[8] ) {
+		int avg[3] = { 0, 0, 0 };
+		for ( int i = 0; i < 8; i++ ) {
+			for ( int c = 0; c < 3; c++ ) {
+				avg[c] += block[ pixel[i] ][c];
+			}
+		}
+		int color[3];
+		for ( int c = 0; c < 3; c++ ) {
+			base[c] = min( 15, ( avg[c] / 8 * 15 + 127 ) / 255 );
+			color[c] = base[c] * 17;
+		}
+		int bestError = 0x7fffffff;
+		for ( int t = 0; t < 8; t++ ) {
+			int mod[4] = { etcModifier[t][0], etcModifier[t][1], -etcModifier[t][0], -etcModifier[t][1] };
+			int error = 0;
+			int idx[8];
+			for ( int i = 0; i < 8; i++ ) {
+				int best = 0x7fffffff;
+				for ( int m = 0; m < 4; m++ ) {
+					int c[3] = { Clamp255( color[0] + mod[m] ), Clamp255( color[1] + mod[m] ), Clamp255( color[2] + mod[m] ) };
+					int d = ColorDistance( c, block[ pixel[i] ] );
+					if ( d < best ) {
+						best = d;
+						idx[i] = m;
+					}
+				}
+				error += best;
+			}
+			if ( error < bestError ) {
+				bestError = error;
+				table = t;
+				memcpy( index, idx, sizeof( idx ) );
+			}
+		}
+		return bestError;
+	}
+	
+	// ETC1 block in individual mode, whichever of the two splits fits better
+	void EncodeEtc1( const unsigned char block[16][4], unsigned char *out ) {
+		unsigned int bestHi = 0;
+		unsigned int bestLo = 0;
+		int bestError = 0x7fffffff;
+		for ( int flip = 0; flip < 2; flip++ ) {
+			unsigned int hi = flip;
+			unsigned int lo = 0;
+			int error = 0;
+			for ( int half = 0; half < 2; half++ ) {
+				int pixel[8];
+				int n = 0;
+				for ( int y = 0; y < 4; y++ ) {
+					for ( int x = 0; x < 4; x++ ) {
+						if ( ( flip ? y : x ) / 2 == half ) {
+							pixel[ n++ ] = y * 4 + x;
+						}
+					}
+				}
+				unsigned int base[3];
+				unsigned int table = 0;
+				int index[8];
+				error += EncodeEtc1Half( block, pixel, base, table, index );
+				int shift = half ? 0 : 4;
+				hi |= base[0] << ( 24 + shift ) | base[1] << ( 16 + shift ) | base[2] << ( 8 + shift );
+				hi |= table << ( half ? 2 : 5 );
+				// pixel indexes are stored column major, msb and lsb in separate halves
+				for ( int i = 0; i < 8; i++ ) {
+					int x = pixel[i] % 4;
+					int y = pixel[i] / 4;
+					int bit = x * 4 + y;
+					lo |= ( ( index[i] >> 1 ) & 1u ) << ( bit + 16 ) | ( index[i] & 1u ) << bit;
+				}
+			}
+			if ( error < bestError ) {
+				bestError = error;
+				bestHi = hi;
+				bestLo = lo;
+			}
+		}
+		for ( int i = 0; i < 4; i++ ) {
+			out[i] = ( bestHi >> ( 24 - i * 8 ) ) & 0xff;
+			out[ 4 + i ] = ( bestLo >> ( 24 - i * 8 ) ) & 0xff;
+		}
+	}
+	
+	void EncodeLevel( const Pixels & p, CompressedFormatEnum f, CompressedLevel & level ) {
+		int bw = ( p.width + 3 ) / 4;
+		int bh = ( p.height + 3 ) / 4;
+		int blockBytes = f == CompressedFormat_BC3 ? 16 : 8;
+		level.width = p.width;
+		level.height = p.height;
+		level.data.resize( bw * bh * blockBytes );
+		unsigned char block[16][4];
+		unsigned char *out = &level.data[0];
+		for ( int by = 0; by < bh; by++ ) {
+			for ( int bx = 0; bx < bw; bx++ ) {
+				GetBlock( p, bx, by, block );
+				switch( f ) {
+					case CompressedFormat_ETC1: EncodeEtc1( block, out ); break;
+					case CompressedFormat_BC3: EncodeBc3( block, out ); break;
+					default: EncodeBc1( block, out ); break;
+				}
+				out += blockBytes;
+			}
+		}
+	}
+	
+	// KTX 1.1, with the cache key as the one key/value pair
+	const unsigned char ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	const char *ktxSourceKey = "star3map.source";
+	
+	enum KtxHeaderEnum {
+		Ktx_Endianness,
+		Ktx_GlType,
+		Ktx_GlTypeSize,
+		Ktx_GlFormat,
+		Ktx_GlInternalFormat,
+		Ktx_GlBaseInternalFormat,
+		Ktx_PixelWidth,
+		Ktx_PixelHeight,
+		Ktx_PixelDepth,
+		Ktx_NumberOfArrayElements,
+		Ktx_NumberOfFaces,
+		Ktx_NumberOfMipmapLevels,
+		Ktx_BytesOfKeyValueData,
+		Ktx_HeaderWords
+	};
+	
+	string CacheFilename( const string & name ) {
+		return "texcache_" + name + ".ktx";
+	}
+	
+	// The sources are small next to decoding them, so hashing the contents
+	// is cheap, and catches edits that keep the size.
+	string CacheKey( const string & src, CompressedFormatEnum f ) {
+		vector< unsigned char > data;
+		FileReadToMemory( src, data );
+		unsigned int hash = 2166136261u;
+		for ( int i = 0; i < (int)data.size(); i++ ) {
+			hash = ( hash ^ data[i] ) * 16777619u;
+		}
+		char buf[32];
+		r3Sprintf( buf, " %d %08x ", (int)data.size(), hash );
+		return src + buf + FormatName( f );
+	}
+	
+	void Append( vector< unsigned char > & buf, const void *data, int size ) {
+		const unsigned char *d = static_cast< const unsigned char * >( data );
+		buf.insert( buf.end(), d, d + size );
+	}
+	
+	void AppendWord( vector< unsigned char > & buf, unsigned int w ) {
+		Append( buf, &w, 4 );
+	}
+	
+	unsigned int ReadWord( const vector< unsigned char > & buf, size_t offset ) {
+		unsigned int w;
+		memcpy( &w, &buf[ offset ], 4 );
+		return w;
+	}
+	
+}
+
+namespace star3map {
+	
+	CompressedFormatEnum CompressedFormatFromString( const string & s ) {
+		if ( s == "COMPRESSED" ) {
+			return CompressedFormat_Auto;
+		} else if ( s == "ETC1" ) {
+			return CompressedFormat_ETC1;
+		} else if ( s == "BC1" ) {
+			return CompressedFormat_BC1;
+		} else if ( s == "BC3" ) {
+			return CompressedFormat_BC3;
+		}
+		return CompressedFormat_None;
+	}
+	
+	void InitializeTextureCache() {
+		const char *extensions = (const char *)glGetString( GL_EXTENSIONS );
+		const char *version = (const char *)glGetString( GL_VERSION );
+		// ETC2 decoders read ETC1 blocks unchanged
+		if ( HasExtension( extensions, "GL_OES_compressed_ETC1_RGB8_texture" ) ) {
+			etc1Format = GL_ETC1_RGB8_OES;
+		} else if ( ( version && strncmp( version, "OpenGL ES 3", 11 ) == 0 ) || HasExtension( extensions, "GL_ARB_ES3_compatibility" ) ) {
+			etc1Format = GL_COMPRESSED_RGB8_ETC2;
+		}
+		if ( HasExtension( extensions, "GL_EXT_texture_compression_s3tc" ) ) {
+			bc1Format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			bc3Format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		} else if ( HasExtension( extensions, "GL_EXT_texture_compression_dxt1" ) ) {
+			bc1Format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		}
+		Output( "Texture cache: ETC1 %s, BC1 %s, BC3 %s", etc1Format ? "yes" : "no", bc1Format ? "yes" : "no", bc3Format ? "yes" : "no" );
+	}
+	
+	bool CompressImage( const unsigned char *pixels, int width, int height, int components, CompressedFormatEnum f, CompressedImage & out ) {
+		f = Resolve( f, components );
+		if ( f == CompressedFormat_None || pixels == NULL || ! IsPowerOfTwo( width ) || ! IsPowerOfTwo( height ) ) {
+			return false;
+		}
+		out.internalFormat = InternalFormat( f );
+		out.levels.clear();
+		Pixels level[2];
+		Expand( pixels, width, height, components, level[0] );
+		for ( int i = 0; ; i++ ) {
+			Pixels & p = level[ i & 1 ];
+			out.levels.push_back( CompressedLevel() );
+			EncodeLevel( p, f, out.levels.back() );
+			if ( p.width == 1 && p.height == 1 ) {
+				break;
+			}
+			Downsample( p, level[ ( i + 1 ) & 1 ] );
+		}
+		return true;
+	}
+	
+	string TextureCacheKey( const string & src, CompressedFormatEnum f ) {
+		return CacheKey( src, f );
+	}
+	
+	bool ReadTextureCache( const string & name, const string & src, CompressedFormatEnum f, CompressedImage & out ) {
+		return ReadTextureCache( name, CacheKey( src, f ), out );
+	}
+	
+	void WriteTextureCache( const string & name, const string & src, CompressedFormatEnum f, const CompressedImage & img ) {
+		WriteTextureCache( name, CacheKey( src, f ), img );
+	}
+	
+	bool ReadTextureCache( const string & name, const string & key, CompressedImage & out ) {
+		vector< unsigned char > buf;
+		if ( FileReadToMemory( CacheFilename( name ), buf ) == false ) {
+			return false;
+		}
+		size_t headerSize = sizeof( ktxIdentifier ) + Ktx_HeaderWords * 4;
+		if ( buf.size() < headerSize || memcmp( &buf[0], ktxIdentifier, sizeof( ktxIdentifier ) ) != 0 ) {
+			return false;
+		}
+		unsigned int h[ Ktx_HeaderWords ];
+		for ( int i = 0; i < Ktx_HeaderWords; i++ ) {
+			h[i] = ReadWord( buf, sizeof( ktxIdentifier ) + i * 4 );
+		}
+		GLenum fmt = h[ Ktx_GlInternalFormat ];
+		bool supported = fmt != 0 && ( fmt == etc1Format || fmt == bc1Format || fmt == bc3Format );
+		if ( h[ Ktx_Endianness ] != 0x04030201 || h[ Ktx_NumberOfFaces ] != 1 || supported == false ) {
+			return false;
+		}
+		size_t offset = headerSize;
+		size_t kvEnd = offset + h[ Ktx_BytesOfKeyValueData ];
+		if ( kvEnd > buf.size() || offset + 4 > kvEnd ) {
+			return false;
+		}
+		// the source key has to match, or the source or format changed
+		unsigned int kvSize = ReadWord( buf, offset );
+		string kv( (const char *)&buf[ offset + 4 ], min( (size_t)kvSize, kvEnd - offset - 4 ) );
+		if ( kv != string( ktxSourceKey ) + '\0' + key + '\0' ) {
+			return false;
+		}
+		offset = kvEnd;
+		CompressedImage img;
+		img.internalFormat = fmt;
+		img.levels.resize( h[ Ktx_NumberOfMipmapLevels ] );
+		int w = h[ Ktx_PixelWidth ];
+		int ht = h[ Ktx_PixelHeight ];
+		for ( int i = 0; i < (int)img.levels.size(); i++ ) {
+			if ( offset + 4 > buf.size() ) {
+				return false;
+			}
+			unsigned int size = ReadWord( buf, offset );
+			offset += 4;
+			if ( offset + size > buf.size() ) {
+				return false;
+			}
+			CompressedLevel & l = img.levels[i];
+			l.width = w;
+			l.height = ht;
+			l.data.assign( buf.begin() + offset, buf.begin() + offset + size );
+			offset += ( size + 3 ) & ~3;
+			w = max( 1, w / 2 );
+			ht = max( 1, ht / 2 );
+		}
+		if ( img.levels.size() == 0 ) {
+			return false;
+		}
+		out.internalFormat = img.internalFormat;
+		out.levels.swap( img.levels );
+		return true;
+	}
+	
+	void WriteTextureCache( const string & name, const string & key, const CompressedImage & img ) {
+		if ( img.levels.size() == 0 ) {
+			return;
+		}
+		string kv = string( ktxSourceKey ) + '\0' + key + '\0';
+		unsigned int kvSize = (unsigned int)kv.size();
+		unsigned int kvPadded = ( kvSize + 3 ) & ~3;
+		
+		vector< unsigned char > buf;
+		Append( buf, ktxIdentifier, sizeof( ktxIdentifier ) );
+		unsigned int h[ Ktx_HeaderWords ];
+		memset( h, 0, sizeof( h ) );
+		h[ Ktx_Endianness ] = 0x04030201;
+		h[ Ktx_GlTypeSize ] = 1;
+		h[ Ktx_GlInternalFormat ] = img.internalFormat;
+		h[ Ktx_GlBaseInternalFormat ] = img.internalFormat == bc3Format ? GL_RGBA : GL_RGB;
+		h[ Ktx_PixelWidth ] = img.levels[0].width;
+		h[ Ktx_PixelHeight ] = img.levels[0].height;
+		h[ Ktx_NumberOfFaces ] = 1;
+		h[ Ktx_NumberOfMipmapLevels ] = (unsigned int)img.levels.size();
+		h[ Ktx_BytesOfKeyValueData ] = 4 + kvPadded;
+		for ( int i = 0; i < Ktx_HeaderWords; i++ ) {
+			AppendWord( buf, h[i] );
+		}
+		AppendWord( buf, kvSize );
+		Append( buf, kv.c_str(), kvSize );
+		buf.resize( buf.size() + kvPadded - kvSize, 0 );
+		for ( int i = 0; i < (int)img.levels.size(); i++ ) {
+			const vector< unsigned char > & d = img.levels[i].data;
+			AppendWord( buf, (unsigned int)d.size() );
+			Append( buf, &d[0], (int)d.size() );
+			buf.resize( ( buf.size() + 3 ) & ~3, 0 );
+		}
+		
+		File *file = FileOpenForWrite( CacheFilename( name ) );
+		if ( file == NULL ) {
+			Output( "Texture cache: unable to write %s", CacheFilename( name ).c_str() );
+			return;
+		}
+		file->Write( &buf[0], 1, (int)buf.size() );
+		delete file;
+	}
+	
+	Texture2D * CreateCompressedTexture2D( const string & name, const CompressedImage & img ) {
+		const CompressedLevel & base = img.levels[0];
+		Texture2D * t = CreateTexture2D( name, TextureFormat_RGBA, base.width, base.height );
+		// respecify the storage r3 allocated, every level, so the mips never get regenerated
+		for ( int i = 0; i < (int)img.levels.size(); i++ ) {
+			const CompressedLevel & l = img.levels[i];
+			glCompressedTextureImage2DEXT( t->Object(), GL_TEXTURE_2D, i, img.internalFormat, l.width, l.height, 0, (GLsizei)l.data.size(), &l.data[0] );
+		}
+		return t;
+	}
+	
+}
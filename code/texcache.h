@@ -0,0 +1,102 @@
+/*
+ *  texcache
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_TEXCACHE_H__
+#define __STAR3MAP_TEXCACHE_H__
+
+#include "r3/texture.h"
+
+#include <string>
+#include <vector>
+
+namespace star3map {
+
+	// GPU-native texture formats that config.json textures can opt into with
+	// "format".  Auto picks whatever the driver takes for the image's channels.
+	enum CompressedFormatEnum {
+		CompressedFormat_None,
+		CompressedFormat_Auto,
+		CompressedFormat_ETC1,  // RGB, also uploaded as ETC2 on ES3 drivers
+		CompressedFormat_BC1,   // RGB
+		CompressedFormat_BC3    // RGBA
+	};
+	
+	// "COMPRESSED", "ETC1", "BC1" or "BC3", anything else is None
+	CompressedFormatEnum CompressedFormatFromString( const std::string & s );
+	
+	struct CompressedLevel {
+		int width;
+		int height;
+		std::vector< unsigned char > data;
+	};
+	
+	struct CompressedImage {
+		unsigned int internalFormat;
+		std::vector< CompressedLevel > levels;  // the full mip chain
+	};
+	
+	// Checks the driver's formats.  Call on the context thread before any of
+	// the others, which are then safe on any thread.
+	void InitializeTextureCache();
+	
+	// Encodes pixels and a mip chain down to 1x1.  Fails if the format isn't
+	// supported, doesn't fit the channels, or the size isn't a power of two.
+	bool CompressImage( const unsigned char *pixels, int width, int height, int components, CompressedFormatEnum f, CompressedImage & out );
+	
+	// The cache is a texcache_<name>.ktx file per texture, keyed on the
+	// source file's name, size and content hash and the requested format, so
+	// a changed source or format is transcoded again.
+	bool ReadTextureCache( const std::string & name, const std::string & src, CompressedFormatEnum f, CompressedImage & out );
+	void WriteTextureCache( const std::string & name, const std::string & src, CompressedFormatEnum f, const CompressedImage & img );
+	
+	// The same, for images built from several sources, like atlas pages,
+	// with a key made from TextureCacheKey() of each.
+	std::string TextureCacheKey( const std::string & src, CompressedFormatEnum f );
+	bool ReadTextureCache( const std::string & name, const std::string & key, CompressedImage & out );
+	void WriteTextureCache( const std::string & name, const std::string & key, const CompressedImage & img );
+	
+	// context thread only
+	r3::Texture2D * CreateCompressedTexture2D( const std::string & name, const CompressedImage & img );
+	
+}
+
+#endif //__STAR3MAP_TEXCACHE_H__
@@ -0,0 +1,473 @@
+/*
+ *  texmanager
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "texmanager.h"
+#include "profile.h"
+
+#include "r3/command.h"
+#include "r3/gfxcontext.h"
+#include "r3/output.h"
+#include "r3/thread.h"
+#include "r3/time.h"
+#include "r3/var.h"
+
+#include <GL/Regal.h>
+
+#include <algorithm>
+#include <map>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+// The globe's two cube maps are about 8 MB each, so the default holds them
+// with the atlases and qr code to spare.
+VarInteger app_textureBudgetKB( "app_textureBudgetKB", "texture memory kept resident before the least recently used textures are evicted", 0, 32768 );
+VarInteger app_textureKeepFrames( "app_textureKeepFrames", "textures used within this many frames are never evicted", 0, 300 );
+
+namespace {
+	
+	struct Entry {
+		Entry() : declared( false ), failed( false ), loading( false ), texture( NULL ), bytes( 0 ), refs( 0 ), lastUse( 0 ) {}
+		TextureDesc desc;
+		bool declared;   // adopted textures can't be reloaded
+		bool failed;     // so a missing file isn't retried every frame
+		bool loading;    // queued for, or being decoded by, the loader thread
+		Texture * texture;
+		int bytes;
+		int refs;
+		int lastUse;     // frame number
+	};
+	
+	// the initializer thread uploads while the render thread draws the splash
+	r3::Mutex texMutex;
+	map< string, Entry > entries;
+	int frame = 1;
+	int residentBytes;
+	
+	// On demand loads are decoded on a loader thread, which runs while there
+	// are requests, and uploaded by the next Use() on the context thread.
+	// r3 only decodes a cube map as it creates it, so those are created on
+	// the loader thread when there's a shared context for it, and otherwise
+	// on the context thread, though still outside texMutex.
+	struct TextureLoader;
+	vector< string > requests;
+	map< string, TextureLoad * > decoded;
+	TextureLoader * loader;
+	bool loaderRunning;
+	GfxContext * loadContext;
+	map< string, pair< Texture *, int > > created;  // by the loader, with their bytes
+	
+	int BytesPerPixel( TextureFormatEnum f ) {
+		switch( f ) {
+			case TextureFormat_L: return 1;
+			case TextureFormat_LA: return 2;
+			default: return 4;  // RGB is usually padded out
+		}
+	}
+	
+	// with a third more for mipmaps
+	int EstimateBytes( Texture * t ) {
+		int pixels = 0;
+		if ( t->Target() == TextureTarget_Cube ) {
+			TextureCube * c = static_cast< TextureCube * >( t );
+			pixels = 6 * c->Width() * c->Height();
+		} else {
+			Texture2D * t2 = static_cast< Texture2D * >( t );
+			pixels = t2->PaddedWidth() * t2->PaddedHeight();
+		}
+		return pixels * BytesPerPixel( t->Format() ) * 4 / 3;
+	}
+	
+	r3::TextureFormatEnum ImageFormat( Image * img ) {
+		switch( img->Components() ) {
+			case 1: return TextureFormat_L;
+			case 2: return TextureFormat_LA;
+			case 3: return TextureFormat_RGB;
+			default: return TextureFormat_RGBA;
+		}
+	}
+	
+	void MakeResident( Entry & e, Texture * t, int bytes ) {
+		e.texture = t;
+		e.bytes = bytes;
+		e.lastUse = frame;
+		residentBytes += bytes;
+	}
+	
+	void Evict( Entry & e ) {
+		delete e.texture;
+		e.texture = NULL;
+		residentBytes -= e.bytes;
+		e.bytes = 0;
+	}
+	
+	// Makes the GL texture for a decoded load, on a thread with a context.
+	// Doesn't touch the entries, so it needs no lock.
+	Texture * CreateTexture( TextureLoad & load, int & bytes ) {
+		const TextureDesc & d = load.desc;
+		Texture * t = NULL;
+		bytes = 0;
+		switch( d.target ) {
+			case TextureTarget_Cube:
+				t = CreateTextureCubeFromFile( d.src, d.format );
+				break;
+			case TextureTarget_2D:
+			default:
+				if ( load.compressed.levels.size() > 0 ) {
+					t = CreateCompressedTexture2D( d.name, load.compressed );
+					for ( int i = 0; i < (int)load.compressed.levels.size(); i++ ) {
+						bytes += (int)load.compressed.levels[i].data.size();
+					}
+					load.compressed.levels.clear();
+				} else if ( load.image ) {
+					Image * img = load.image;
+					Texture2D * t2 = CreateTexture2D( d.name, d.format, img->Width(), img->Height() );
+					t2->SetImage( 0, ImageFormat( img ), img->Width(), img->Height(), img->Data() );
+					t = t2;
+					delete img;
+					load.image = NULL;
+				} else {
+					// the decode failed, so leave the error handling to r3 as before
+					t = CreateTexture2DFromFile( d.src, d.format );
+				}
+				break;
+		}
+		if ( t && d.clampToEdge ) {
+			if ( d.target == TextureTarget_Cube ) {
+				glTextureParameteriEXT( t->Object(), GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+				glTextureParameteriEXT( t->Object(), GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+			} else {
+				t->ClampToEdge();
+			}
+		}
+		if ( t && bytes == 0 ) {
+			bytes = EstimateBytes( t );
+		}
+		return t;
+	}
+	
+	// call with texMutex held
+	void Install( const string & name, Texture * t, int bytes ) {
+		Entry & e = entries[ name ];
+		e.loading = false;
+		if ( e.texture ) {
+			// already loaded another way, and possibly held by pointer
+			delete t;
+			return;
+		}
+		if ( t == NULL ) {
+			e.failed = true;
+			Output( "Failed to load texture %s", name.c_str() );
+			return;
+		}
+		MakeResident( e, t, bytes );
+		Output( "Loaded texture %s, %d KB resident", name.c_str(), residentBytes / 1024 );
+	}
+	
+	struct TextureLoader : public r3::Thread {
+		TextureLoader() : r3::Thread( "TextureLoader" ) {
+		}
+		void Run() {
+			ProfileSetThreadName( "TextureLoader" );
+			while( 1 ) {
+				TextureLoad * load = new TextureLoad;
+				load->image = NULL;
+				GfxContext * ctx;
+				{
+					ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+					if ( requests.size() == 0 ) {
+						// RequestLoad() starts another once this is done
+						loaderRunning = false;
+						delete load;
+						return;
+					}
+					load->desc = entries[ requests[0] ].desc;
+					requests.erase( requests.begin() );
+					ctx = loadContext;
+				}
+				PROFILE_ZONE( "DecodeTextureOnDemand" );
+				if ( load->desc.target == TextureTarget_2D ) {
+					DecodeTexture( *load );
+					ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+					decoded[ load->desc.name ] = load;
+					continue;
+				}
+				ctx->Acquire();
+				int bytes;
+				Texture * t = CreateTexture( *load, bytes );
+				ctx->Finish();
+				ctx->Release();
+				ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+				created[ load->desc.name ] = make_pair( t, bytes );
+				delete load;
+			}
+		}
+	};
+	
+	// call with texMutex held
+	void RequestLoad( Entry & e ) {
+		e.loading = true;
+		requests.push_back( e.desc.name );
+		if ( loaderRunning ) {
+			return;
+		}
+		if ( loader ) {
+			// it has already left Run(), or loaderRunning would be set
+			loader->Join();
+			delete loader;
+		}
+		loader = new TextureLoader;
+		loaderRunning = true;
+		loader->Start();
+	}
+	
+	// Finds or starts the load of a texture that isn't resident.  Returns a
+	// decoded load for the caller to upload, outside texMutex, or NULL if
+	// there's nothing to upload yet.  Call with texMutex held.
+	TextureLoad * Load( Entry & e, bool wait ) {
+		const string & name = e.desc.name;
+		map< string, pair< Texture *, int > >::iterator c = created.find( name );
+		if ( c != created.end() ) {
+			Install( name, c->second.first, c->second.second );
+			created.erase( c );
+			return NULL;
+		}
+		map< string, TextureLoad * >::iterator d = decoded.find( name );
+		if ( d != decoded.end() ) {
+			TextureLoad * load = d->second;
+			decoded.erase( d );
+			return load;
+		}
+		bool background = e.desc.target == TextureTarget_2D || loadContext != NULL;
+		if ( e.loading || ( background && wait == false ) ) {
+			if ( e.loading == false ) {
+				RequestLoad( e );
+			}
+			return NULL;
+		}
+		// the caller decodes it, unlocked
+		e.loading = true;
+		TextureLoad * load = new TextureLoad;
+		load->desc = e.desc;
+		load->image = NULL;
+		return load;
+	}
+	
+	// The resident texture, or NULL while it loads.  With wait, the load
+	// happens now, on this thread, or it waits for the loader's.
+	Texture * Use( const string & name, bool wait, bool pin ) {
+		TextureLoad * load = NULL;
+		while( load == NULL ) {
+			{
+				ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+				map< string, Entry >::iterator it = entries.find( name );
+				if ( it == entries.end() ) {
+					return NULL;
+				}
+				Entry & e = it->second;
+				e.lastUse = frame;
+				if ( e.texture == NULL && e.declared && e.failed == false ) {
+					load = Load( e, wait );
+				}
+				if ( load == NULL && ( wait == false || e.loading == false ) ) {
+					if ( e.texture && pin ) {
+						e.refs++;
+					}
+					return e.texture;
+				}
+			}
+			if ( load == NULL ) {
+				SleepMilliseconds( 1 );
+			}
+		}
+		
+		PROFILE_ZONE( "LoadTextureOnDemand" );
+		if ( load->image == NULL && load->compressed.levels.size() == 0 ) {
+			DecodeTexture( *load );
+		}
+		int bytes;
+		Texture * t = CreateTexture( *load, bytes );
+		delete load;
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		Install( name, t, bytes );
+		Entry & e = entries[ name ];
+		e.lastUse = frame;
+		if ( e.texture && pin ) {
+			e.refs++;
+		}
+		return e.texture;
+	}
+	
+	void TextureReport( const vector< Token > & tokens ) {
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		Output( "textureReport: %d KB resident of %d KB budget", residentBytes / 1024, app_textureBudgetKB.GetVal() );
+		for ( map< string, Entry >::iterator it = entries.begin(); it != entries.end(); ++it ) {
+			Entry & e = it->second;
+			Output( "  %-12s %6d KB  %s%s  last used %d frames ago", it->first.c_str(), e.bytes / 1024,
+				   e.texture ? "resident" : "evicted ", e.refs ? ", pinned" : "", frame - e.lastUse );
+		}
+	}
+	CommandFunc TextureReportCmd( "textureReport", "list textures with their size and residency", TextureReport );
+	
+}
+
+namespace star3map {
+	
+	void DeclareTexture( const TextureDesc & desc ) {
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		Entry & e = entries[ desc.name ];
+		e.desc = desc;
+		e.declared = true;
+		e.failed = false;
+	}
+	
+	void DecodeTexture( TextureLoad & load ) {
+		const TextureDesc & d = load.desc;
+		// r3 can't build a cube map from decoded pixels, so those are read
+		// and decoded whole by CreateTextureCubeFromFile in the upload
+		if ( d.target == TextureTarget_2D ) {
+			if ( d.compress != CompressedFormat_None && ReadTextureCache( d.name, d.src, d.compress, load.compressed ) ) {
+				return;
+			}
+			load.image = ReadImageFile( d.src );
+			Image * img = load.image;
+			if ( img && d.compress != CompressedFormat_None &&
+				CompressImage( img->Data(), img->Width(), img->Height(), img->Components(), d.compress, load.compressed ) ) {
+				Output( "Transcoded texture %s", d.name.c_str() );
+				WriteTextureCache( d.name, d.src, d.compress, load.compressed );
+				delete img;
+				load.image = NULL;
+			}
+		}
+	}
+	
+	void UploadTexture( TextureLoad & load ) {
+		{
+			ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+			if ( entries[ load.desc.name ].texture ) {
+				// already loaded on demand
+				delete load.image;
+				load.image = NULL;
+				load.compressed.levels.clear();
+				return;
+			}
+		}
+		// cube maps decode in here, so keep texMutex free for the render thread
+		int bytes;
+		Texture * t = CreateTexture( load, bytes );
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		Install( load.desc.name, t, bytes );
+	}
+	
+	void AdoptTexture( const string & name, Texture * texture ) {
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		Entry & e = entries[ name ];
+		if ( e.texture ) {
+			Evict( e );
+		}
+		e.declared = false;
+		MakeResident( e, texture, EstimateBytes( texture ) );
+	}
+	
+	Texture * UseTexture( const string & name ) {
+		return Use( name, false, false );
+	}
+	
+	Texture * PinTexture( const string & name ) {
+		return Use( name, true, true );
+	}
+	
+	void PrefetchTexture( const string & name ) {
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		map< string, Entry >::iterator it = entries.find( name );
+		if ( it == entries.end() ) {
+			return;
+		}
+		Entry & e = it->second;
+		bool background = e.desc.target == TextureTarget_2D || loadContext != NULL;
+		if ( e.texture == NULL && e.declared && e.failed == false && e.loading == false && background ) {
+			RequestLoad( e );
+		}
+	}
+	
+	void SetTextureLoadContext( GfxContext * ctx ) {
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		loadContext = ctx;
+	}
+	
+	void ReleaseTexture( const string & name ) {
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		map< string, Entry >::iterator it = entries.find( name );
+		if ( it != entries.end() && it->second.refs == 0 && it->second.texture ) {
+			Evict( it->second );
+		}
+	}
+	
+	void TrimTextures() {
+		ProfiledScopedMutex scmutex( texMutex, R3_LOC );
+		int budget = app_textureBudgetKB.GetVal() * 1024;
+		// nor anything used recently, so toggling views back and forth
+		// doesn't reload the same textures each time
+		int keepAfter = frame - max( app_textureKeepFrames.GetVal(), 0 );
+		while( residentBytes > budget ) {
+			// least recently used first, and never one used this frame
+			Entry * lru = NULL;
+			for ( map< string, Entry >::iterator it = entries.begin(); it != entries.end(); ++it ) {
+				Entry & e = it->second;
+				if ( e.texture == NULL || e.declared == false || e.refs > 0 || e.lastUse >= frame || e.lastUse > keepAfter ) {
+					continue;
+				}
+				if ( lru == NULL || e.lastUse < lru->lastUse ) {
+					lru = &e;
+				}
+			}
+			if ( lru == NULL ) {
+				break;
+			}
+			Output( "Evicting texture %s, %d KB", lru->desc.name.c_str(), lru->bytes / 1024 );
+			Evict( *lru );
+		}
+		frame++;
+	}
+	
+}
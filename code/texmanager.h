@@ -0,0 +1,113 @@
+/*
+ *  texmanager
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_TEXMANAGER_H__
+#define __STAR3MAP_TEXMANAGER_H__
+
+#include "texcache.h"
+
+#include "r3/gfxcontext.h"
+#include "r3/image.h"
+#include "r3/texture.h"
+
+#include <string>
+
+namespace star3map {
+	
+	// Textures by name.  Declared ones are loaded on first use, and the least
+	// recently used are evicted once the resident ones pass
+	// app_textureBudgetKB, so what stays resident follows what the current
+	// view draws.  All of these are for the context thread, except
+	// DecodeTexture() and PrefetchTexture().
+	
+	struct TextureDesc {
+		std::string name;
+		std::string src;
+		r3::TextureFormatEnum format;
+		r3::TextureTargetEnum target;
+		CompressedFormatEnum compress;
+		bool clampToEdge;
+	};
+	
+	// A load split in two, so the decode can happen on a loader thread.
+	struct TextureLoad {
+		TextureDesc desc;
+		r3::Image * image;
+		CompressedImage compressed;
+	};
+	
+	void DeclareTexture( const TextureDesc & desc );
+	
+	// decodes, or reads from the texture cache, on any thread
+	void DecodeTexture( TextureLoad & load );
+	// makes the decoded texture resident
+	void UploadTexture( TextureLoad & load );
+	
+	// Takes ownership of a texture that was loaded elsewhere.  It can't be
+	// reloaded, so it stays resident until released.
+	void AdoptTexture( const std::string & name, r3::Texture * texture );
+	
+	// The resident texture, kept for at least this frame.  One that isn't
+	// resident is loaded in the background, and this is NULL until it's
+	// ready, or if it can't be loaded.
+	r3::Texture * UseTexture( const std::string & name );
+	
+	// For textures held by pointer, like the button icons, which are then
+	// never evicted.  Waits for the load.
+	r3::Texture * PinTexture( const std::string & name );
+	
+	// starts loading a texture that's about to be used, e.g. on a view change
+	void PrefetchTexture( const std::string & name );
+	
+	// A context shared with the draw context, for creating cube maps off the
+	// context thread.  Without one they're created in UseTexture().
+	void SetTextureLoadContext( r3::GfxContext * ctx );
+	
+	// deletes the texture now, if it isn't pinned
+	void ReleaseTexture( const std::string & name );
+	
+	// call once a frame, after drawing
+	void TrimTextures();
+	
+}
+
+#endif //__STAR3MAP_TEXMANAGER_H__
@@ -0,0 +1,263 @@
+/*
+ *  textbatch
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#include "textbatch.h"
+#include "render.h"
+#include "log.h"
+#include "profile.h"
+
+#include "r3/shader.h"
+
+#include <GL/Regal.h>
+
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+using namespace star3map;
+using namespace r3;
+
+namespace {
+	
+	Shader *textShader;
+	
+	Shader * GetTextShader() {
+		if ( textShader == NULL ) {
+			Shader * s = textShader = CreateShaderFromFile( "text" );
+			glBindAttribLocation( s->pgObject, AL_Position, "Vertex" );
+			glBindAttribLocation( s->pgObject, AL_Color, "Color" );
+			glBindAttribLocation( s->pgObject, AL_TexCoord + 0, "TexCoord0" );
+			glLinkProgram( s->pgObject );
+		}
+		return textShader;
+	}
+	
+	// returns the next code point, or -1 at the end of the string
+	int NextCodepoint( const string & s, size_t & i ) {
+		if ( i >= s.size() ) {
+			return -1;
+		}
+		unsigned char c = s[ i++ ];
+		int extra = 0;
+		int cp = c;
+		if ( c >= 0xf0 ) {
+			cp = c & 0x07; extra = 3;
+		} else if ( c >= 0xe0 ) {
+			cp = c & 0x0f; extra = 2;
+		} else if ( c >= 0xc0 ) {
+			cp = c & 0x1f; extra = 1;
+		}
+		while ( extra-- > 0 && i < s.size() && ( s[i] & 0xc0 ) == 0x80 ) {
+			cp = ( cp << 6 ) | ( s[ i++ ] & 0x3f );
+		}
+		return cp;
+	}
+	
+	unsigned int HashString( const string & s ) {
+		unsigned int h = 2166136261u;
+		for ( int i = 0; i < (int)s.size(); i++ ) {
+			h = ( h ^ (unsigned char)s[i] ) * 16777619u;
+		}
+		return h;
+	}
+	
+	unsigned char ToByte( float f ) {
+		return (unsigned char)( std::max( 0.f, std::min( 1.f, f ) ) * 255.f + 0.5f );
+	}
+	
+}
+
+namespace star3map {
+	
+	TextBatch::TextBatch( SdfFont *tbFont, float pixelHeight )
+	: font( tbFont ), unit( pixelHeight / tbFont->BakeSize() ), generation( tbFont->Generation() ), model( NULL ) {
+	}
+	
+	TextBatch::~TextBatch() {
+		delete model;
+	}
+	
+	Bounds2f TextBatch::GetStringDimensions( const string & s, float scale ) {
+		unsigned int h = HashString( s );
+		map< unsigned int, Width >::iterator it = widths.find( h );
+		float width = 0;
+		if ( it != widths.end() && it->second.s == s ) {
+			width = it->second.width;
+		} else {
+			size_t i = 0;
+			int cp;
+			while ( ( cp = NextCodepoint( s, i ) ) >= 0 ) {
+				width += font->Advance( cp ) * unit;
+			}
+			// on a collision the newer string takes the slot
+			Width & w = widths[ h ];
+			w.s = s;
+			w.width = width;
+		}
+		return Bounds2f( 0, font->Descent() * unit * scale, width * scale, font->Ascent() * unit * scale );
+	}
+	
+	void TextBatch::Emit( const Run & r, const SdfFont::Glyph & g, float pen ) {
+		float x0 = r.x + ( pen + g.box.Min().x ) * r.scale;
+		float x1 = r.x + ( pen + g.box.Max().x ) * r.scale;
+		float y0 = r.y + g.box.Min().y * r.scale;
+		float y1 = r.y + g.box.Max().y * r.scale;
+		Vec3f p00 = r.xf * Vec3f( x0, y0, 0 );
+		Vec3f p10 = r.xf * Vec3f( x1, y0, 0 );
+		Vec3f p11 = r.xf * Vec3f( x1, y1, 0 );
+		Vec3f p01 = r.xf * Vec3f( x0, y1, 0 );
+		// r.scale is pixels per baked pixel, so small text gets a wider edge
+		// in the field and large text a sharper one
+		float edge = std::min( 0.5f, 0.5f * font->FieldPerPixel() / std::max( r.scale, 0.001f ) );
+		Vert v;
+		memcpy( v.c, r.c, 4 );
+		v.pos = p00; v.tc = Vec3f( g.tc0.x, g.tc0.y, edge ); verts.push_back( v );
+		v.pos = p10; v.tc = Vec3f( g.tc1.x, g.tc0.y, edge ); verts.push_back( v );
+		v.pos = p11; v.tc = Vec3f( g.tc1.x, g.tc1.y, edge ); verts.push_back( v );
+		v.pos = p00; v.tc = Vec3f( g.tc0.x, g.tc0.y, edge ); verts.push_back( v );
+		v.pos = p11; v.tc = Vec3f( g.tc1.x, g.tc1.y, edge ); verts.push_back( v );
+		v.pos = p01; v.tc = Vec3f( g.tc0.x, g.tc1.y, edge ); verts.push_back( v );
+	}
+	
+	// The atlas filled and started over, so lay out everything queued again
+	// against the new one.  Fails, dropping the queue, if the glyphs queued
+	// don't fit in one atlas between them.
+	bool TextBatch::Requeue() {
+		generation = font->Generation();
+		verts.clear();
+		for ( int i = 0; i < (int)queued.size(); i++ ) {
+			const SdfFont::Glyph & g = font->GetGlyph( queued[i].codepoint );
+			if ( font->Generation() != generation ) {
+				break;
+			}
+			Emit( runs[ queued[i].run ], g, queued[i].pen );
+		}
+		if ( font->Generation() != generation ) {
+			LogOutput( R3_LOC, "TextBatch: %d queued glyphs don't fit in the atlas", (int)queued.size() );
+			generation = font->Generation();
+			runs.clear();
+			queued.clear();
+			verts.clear();
+			return false;
+		}
+		return true;
+	}
+	
+	void TextBatch::Add( const string & s, const Matrix4f & xf, float x, float y, float scale, const Vec4f & color ) {
+		if ( verts.size() == 0 ) {
+			generation = font->Generation();
+		} else if ( font->Generation() != generation ) {
+			// another batch filled the atlas since these were queued
+			Requeue();
+		}
+		runs.push_back( Run() );
+		Run & r = runs.back();
+		r.xf = xf;
+		r.x = x;
+		r.y = y;
+		r.scale = scale * unit;
+		r.c[0] = ToByte( color.x );
+		r.c[1] = ToByte( color.y );
+		r.c[2] = ToByte( color.z );
+		r.c[3] = ToByte( color.w );
+		int run = (int)runs.size() - 1;
+		float pen = 0;
+		size_t i = 0;
+		int cp;
+		while ( ( cp = NextCodepoint( s, i ) ) >= 0 ) {
+			const SdfFont::Glyph * g = & font->GetGlyph( cp );
+			if ( font->Generation() != generation ) {
+				if ( Requeue() == false ) {
+					return;
+				}
+				// baked into the new atlas just before the others went back in
+				g = & font->GetGlyph( cp );
+			}
+			if ( g->box.Width() > 0 ) {
+				Emit( runs[ run ], *g, pen );
+				QueuedGlyph q;
+				q.codepoint = cp;
+				q.run = run;
+				q.pen = pen;
+				queued.push_back( q );
+			}
+			pen += g->advance;
+		}
+	}
+	
+	void TextBatch::Draw() {
+		if ( verts.size() > 0 && font->Generation() != generation ) {
+			// another batch filled the atlas since these were queued
+			Requeue();
+		}
+		if ( verts.size() == 0 ) {
+			runs.clear();
+			queued.clear();
+			return;
+		}
+		PROFILE_ZONE( "TextBatch::Draw" );
+		if ( model == NULL ) {
+			model = new Model( "textBatch" );
+			int offset = 0;
+			model->AddAttributeArray( AttributeArray( AL_Position, 3, GL_FLOAT, GL_FALSE, sizeof( Vert ), offset ) );
+			offset += sizeof( Vec3f );
+			model->AddAttributeArray( AttributeArray( AL_Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof( Vert ), offset ) );
+			offset += 4;
+			model->AddAttributeArray( AttributeArray( AL_TexCoord + 0, 3, GL_FLOAT, GL_FALSE, sizeof( Vert ), offset ) );
+			model->SetPrimitive( GL_TRIANGLES );
+		}
+		model->GetVertexBuffer().SetData( (int)verts.size() * sizeof( Vert ), & verts[0] );
+		model->SetNumVertexes( (int)verts.size() );
+		ProfileCounter( "label glyphs", (float)Count() );
+		
+		Shader *s = GetTextShader();
+		glBindMultiTextureEXT( GL_TEXTURE0, GL_TEXTURE_2D, font->AtlasObject() );
+		glUseProgram( s->pgObject );
+		model->Draw();
+		glUseProgram( 0 );
+		glBindMultiTextureEXT( GL_TEXTURE0, GL_TEXTURE_2D, 0 );
+		verts.clear();
+		runs.clear();
+		queued.clear();
+	}
+	
+}
@@ -0,0 +1,121 @@
+/*
+ *  textbatch
+ */
+
+/* 
+ Copyright (c) 2010 Cass Everitt
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or
+ without modification, are permitted provided that the following
+ conditions are met:
+ 
+ * Redistributions of source code must retain the above
+ copyright notice, this list of conditions and the following
+ disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above
+ copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials
+ provided with the distribution.
+ 
+ * The names of contributors to this software may not be used
+ to endorse or promote products derived from this software
+ without specific prior written permission. 
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ POSSIBILITY OF SUCH DAMAGE. 
+ 
+ 
+ Cass Everitt
+ */
+
+#ifndef __STAR3MAP_TEXTBATCH_H__
+#define __STAR3MAP_TEXTBATCH_H__
+
+#include "sdffont.h"
+
+#include "r3/bounds.h"
+#include "r3/linear.h"
+#include "r3/model.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace star3map {
+
+	// Text laid out on the CPU into one vertex stream and drawn with a single
+	// call, from the glyph atlas of an SdfFont that other batches can share.
+	// Units match r3::Font: pixels at a font pixelHeight high, times scale.
+	class TextBatch {
+	public:
+		TextBatch( SdfFont *tbFont, float pixelHeight );
+		~TextBatch();
+		
+		r3::Bounds2f GetStringDimensions( const std::string & s, float scale );
+		
+		// Queue s with its origin at (x,y) in label space.  xf maps label space
+		// into the space of the modelview that is current at Draw().
+		void Add( const std::string & s, const r3::Matrix4f & xf, float x, float y, float scale, const r3::Vec4f & color );
+		int Count() const { return (int)verts.size() / 6; }
+		
+		// draws everything queued since the last Draw() and clears the queue
+		void Draw();
+		
+	private:
+		// tc.z is half the field's edge width, about a pixel as drawn
+		struct Vert {
+			r3::Vec3f pos;
+			unsigned char c[4];
+			r3::Vec3f tc;
+		};
+		
+		// What each queued quad was made from, so they can be laid out again
+		// when the atlas starts over.
+		struct Run {
+			r3::Matrix4f xf;
+			float x, y, scale;
+			unsigned char c[4];
+		};
+		struct QueuedGlyph {
+			int codepoint;
+			int run;
+			float pen;
+		};
+		
+		void Emit( const Run & r, const SdfFont::Glyph & g, float pen );
+		bool Requeue();
+		
+		SdfFont *font;
+		float unit;  // font pixels per baked pixel
+		// of the font's atlas the queued glyphs were placed in
+		int generation;
+		// unscaled, valid for the life of the font, and keyed on a hash of the
+		// string so a lookup doesn't allocate; the string is kept to catch
+		// collisions
+		struct Width {
+			std::string s;
+			float width;
+		};
+		std::map< unsigned int, Width > widths;
+		
+		std::vector< Run > runs;
+		std::vector< QueuedGlyph > queued;
+		std::vector< Vert > verts;
+		r3::Model *model;
+	};
+	
+}
+
+#endif //__STAR3MAP_TEXTBATCH_H__
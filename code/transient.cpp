@@ -41,6 +41,7 @@
  */
 
 #include "render.h"
+#include "drawlist.h"
 #include "drawstring.h"
 
 #include <GL/Regal.h>
@@ -51,7 +52,8 @@
 #include "r3/time.h"
 #include "r3/var.h"
 
-#include <map>
+#include <algorithm>
+#include <vector>
 
 using namespace std;
 using namespace star3map;
@@ -77,6 +79,7 @@ namespace {
 		DynamicRenderable( const Vec3f & lDir, const Vec3f & lLookDir, float lLimit, const Vec4f & lColor, float lDuration ) 
 		: direction( lDir ), lookDir( lLookDir ), limit( lLimit ), color( lColor ), duration( lDuration ), state( DState_RampUp ) {
 			timeStamp = GetSeconds();
+			lastSeen = timeStamp;
 			currAlpha = 0.0f;
 		} 
 		Vec3f direction;
@@ -124,48 +127,166 @@ namespace {
 		void seen() {
 			lastSeen = GetSeconds();
 		}
+		bool expired( float currTime ) const {
+			return state == DState_Terminate && ( currTime - lastSeen ) >= 1.0f;
+		}
+	};
+	
+	unsigned int HashKey( const string & s ) {
+		unsigned int h = 2166136261u;
+		for ( int i = 0; i < (int)s.size(); i++ ) {
+			h = ( h ^ (unsigned char)s[i] ) * 16777619u;
+		}
+		return h;
+	}
+	
+	unsigned int HashKey( const void * p ) {
+		size_t v = (size_t)p;
+		unsigned int h = (unsigned int)( v ^ ( v >> 16 ) );
+		return h * 2654435761u;
+	}
+	
+	// Live items are packed in items[0,count) and found through an open
+	// addressed index.  Removal swaps the last live item into the hole, and
+	// dead items past count are kept so their storage gets reused, so nothing
+	// is allocated once the pool has grown to its working size.
+	template< typename Key, typename Item >
+	struct TransientPool {
+		struct Entry {
+			int slot;
+			unsigned int hash;
+		};
+		vector< Item > items;
+		vector< Entry > index;
+		int count;
+		
+		TransientPool() : count( 0 ) {}
+		
+		Item * Find( const Key & key ) {
+			if ( count == 0 ) {
+				return NULL;
+			}
+			unsigned int h = HashKey( key );
+			unsigned int mask = index.size() - 1;
+			for ( unsigned int i = h & mask; index[i].slot >= 0; i = ( i + 1 ) & mask ) {
+				if ( index[i].hash == h && items[ index[i].slot ].key() == key ) {
+					return &items[ index[i].slot ];
+				}
+			}
+			return NULL;
+		}
+		
+		// key must not already be present
+		Item & Insert( const Key & key, const Item & item ) {
+			if ( ( count + 1 ) * 2 > (int)index.size() ) {
+				Rehash( max( 64, (int)index.size() * 2 ) );
+			}
+			if ( count == (int)items.size() ) {
+				items.push_back( item );
+			} else {
+				items[ count ] = item;
+			}
+			Link( HashKey( key ), count );
+			return items[ count++ ];
+		}
+		
+		void Remove( int slot ) {
+			Unlink( slot );
+			int last = count - 1;
+			if ( slot != last ) {
+				Unlink( last );
+				swap( items[ slot ], items[ last ] );
+				Link( HashKey( items[ slot ].key() ), slot );
+			}
+			count--;
+		}
+		
+		void Link( unsigned int h, int slot ) {
+			unsigned int mask = index.size() - 1;
+			unsigned int i = h & mask;
+			while ( index[i].slot >= 0 ) {
+				i = ( i + 1 ) & mask;
+			}
+			index[i].slot = slot;
+			index[i].hash = h;
+		}
+		
+		// backward shift delete, so lookups never need tombstones
+		void Unlink( int slot ) {
+			unsigned int mask = index.size() - 1;
+			unsigned int hole = HashKey( items[ slot ].key() ) & mask;
+			while ( index[ hole ].slot != slot ) {
+				hole = ( hole + 1 ) & mask;
+			}
+			for ( unsigned int j = ( hole + 1 ) & mask; index[j].slot >= 0; j = ( j + 1 ) & mask ) {
+				unsigned int home = index[j].hash & mask;
+				if ( ( ( j - home ) & mask ) >= ( ( j - hole ) & mask ) ) {
+					index[ hole ] = index[j];
+					hole = j;
+				}
+			}
+			index[ hole ].slot = -1;
+		}
+		
+		void Rehash( int size ) {
+			Entry empty = { -1, 0 };
+			index.assign( size, empty );
+			for ( int i = 0; i < count; i++ ) {
+				Link( HashKey( items[i].key() ), i );
+			}
+		}
+		
+		// age everything in place and drop what has expired
+		void Age() {
+			float currTime = GetSeconds();
+			for ( int i = 0; i < count; ) {
+				items[i].age();
+				if ( items[i].expired( currTime ) ) {
+					Remove( i );
+				} else {
+					i++;
+				}
+			}
+		}
 	};
 	
 	struct DynamicLabel : public DynamicRenderable {
 		DynamicLabel() {}
-		DynamicLabel( const string & lName, const Vec3f & lDir, const Vec3f & lLookDir, float lLimit, const Vec4f & lColor, float lDuration ) 
-		: DynamicRenderable( lDir, lLookDir, lLimit, lColor, lDuration ), name( lName ) {
+		DynamicLabel( const string & lName, const Vec3f & lDir, const Vec3f & lLookDir, float lLimit, const Vec4f & lColor, float lDuration, float lPriority ) 
+		: DynamicRenderable( lDir, lLookDir, lLimit, lColor, lDuration ), name( lName ), priority( lPriority ) {
 			timeStamp = GetSeconds();
 			currAlpha = 0.0f;
 		} 
 		string name;
+		float priority;
+		const string & key() const { return name; }
 		void render( DrawNonOverlappingStrings * nos ) {
 			if ( state != DState_Terminate ) {
-				glColor4f( color.x, color.y, color.z, currAlpha );
-				nos->DrawString( name, direction, lookDir, limit );
+				nos->DrawString( name, direction, lookDir, limit, Vec4f( color.x, color.y, color.z, currAlpha ), priority );
 			}
 		}
 	};
 	
-	map< string, DynamicLabel > dynamicLabels;
+	TransientPool< string, DynamicLabel > dynamicLabels;
 		
 	struct DynamicLines : public DynamicRenderable {
 		DynamicLines() {}
-		DynamicLines( Lines *lLines, const Vec3f & lDir, const Vec3f & lLookDir, float lLimit, const Vec4f lColor, float lDuration ) 
-		: DynamicRenderable( lDir, lLookDir, lLimit, lColor, lDuration ), lines( lLines ) {
+		DynamicLines( Lines *lLines, int lSet, const Vec3f & lDir, const Vec3f & lLookDir, float lLimit, const Vec4f lColor, float lDuration ) 
+		: DynamicRenderable( lDir, lLookDir, lLimit, lColor, lDuration ), lines( lLines ), set( lSet ) {
 			timeStamp = GetSeconds();
 			currAlpha = 0.0f;
 		} 
 		Lines *lines;
-		void render() {
+		int set;
+		const void * key() const { return lines; }
+		void render( DrawList & list ) {
 			if ( state != DState_Terminate ) {
-				glColor4f( color.x, color.y, color.z, currAlpha );
-				glBegin( GL_LINES );
-				for( int j = 0; j < (int)lines->vert.size(); j++ ) {
-					Vec3f & v = lines->vert[ j ];
-					glVertex3f( v.x, v.y, v.z );
-				}
-				glEnd();
+				list.AddLineColor( set, Vec4f( color.x, color.y, color.z, currAlpha ) );
 			}
 		}
 	};
 	
-	map< Lines *, DynamicLines > dynamicLines;
+	TransientPool< const void *, DynamicLines > dynamicLines;
 	
 }
 
@@ -176,85 +297,70 @@ namespace star3map {
 		
     void AgeDynamicLabels();
 	void AgeDynamicLabels() {
-		if ( app_pauseAging.GetVal() ) {
+		if ( frameSettings.pauseAging ) {
 			return;
 		}
-		map< string, DynamicLabel > oldLabels = dynamicLabels;
-		dynamicLabels.clear();
-		map< string, DynamicLabel >::iterator it;
-		int count = 0;
-		float currTime = GetSeconds();
-		for ( it = oldLabels.begin(); it != oldLabels.end(); ++it ) {
-			DynamicLabel & dl = it->second;
-			dl.age();
-			if ( dl.state != DynamicLabel::DState_Terminate || ( currTime - dl.lastSeen ) < 1.0f ) {
-				dynamicLabels[ dl.name ] = dl;
-			}
-			count++;
-		}
+		dynamicLabels.Age();
 	}
 	void DrawDynamicLabels( DrawNonOverlappingStrings * nos );	
 	void DrawDynamicLabels( DrawNonOverlappingStrings * nos ) {
-		map< string, DynamicLabel >::iterator it;
-		for ( it = dynamicLabels.begin(); it != dynamicLabels.end(); ++it ) {
-			DynamicLabel & dl = it->second;
-			dl.render( nos );
+		for ( int i = 0; i < dynamicLabels.count; i++ ) {
+			dynamicLabels.items[i].render( nos );
 		}
 	}
 	void AgeDynamicLines();	
 	void AgeDynamicLines() {
-		if ( app_pauseAging.GetVal() ) {
+		if ( frameSettings.pauseAging ) {
 			return;
 		}		
-		map< Lines *, DynamicLines > oldLines = dynamicLines;
-		dynamicLines.clear();
-		map< Lines *, DynamicLines >::iterator it;
-		int count = 0;
-		float currTime = GetSeconds();
-		for ( it = oldLines.begin(); it != oldLines.end(); ++it ) {
-			DynamicLines & dl = it->second;
-			dl.age();
-			if ( dl.state != DynamicLabel::DState_Terminate || ( currTime - dl.lastSeen ) < 1.0f ) {
-				dynamicLines[ dl.lines ] = dl;
-			}
-			count++;
+		dynamicLines.Age();
+	}
+	
+	void DrawDynamicLines( DrawList & list );
+    void DrawDynamicLines( DrawList & list ) {
+		for ( int i = 0; i < dynamicLines.count; i++ ) {
+			dynamicLines.items[i].render( list );
 		}
 	}
 	
-	void DrawDynamicLines();
-    void DrawDynamicLines() {
-		map< Lines *, DynamicLines >::iterator it;
-		for ( it = dynamicLines.begin(); it != dynamicLines.end(); ++it ) {
-			DynamicLines & dl = it->second;
-			dl.render();
+	bool DynamicObjectsAnimating();
+	bool DynamicObjectsAnimating() {
+		if ( frameSettings.pauseAging ) {
+			return false;
 		}
+		for ( int i = 0; i < dynamicLabels.count; i++ ) {
+			if ( dynamicLabels.items[i].state != DynamicRenderable::DState_Terminate ) {
+				return true;
+			}
+		}
+		for ( int i = 0; i < dynamicLines.count; i++ ) {
+			if ( dynamicLines.items[i].state != DynamicRenderable::DState_Terminate ) {
+				return true;
+			}
+		}
+		return false;
 	}
 	
-	void DynamicLinesInView( Lines * lines, Vec4f c, Vec4f cl, Vec3f lookDir );
-    void DynamicLinesInView( Lines * lines, Vec4f c, Vec4f cl, Vec3f lookDir ) {
-		if ( dynamicLines.count( lines ) == 0 ) {
-			DynamicLines dl( lines, lines->center, lookDir, 0, c, 4.0f );
-			dynamicLines[ lines ] = dl;
+	void DynamicLinesInView( Lines * lines, int set, Vec4f c, Vec4f cl, Vec3f lookDir );
+    void DynamicLinesInView( Lines * lines, int set, Vec4f c, Vec4f cl, Vec3f lookDir ) {
+		if ( DynamicLines * dl = dynamicLines.Find( lines ) ) {
+			dl->seen();
 		} else {
-			dynamicLines[ lines ].seen();
+			dynamicLines.Insert( lines, DynamicLines( lines, set, lines->center, lookDir, 0, c, 4.0f ) );
 		}		
-		if ( dynamicLabels.count( lines->name ) == 0 ) {
-			DynamicLabel dl( lines->name, lines->center, lookDir, 0, cl, 2.5f );
-			dynamicLabels[ dl.name ] = dl;					
+		if ( DynamicLabel * dl = dynamicLabels.Find( lines->name ) ) {
+			dl->seen();
 		} else {
-			dynamicLabels[ lines->name ].seen();
+			dynamicLabels.Insert( lines->name, DynamicLabel( lines->name, lines->center, lookDir, 0, cl, 2.5f, LabelPriority( 3.0f ) ) );
 		}
 	}
 	
-	void DynamicLabelInView( DrawNonOverlappingStrings *nos, const string & label, Vec3f dir, Vec4f c, Vec3f lookDir, float limit );
- 	void DynamicLabelInView( DrawNonOverlappingStrings *nos, const string & label, Vec3f dir, Vec4f c, Vec3f lookDir, float limit ) {
-		if ( dynamicLabels.count( label )  == 0) {
-			if ( nos->CanDrawString( label, dir, lookDir, limit ) ) {
-				DynamicLabel dl( label, dir, lookDir, limit, c, 1.0f );
-				dynamicLabels[ label ] = dl;
-			}
-		} else {
-			dynamicLabels[ label ].seen();
+	void DynamicLabelInView( DrawNonOverlappingStrings *nos, const string & label, Vec3f dir, Vec4f c, Vec3f lookDir, float limit, float priority );
+ 	void DynamicLabelInView( DrawNonOverlappingStrings *nos, const string & label, Vec3f dir, Vec4f c, Vec3f lookDir, float limit, float priority ) {
+		if ( DynamicLabel * dl = dynamicLabels.Find( label ) ) {
+			dl->seen();
+		} else if ( nos->CanDrawString( label, dir, lookDir, limit ) ) {
+			dynamicLabels.Insert( label, DynamicLabel( label, dir, lookDir, limit, c, 1.0f, priority ) );
 		}
 		
 	}
@@ -44,6 +44,7 @@
 #define __STAR3MAP_TRANSIENT_H__
 
 #include "r3/linear.h"
+#include "drawlist.h"
 #include "drawstring.h"
 #include "render.h"
 
@@ -52,9 +53,12 @@ namespace star3map {
 	void AgeDynamicLabels();
 	void AgeDynamicLines();
 	void DrawDynamicLabels( DrawNonOverlappingStrings * nos );
-	void DrawDynamicLines();
-	void DynamicLinesInView( Lines * lines, r3::Vec4f color, r3::Vec4f labelColor, r3::Vec3f lookDir );
-	void DynamicLabelInView( DrawNonOverlappingStrings *nos, const std::string & label, r3::Vec3f dir, r3::Vec4f c, r3::Vec3f lookDir, float limit );
+	// labels or lines are fading in, holding or fading out
+	bool DynamicObjectsAnimating();
+	// records the colors of the fading line sets for this frame
+	void DrawDynamicLines( DrawList & list );
+	void DynamicLinesInView( Lines * lines, int set, r3::Vec4f color, r3::Vec4f labelColor, r3::Vec3f lookDir );
+	void DynamicLabelInView( DrawNonOverlappingStrings *nos, const std::string & label, r3::Vec3f dir, r3::Vec4f c, r3::Vec3f lookDir, float limit, float priority );
 
 }
 
@@ -41,8 +41,6 @@
  */
 
 #include "ui/button.h"
-#include "render.h"
-#include <GL/Regal.h>
 
 #include "r3/command.h"
 #include "r3/common.h"
@@ -54,32 +52,31 @@ using namespace std;
 
 namespace star3map {
 	
-	Button::Button( r3::Texture2D * bTexture ) 
-	: tex( bTexture ), inputOver( false ), color( 1, 1, 1, 1 )  {
+	Button::Button( const TextureRegion & bSprite ) 
+	: sprite( bSprite ), ownsTexture( false ), inputOver( false ), color( 1, 1, 1, 1 )  {
 		bounds.Min() = Vec2f( 0, 0 );
-		bounds.Max() = Vec2f( (float)tex->Width(), (float)tex->Height() );
+		bounds.Max() = Vec2f( (float)sprite.width, (float)sprite.height );
 	}
 	
 	Button::Button( const std::string & bTextureFilename ) 
-	: tex( NULL ), inputOver( false ), color( 1, 1, 1, 1 )  {
-		tex = CreateTexture2DFromFile( bTextureFilename, TextureFormat_RGBA );
+	: ownsTexture( true ), inputOver( false ), color( 1, 1, 1, 1 )  {
+		sprite = FullTexture( CreateTexture2DFromFile( bTextureFilename, TextureFormat_RGBA ) );
 		bounds.Min() = Vec2f( 0, 0 );
-		bounds.Max() = Vec2f( (float)tex->Width(), (float)tex->Height() );
+		bounds.Max() = Vec2f( (float)sprite.width, (float)sprite.height );
 	}
 	
 	Button::~Button() {
-		delete tex;
+		if ( ownsTexture ) {
+			delete sprite.tex;
+		}
 	}
 
-	void Button::Draw() {
+	void Button::Draw( SpriteBatch & batch ) {
 		Vec4f c = color;
-		if ( inputOver ) {
-            glColor4fv( c.Ptr() );
-		} else {
+		if ( inputOver == false ) {
 			c *= .85f;
-            glColor4fv( c.Ptr() );
 		}
-		star3map::DrawSprite( tex, bounds );
+		batch.Add( sprite, bounds, c );
 	}
 	
 	bool Button::ProcessInput( bool active, int x, int y ) {
@@ -123,6 +120,10 @@ namespace star3map {
 	: Button( pbTextureFilename ), pressedCommand( pbCommand ), heldCommand( hbCommand ) {
 	}
 	
+	PushButton::PushButton( const TextureRegion & pbSprite, const string & pbCommand , const string & hbCommand ) 
+	: Button( pbSprite ), pressedCommand( pbCommand ), heldCommand( hbCommand ) {
+	}
+	
 	void PushButton::OnPressed() {
 		if( pressedCommand.size() > 0 ) {
 			ExecuteCommand( pressedCommand.c_str() );			
@@ -135,7 +136,7 @@ namespace star3map {
 		}
 	}
     
-    void SequenceButton::Draw() {
+    void SequenceButton::Draw( SpriteBatch & batch ) {
         if( items.size() <= 0 ) {
             return;
         }
@@ -143,13 +144,10 @@ namespace star3map {
             currentItem = 0;
         }
 		Vec4f c = color;
-		if ( inputOver ) {
-			glColor4fv( c.Ptr() );
-		} else {
+		if ( inputOver == false ) {
 			c *= .85f;
-			glColor4fv( c.Ptr() );
 		}
-		star3map::DrawSprite( items[ currentItem ].tex, bounds );
+		batch.Add( items[ currentItem ].sprite, bounds, c );
     }
     
     void SequenceButton::OnPressed() {
@@ -175,8 +173,8 @@ namespace star3map {
 		}
 	}
 	
-	ToggleButton::ToggleButton( r3::Texture2D * tbTexture, const string & tbVarName ) 
-	: Button( tbTexture ), onColor( 1.f, 1.f, .4f, 1.0f ), offColor( .65f, .65f, .65f, .75f ) {
+	ToggleButton::ToggleButton( const TextureRegion & tbSprite, const string & tbVarName ) 
+	: Button( tbSprite ), onColor( 1.f, 1.f, .4f, 1.0f ), offColor( .65f, .65f, .65f, .75f ) {
 		var = FindVar( tbVarName.c_str() );
 		float f;
 		if ( StringToFloat( var->Get(), f ) ) {
@@ -184,12 +182,12 @@ namespace star3map {
 		}
 	}
 	
-	void ToggleButton::Draw() {
+	void ToggleButton::Draw( SpriteBatch & batch ) {
 		float f;
 		if ( StringToFloat( var->Get(), f ) ) {
 			color = ( f != 0 ) ? onColor : offColor;
 		}
-		Button::Draw();
+		Button::Draw( batch );
 	}
 	
 	void ToggleButton::OnPressed() {
@@ -43,6 +43,8 @@
 #ifndef __STAR3MAP_BUTTON_H__
 #define __STAR3MAP_BUTTON_H__
 
+#include "atlas.h"
+
 #include "r3/bounds.h"
 #include "r3/texture.h"
 #include "r3/var.h"
@@ -53,9 +55,11 @@ namespace star3map {
 	
 	class Button {
 	protected:
-		r3::Texture2D *tex;
-        Button() : tex( NULL ), inputOver( false ), color( 1, 1, 1, 1 ) {}
-		Button( r3::Texture2D * bTexture );
+		TextureRegion sprite;
+		// only when loaded from a file, rather than given a region
+		bool ownsTexture;
+        Button() : ownsTexture( false ), inputOver( false ), color( 1, 1, 1, 1 ) {}
+		Button( const TextureRegion & bSprite );
 		Button( const std::string & bTextureFilename );
 		bool inputOver;
 		double timestamp;
@@ -64,7 +68,8 @@ namespace star3map {
 		virtual ~Button();
 		bool ProcessInput( bool active, int x, int y ); 
 		virtual void Tick();
-		virtual void Draw();
+		// queues the icon, so the whole bar is drawn with one bind per texture
+		virtual void Draw( SpriteBatch & batch );
 		virtual void OnPressed() {}
 		virtual void OnHeld() {}
 		r3::Bounds2f bounds;		
@@ -77,6 +82,7 @@ namespace star3map {
 		std::string heldCommand;		
 	public:
 		PushButton( const std::string & pbTextureFilename, const std::string & pbCommand, const std::string & hbCommand = "" );		
+		PushButton( const TextureRegion & pbSprite, const std::string & pbCommand, const std::string & hbCommand = "" );		
 		virtual void OnPressed();
 		virtual void OnHeld();
 	};
@@ -85,8 +91,8 @@ namespace star3map {
     public:
         struct Item {
             Item() {}
-            Item( r3::Texture2D *t, const std::string & c ) : tex( t ), command( c ) {}
-            r3::Texture2D *tex;
+            Item( const TextureRegion & s, const std::string & c ) : sprite( s ), command( c ) {}
+            TextureRegion sprite;
             std::string command;
         };
         std::vector<Item> items;
@@ -94,7 +100,7 @@ namespace star3map {
 
         SequenceButton() : currentItem( 0 ) {}
         
-        virtual void Draw();
+        virtual void Draw( SpriteBatch & batch );
         virtual void OnPressed();
         
     };
@@ -104,8 +110,8 @@ namespace star3map {
 		r3::Var *var;
 	public:
 		ToggleButton( const std::string & tbTextureFilename, const std::string & tbVarName );
-		ToggleButton( r3::Texture2D * tbTexture, const std::string & tbVarName );
-		virtual void Draw();
+		ToggleButton( const TextureRegion & tbSprite, const std::string & tbVarName );
+		virtual void Draw( SpriteBatch & batch );
 		virtual void OnPressed();
 		r3::Vec4f onColor;
 		r3::Vec4f offColor;
@@ -68,9 +68,11 @@ namespace star3map {
 		glVertex2f( b.ur.x, b.ur.y );
 		glVertex2f( b.ll.x, b.ur.y );
         glEnd();
+		SpriteBatch batch;
 		for ( int i = 0; i < (int)buttons.size(); i++ ) {
-			buttons[i]->Draw();
+			buttons[i]->Draw( batch );
 		}
+		batch.Draw();
         glDisable( GL_BLEND );
 	}
 	
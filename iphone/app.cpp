@@ -21,6 +21,7 @@
 
 #include "starlist.h"
 #include "constellations.h"
+#include "log.h"
 #include "render.h"
 #include "star3map.h"
 
@@ -170,6 +171,9 @@ void display() {
         RegalSetErrorCallback( NULL );
     }
 	updateOrientation();
+	if ( star3map::DisplayNeeded() == false ) {
+		return;  // the last frame is still on screen
+	}
 	star3map::Display();
 }
 
@@ -386,6 +390,8 @@ void platformQuit() {
 }
 
 void platformResignActive() {
+	// the app may be killed in the background without exiting
+	star3map::LogFlush();
 	r3::ExecuteCommand( "writebindings" );
 	r3::ExecuteCommand( "writevars" );
 }
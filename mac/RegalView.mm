@@ -26,6 +26,8 @@ int appmouse( int button, bool isdown, int x, int y );
 int appmotion( int x, int y );
 int appreshape( int width, int height );
 int appdisplay();
+bool appdisplayneeded();
+void appinvalidate();
 int appmain();
 
 
@@ -86,7 +88,9 @@ NSTimer *timer = nil;
 }
 
 - (void) render {
-	[self setNeedsDisplay:YES];
+    if( drawn == false || appdisplayneeded() ) {
+        [self setNeedsDisplay:YES];
+    }
 }
 
 - (void)viewDidMoveToWindow
@@ -233,6 +237,7 @@ int KeycodeToKeysym( int kc ) {
     int k = r3::AsciiToKey( [s UTF8String][0] );
     fprintf( stderr, "Key down %c (%d) - keyCode: %x\n", k, k, rawkey);
     r3::CreateKeyEvent( ks != 0 ? ks : k, r3::KeyState_Down );
+    appinvalidate();
 }
 
 - (void)keyUp:(NSEvent *)theEvent
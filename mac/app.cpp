@@ -22,6 +22,7 @@
 
 #include "starlist.h"
 #include "constellations.h"
+#include "log.h"
 #include "render.h"
 #include "spacetime.h"
 #include "star3map.h"
@@ -196,6 +197,14 @@ void appreshape( int width, int height ) {
 
 int displayCount = 0;
 
+bool appdisplayneeded() {
+    return star3map::DisplayNeeded();
+}
+
+void appinvalidate() {
+    star3map::InvalidateDisplay();
+}
+
 void appdisplay() {
     ScopedReverseGfxContextAcquire rev( drawContext );
     star3map::Display();
@@ -225,6 +234,7 @@ void appmain() {
 
 // appquit command
 void AppQuit( const vector< Token > & tokens ) {
+	star3map::LogFlush();
 	Shutdown();
 	exit( 0 );
 }
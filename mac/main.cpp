@@ -43,6 +43,7 @@
 
 #include "starlist.h"
 #include "constellations.h"
+#include "log.h"
 #include "render.h"
 #include "spacetime.h"
 #include "star3map.h"
@@ -149,6 +150,7 @@ void reshape( int width, int height ) {
 }
 
 void key( unsigned char k, int x, int y ) {
+	star3map::InvalidateDisplay();
 	int r3key = r3::AsciiToKey( k );
 	r3::CreateKeyEvent( r3key, r3::KeyState_Down );
 	r3::CreateKeyEvent( r3key, r3::KeyState_Up );
@@ -156,6 +158,7 @@ void key( unsigned char k, int x, int y ) {
 
 
 void special( int key, int x, int y ) {
+	star3map::InvalidateDisplay();
 	int r3key = 0;
 	if ( key >= GLUT_KEY_F1  && key <= GLUT_KEY_F12 ) {
 		r3key = XK_F1 + ( key - GLUT_KEY_F1 );
@@ -227,8 +230,11 @@ void motion( int x, int y ) {
 	}
 }
 
+// only asks for a frame when it would look different from the last one
 void tick( int dummy ) {
-	glutPostRedisplay();
+	if ( star3map::DisplayNeeded() ) {
+		glutPostRedisplay();
+	}
 	glutTimerFunc( app_updateMsec.GetVal(), tick, 0 );
 }
 
@@ -341,6 +347,7 @@ int main (int argc, char ** argv) {
 
 // appquit command
 void AppQuit( const vector< Token > & tokens ) {
+	star3map::LogFlush();
 	Shutdown();
 	exit( 0 );
 }
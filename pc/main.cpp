@@ -40,6 +40,7 @@
 
 #include "starlist.h"
 #include "constellations.h"
+#include "log.h"
 #include "render.h"
 #include "star3map.h"
 
@@ -121,6 +122,7 @@ void reshape( int width, int height ) {
 }
 
 void key( unsigned char k, int x, int y ) {
+	star3map::InvalidateDisplay();
 	int r3key = r3::AsciiToKey( k );
 	r3::ProcessKeyEvent( r3key, r3::KeyState_Down );
 	r3::ProcessKeyEvent( r3key, r3::KeyState_Up );
@@ -128,6 +130,7 @@ void key( unsigned char k, int x, int y ) {
 
 
 void special( int key, int x, int y ) {
+	star3map::InvalidateDisplay();
 	int r3key = 0;
 	if ( key >= GLUT_KEY_F1  && key <= GLUT_KEY_F12 ) {
 		r3key = XK_F1 + ( key - GLUT_KEY_F1 );
@@ -199,6 +202,7 @@ void motion( int x, int y ) {
 	}
 }
 
+// only asks for a frame when it would look different from the last one
 void tick( int dummy ) {
 	static float lat;
 	static float lon;
@@ -211,7 +215,9 @@ void tick( int dummy ) {
 	}
 	
 	
-	glutPostRedisplay();
+	if ( star3map::DisplayNeeded() ) {
+		glutPostRedisplay();
+	}
 	glutTimerFunc( app_updateMsec.GetVal(), tick, 0 );
 }
 
@@ -319,6 +325,7 @@ int main (int argc, char ** argv) {
 
 // appquit command
 void AppQuit( const vector< Token > & tokens ) {
+	star3map::LogFlush();
 	glutDestroyWindow( glutGetWindow() );
     exit( 0 );
 }	